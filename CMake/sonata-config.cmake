@@ -1 +1,6 @@
-include("${CMAKE_CURRENT_LIST_DIR}/sonata-targets.cmake")
\ No newline at end of file
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+find_package(ZLIB QUIET)
+find_package(MPI QUIET COMPONENTS C)
+
+include("${CMAKE_CURRENT_LIST_DIR}/sonata-targets.cmake")
@@ -0,0 +1,92 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Scaling benchmark of `makeCollectiveReader`.
+//
+// Rank 0 writes a dataset; then every rank reads its own scattered selection,
+// once independently with the default reader, and collectively with one
+// aggregator, one per node and one per rank. The time of the slowest rank is
+// reported. Run it for increasing numbers of ranks, e.g.
+//
+//   for n in 1 2 4 8; do mpirun -n $n bench_collective_read [file] [elements]; done
+
+#include <bbp/sonata/hdf5_reader_mpi.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "bench_common.hpp"
+
+using bbp::sonata::Hdf5Reader;
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    const std::string path = argc > 1 ? argv[1] : "bench_collective_read.h5";
+    const size_t n_elements = argc > 2 ? std::stoul(argv[2]) : 50000000;
+
+    if (rank == 0) {
+        bench::writeValues(path, bench::iota<uint64_t>(n_elements));
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    {
+        struct Reader {
+            const char* name;
+            Hdf5Reader reader;
+        };
+        const Reader readers[] = {
+            {"independent", Hdf5Reader()},
+            {"1 aggregator", bbp::sonata::makeCollectiveReader(MPI_COMM_WORLD, 1)},
+            {"per node", bbp::sonata::makeCollectiveReader(MPI_COMM_WORLD, 0)},
+            {"per rank", bbp::sonata::makeCollectiveReader(MPI_COMM_WORLD, size)}};
+
+        const auto selection =
+            bench::randomRanges(n_elements, 10000, 16, static_cast<uint64_t>(rank));
+        if (rank == 0) {
+            std::printf("%d ranks, %zu elements, %zu per rank:",
+                        size,
+                        n_elements,
+                        selection.flatSize());
+        }
+
+        for (const auto& r : readers) {
+            const auto file = r.reader.openFile(path);
+            const auto values = file.getDataSet("values");
+
+            MPI_Barrier(MPI_COMM_WORLD);
+            const auto start = std::chrono::steady_clock::now();
+            const auto result = r.reader.readSelection<uint64_t>(values, selection);
+            double elapsed =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (result.size() != selection.flatSize() || result[0] != selection.ranges()[0][0]) {
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+
+            MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            if (rank == 0) {
+                std::printf("  %s %7.2f ms", r.name, 1e3 * elapsed);
+            }
+        }
+        if (rank == 0) {
+            std::printf("\n");
+        }
+    }
+
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Helpers shared by the benchmarks.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bbp/sonata/selection.h>
+#include <highfive/H5File.hpp>
+
+namespace bench {
+
+// Seconds of the fastest of `repetitions` calls of `f`.
+template <class F>
+double bestOf(int repetitions, F f) {
+    double best = 1e300;
+    for (int i = 0; i < repetitions; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+// The values 0, 1, ..., `size` - 1.
+template <class T>
+std::vector<T> iota(size_t size) {
+    std::vector<T> values(size);
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = static_cast<T>(i);
+    }
+    return values;
+}
+
+// Write `values` as the dataset "values" of a new file at `path`.
+template <class T>
+void writeValues(const std::string& path,
+                 const std::vector<T>& values,
+                 const HighFive::DataSetCreateProps& props = {}) {
+    HighFive::File file(path, HighFive::File::Truncate);
+    file.createDataSet<T>("values", HighFive::DataSpace::From(values), props).write(values);
+}
+
+// `n_ranges` ranges of `run` elements at random positions in [0, `size`).
+inline bbp::sonata::Selection randomRanges(size_t size,
+                                           size_t n_ranges,
+                                           size_t run,
+                                           uint64_t seed) {
+    using bbp::sonata::Selection;
+
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> begin(0, size - run);
+
+    Selection::Ranges ranges;
+    for (size_t i = 0; i < n_ranges; ++i) {
+        const size_t b = begin(rng);
+        ranges.push_back({b, b + run});
+    }
+    return Selection(Selection(ranges).canonicalRanges());
+}
+
+}  // namespace bench
@@ -0,0 +1,95 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Benchmark of the readers for contiguous datasets.
+//
+// Writes a contiguous dataset to a file, then reads scattered selections of
+// short ranges from it with the default reader, `makeMmapReader`, and
+// `makeIoUringReader` with and without io_uring. Each read is timed with the
+// file in the page cache, and after asking the kernel to drop it.
+//
+//   bench_contiguous_read [file] [number of elements]
+
+#include <bbp/sonata/hdf5_reader.h>
+
+#include <fcntl.h>   // open, posix_fadvise
+#include <unistd.h>  // close
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "bench_common.hpp"
+
+using bbp::sonata::Hdf5Reader;
+
+namespace {
+
+void dropFromPageCache(const std::string& path) {
+#ifdef POSIX_FADV_DONTNEED
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+#else
+    (void) path;
+#endif
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    const std::string path = argc > 1 ? argv[1] : "bench_contiguous_read.h5";
+    const size_t size = argc > 2 ? std::stoul(argv[2]) : 50000000;
+
+    bench::writeValues(path, bench::iota<uint64_t>(size));
+
+    struct Reader {
+        const char* name;
+        Hdf5Reader reader;
+    };
+    const Reader readers[] = {{"default", Hdf5Reader()},
+                              {"mmap", bbp::sonata::makeMmapReader()},
+                              {"io_uring", bbp::sonata::makeIoUringReader(128)},
+                              {"pread", bbp::sonata::makeIoUringReader(0)}};
+
+    std::printf("%zu elements, cold -> warm page cache\n", size);
+    for (const size_t n_ranges : {1000, 10000, 100000}) {
+        const auto selection = bench::randomRanges(size, n_ranges, 4, n_ranges);
+
+        std::printf("%6zu ranges:", n_ranges);
+        for (const auto& r : readers) {
+            const auto file = r.reader.openFile(path);
+            const auto values = file.getDataSet("values");
+
+            double elapsed[2];
+            for (double& e : elapsed) {
+                if (&e == &elapsed[0]) {
+                    dropFromPageCache(path);
+                }
+                const auto start = std::chrono::steady_clock::now();
+                const auto result = r.reader.readSelection<uint64_t>(values, selection);
+                e = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                        .count();
+
+                if (result.size() != selection.flatSize() ||
+                    result[0] != selection.ranges()[0][0]) {
+                    return EXIT_FAILURE;
+                }
+            }
+            std::printf("  %s %7.2f -> %7.2f ms", r.name, 1e3 * elapsed[0], 1e3 * elapsed[1]);
+        }
+        std::printf("\n");
+    }
+
+    return EXIT_SUCCESS;
+}
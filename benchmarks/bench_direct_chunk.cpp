@@ -0,0 +1,94 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Benchmark of `makeDirectChunkReader` against the default `Hdf5Reader`.
+//
+// Writes a shuffled and deflated dataset to a file, then reads all of it and
+// a sparse selection from it, with the default reader and with the direct
+// chunk reader on 1, 2, 4, ... threads, up to the number of hardware threads.
+//
+//   bench_direct_chunk [file] [number of elements]
+
+#include <bbp/sonata/hdf5_reader.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "bench_common.hpp"
+
+using bench::bestOf;
+using bbp::sonata::Hdf5Reader;
+using bbp::sonata::Selection;
+
+namespace {
+
+void writeFile(const std::string& path, size_t size) {
+    // Slowly increasing IDs with some noise, like a sorted edge attribute.
+    std::mt19937_64 rng(0);
+    std::vector<uint64_t> values(size);
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = i / 3 + (rng() & 0xff);
+    }
+
+    HighFive::DataSetCreateProps props;
+    props.add(HighFive::Chunking({65536}));
+    props.add(HighFive::Shuffle());
+    props.add(HighFive::Deflate(4));
+    bench::writeValues(path, values, props);
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    const std::string path = argc > 1 ? argv[1] : "bench_direct_chunk.h5";
+    const size_t size = argc > 2 ? std::stoul(argv[2]) : 20000000;
+    const int repetitions = 3;
+
+    writeFile(path, size);
+
+    Selection::Ranges sparse_ranges;
+    for (size_t i = 0; i + 3 <= size; i += 1000) {
+        sparse_ranges.push_back({i, i + 3});
+    }
+    const Selection all({{0, size}});
+    const Selection sparse(std::move(sparse_ranges));
+
+    const auto time = [&](const Hdf5Reader& reader, const char* name) {
+        const auto file = reader.openFile(path);
+        const auto values = file.getDataSet("values");
+
+        size_t check = 0;
+        const double all_time = bestOf(repetitions, [&]() {
+            check += reader.readSelection<uint64_t>(values, all).size();
+        });
+        const double sparse_time = bestOf(repetitions, [&]() {
+            check += reader.readSelection<uint64_t>(values, sparse).size();
+        });
+        std::printf("%-12s all %8.2f ms,  sparse %8.2f ms\n",
+                    name,
+                    1e3 * all_time,
+                    1e3 * sparse_time);
+
+        return check == static_cast<size_t>(repetitions) * (all.flatSize() + sparse.flatSize());
+    };
+
+    std::printf("%zu elements, best of %d\n", size, repetitions);
+    bool ok = time(Hdf5Reader(), "default");
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        const std::string name = std::to_string(n_threads) + " threads";
+        ok = time(bbp::sonata::makeDirectChunkReader(n_threads), name.c_str()) && ok;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Benchmark of the read strategies of the default `Hdf5Reader` plugin.
+//
+// Writes a one-dimensional and a two-dimensional (edge index like) dataset to
+// a file, then reads sparse and dense selections from them with both
+// `Hdf5ReadStrategy::mergedBlocks` and `Hdf5ReadStrategy::unionHyperslab`.
+//
+//   bench_hdf5_read [file] [number of elements]
+
+#include <bbp/sonata/hdf5_reader.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "bench_common.hpp"
+
+using bench::bestOf;
+using bbp::sonata::Hdf5Reader;
+using bbp::sonata::Hdf5ReadStrategy;
+using bbp::sonata::Selection;
+
+namespace {
+
+// Ranges of `mean_run` elements on average, separated by gaps of `mean_gap` on average.
+Selection makeSelection(size_t size, size_t mean_run, size_t mean_gap, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> run(1, 2 * mean_run - 1);
+    std::uniform_int_distribution<size_t> gap(1, 2 * mean_gap - 1);
+
+    Selection::Ranges ranges;
+    for (size_t begin = gap(rng); begin < size;) {
+        const size_t end = std::min(size, begin + run(rng));
+        ranges.push_back({begin, end});
+        begin = end + gap(rng);
+    }
+    return Selection(std::move(ranges));
+}
+
+void writeFile(const std::string& path, size_t size) {
+    bench::writeValues(path, bench::iota<uint64_t>(size));
+
+    std::vector<std::array<uint64_t, 2>> pairs(size);
+    for (size_t i = 0; i < size; ++i) {
+        pairs[i] = {i, i + 1};
+    }
+    HighFive::File file(path, HighFive::File::ReadWrite);
+    file.createDataSet<uint64_t>("pairs", HighFive::DataSpace::From(pairs)).write(pairs);
+}
+
+struct Case {
+    const char* name;
+    size_t mean_run;
+    size_t mean_gap;
+};
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    const std::string path = argc > 1 ? argv[1] : "bench_hdf5_read.h5";
+    const size_t size = argc > 2 ? std::stoul(argv[2]) : 20000000;
+    const int repetitions = 3;
+
+    writeFile(path, size);
+
+    const Hdf5Reader merged(Hdf5ReadStrategy::mergedBlocks);
+    const Hdf5Reader hyperslab(Hdf5ReadStrategy::unionHyperslab);
+    const auto file = merged.openFile(path);
+    const auto values = file.getDataSet("values");
+    const auto pairs = file.getDataSet("pairs");
+    const auto columns = Selection({{0, 2}});
+
+    std::printf("%zu elements, best of %d, merged blocks -> union hyperslab\n", size, repetitions);
+    for (const Case& c : {Case{"sparse", 2, 1000},
+                          Case{"scattered", 4, 50},
+                          Case{"dense", 1000, 10},
+                          Case{"few blocks", 100000, 1000000}}) {
+        const auto selection = makeSelection(size, c.mean_run, c.mean_gap, 0);
+
+        size_t check = 0;
+        const double merged_1d = bestOf(repetitions, [&]() {
+            check += merged.readSelection<uint64_t>(values, selection).size();
+        });
+        const double hyperslab_1d = bestOf(repetitions, [&]() {
+            check += hyperslab.readSelection<uint64_t>(values, selection).size();
+        });
+        using Pair = std::array<uint64_t, 2>;
+        const double merged_2d = bestOf(repetitions, [&]() {
+            check += merged.readSelection<Pair>(pairs, selection, columns).size();
+        });
+        const double hyperslab_2d = bestOf(repetitions, [&]() {
+            check += hyperslab.readSelection<Pair>(pairs, selection, columns).size();
+        });
+
+        std::printf("%-10s %8zu ranges %9zu IDs:  "
+                    "1D %8.2f ms -> %8.2f ms,  2D %8.2f ms -> %8.2f ms\n",
+                    c.name,
+                    selection.ranges().size(),
+                    selection.flatSize(),
+                    1e3 * merged_1d,
+                    1e3 * hyperslab_1d,
+                    1e3 * merged_2d,
+                    1e3 * hyperslab_2d);
+
+        if (check != 4 * static_cast<size_t>(repetitions) * selection.flatSize()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
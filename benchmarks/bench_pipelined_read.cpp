@@ -0,0 +1,87 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Benchmark of reading merged blocks ahead on an I/O thread.
+//
+// Writes a dataset to a file, then reads a selection that's merged into many
+// blocks with the default reader, and with `makePipelinedReader` for several
+// prefetch depths. The selection has many short ranges per block, such that
+// copying them out takes about as long as reading the block.
+//
+//   bench_pipelined_read [file] [number of elements]
+
+#include <bbp/sonata/hdf5_reader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "bench_common.hpp"
+
+using bbp::sonata::Hdf5Reader;
+using bbp::sonata::ReadPolicy;
+using bbp::sonata::Selection;
+
+namespace {
+
+// Every other element.
+Selection makeSelection(size_t size) {
+    Selection::Ranges ranges;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        ranges.push_back({i, i + 1});
+    }
+    return Selection(std::move(ranges));
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    const std::string path = argc > 1 ? argv[1] : "bench_pipelined_read.h5";
+    const size_t size = argc > 2 ? std::stoul(argv[2]) : 20000000;
+
+    bench::writeValues(path, bench::iota<double>(size));
+    const auto selection = makeSelection(size);
+
+    // Blocks of 1 MiB.
+    ReadPolicy read_policy;
+    read_policy.max_block_bytes = 1 << 20;
+
+    struct Reader {
+        const char* name;
+        Hdf5Reader reader;
+    };
+    const Reader readers[] = {{"default", Hdf5Reader(read_policy)},
+                              {"depth 1", bbp::sonata::makePipelinedReader(1, read_policy)},
+                              {"depth 2", bbp::sonata::makePipelinedReader(2, read_policy)},
+                              {"depth 4", bbp::sonata::makePipelinedReader(4, read_policy)}};
+
+    std::printf("%zu elements, %zu ranges\n", size, selection.ranges().size());
+    for (const auto& r : readers) {
+        const auto file = r.reader.openFile(path);
+        const auto values = file.getDataSet("values");
+
+        double best = 1e30;
+        for (int i = 0; i < 5; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto result = r.reader.readSelection<double>(values, selection);
+            const double elapsed =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = std::min(best, elapsed);
+
+            if (result.size() != selection.flatSize() || result.back() != 2.0 * (size / 2 - 1)) {
+                return EXIT_FAILURE;
+            }
+        }
+        std::printf("  %-8s %8.2f ms\n", r.name, 1e3 * best);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Benchmark of reading attributes of one population from several threads.
+//
+// Writes a node population to a file, then lets 1, 2, 4, ... threads read
+// scattered selections of an attribute, with the file handle shared by all
+// threads and with one file handle per thread. Prints the throughput, i.e.
+// reads per second over all threads; if threads didn't wait for each other, it
+// would grow with the number of threads. Without a thread-safe HDF5, every
+// read holds the process-wide HDF5 lock.
+//
+//   bench_population_contention [file] [number of nodes] [max threads]
+
+#include <bbp/sonata/nodes.h>
+
+#include <highfive/H5File.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_common.hpp"
+
+using bbp::sonata::NodePopulation;
+using bbp::sonata::Selection;
+
+namespace {
+
+void writeFile(const std::string& path, size_t size) {
+    HighFive::File file(path, HighFive::File::Truncate);
+    auto root = file.createGroup("/nodes/default");
+
+    std::vector<uint64_t> type_ids(size, 0);
+    root.createDataSet<uint64_t>("node_type_id", HighFive::DataSpace::From(type_ids))
+        .write(type_ids);
+
+    const auto values = bench::iota<double>(size);
+    root.createGroup("0")
+        .createDataSet<double>("x", HighFive::DataSpace::From(values))
+        .write(values);
+}
+
+// Short ranges spread over the population, offset per thread.
+Selection makeSelection(size_t size, size_t offset) {
+    Selection::Ranges ranges;
+    for (size_t i = offset % 1000; i + 4 < size; i += 1000) {
+        ranges.push_back({i, i + 4});
+    }
+    return Selection(std::move(ranges));
+}
+
+// Reads per second, with `n_threads` threads reading `n_reads` times each.
+double measure(const NodePopulation& population, size_t size, size_t n_threads, int n_reads) {
+    std::vector<std::thread> threads;
+    std::vector<int> failed(n_threads, 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&population, &failed, size, n_reads, t]() {
+            const auto selection = makeSelection(size, 37 * t);
+            for (int i = 0; i < n_reads; ++i) {
+                const auto values = population.getAttribute<double>("x", selection);
+                if (values.size() != selection.flatSize()) {
+                    failed[t] = 1;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (std::count(failed.begin(), failed.end(), 1) > 0) {
+        std::exit(EXIT_FAILURE);
+    }
+    return static_cast<double>(n_threads * static_cast<size_t>(n_reads)) / elapsed;
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    const std::string path = argc > 1 ? argv[1] : "bench_population_contention.h5";
+    const size_t size = argc > 2 ? std::stoul(argv[2]) : 1000000;
+    const size_t max_threads = argc > 3 ? std::stoul(argv[3])
+                                        : std::max(1u, std::thread::hardware_concurrency());
+    constexpr int n_reads = 20;
+
+    writeFile(path, size);
+
+    std::printf("%zu nodes, HDF5 is %sthread-safe\n",
+                size,
+                bbp::sonata::isHdf5ThreadSafe() ? "" : "not ");
+    std::printf("  %-8s %14s %14s\n", "threads", "shared [1/s]", "per thread [1/s]");
+    for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+        NodePopulation shared(path, "", "default");
+        NodePopulation per_thread(path, "", "default");
+        per_thread.setFileHandlePerThread(true);
+
+        std::printf("  %-8zu %14.1f %14.1f\n",
+                    n_threads,
+                    measure(shared, size, n_threads, n_reads),
+                    measure(per_thread, size, n_threads, n_reads));
+    }
+
+    return EXIT_SUCCESS;
+}
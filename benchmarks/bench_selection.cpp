@@ -0,0 +1,104 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Microbenchmark of `Selection::fromValues` and `Selection::flatten`.
+//
+// Compares the contiguous (SIMD) `fromValues` with the generic iterator
+// based one, and `flatten` with appending the IDs one at a time.
+//
+//   bench_selection [number of IDs]
+
+#include <bbp/sonata/selection.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "bench_common.hpp"
+
+using bench::bestOf;
+using bbp::sonata::Selection;
+
+namespace {
+
+// IDs in runs of `mean_run` on average, separated by small gaps.
+Selection::Values makeValues(size_t size, size_t mean_run, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> run(1, 2 * mean_run - 1);
+    std::uniform_int_distribution<Selection::Value> gap(1, 16);
+
+    Selection::Values values;
+    values.reserve(size);
+    Selection::Value id = 0;
+    while (values.size() < size) {
+        const size_t n = std::min(run(rng), size - values.size());
+        for (size_t i = 0; i < n; ++i) {
+            values.push_back(id++);
+        }
+        id += gap(rng);
+    }
+    return values;
+}
+
+Selection::Values flattenOneByOne(const Selection& selection) {
+    Selection::Values values;
+    values.reserve(selection.flatSize());
+    for (const auto& range : selection.ranges()) {
+        for (auto id = std::get<0>(range); id < std::get<1>(range); ++id) {
+            values.emplace_back(id);
+        }
+    }
+    return values;
+}
+
+void report(const char* name, size_t mean_run, double before, double after) {
+    std::printf("%-12s run length %6zu:  %8.2f ms -> %8.2f ms  (x%.2f)\n",
+                name,
+                mean_run,
+                1e3 * before,
+                1e3 * after,
+                before / after);
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    const size_t size = argc > 1 ? std::stoul(argv[1]) : 50000000;
+    const int repetitions = 5;
+
+    std::printf("%zu IDs, best of %d\n", size, repetitions);
+    for (const size_t mean_run : {1, 16, 1024, 1000000}) {
+        const auto values = makeValues(size, mean_run, 0);
+
+        size_t check = 0;
+        const double generic = bestOf(repetitions, [&]() {
+            check += Selection::fromValues(values.begin(), values.end()).ranges().size();
+        });
+        const double simd = bestOf(repetitions, [&]() {
+            check += Selection::fromValues(values.data(), values.data() + values.size())
+                         .ranges()
+                         .size();
+        });
+        report("fromValues", mean_run, generic, simd);
+
+        const auto selection = Selection::fromValues(values);
+        const double one_by_one = bestOf(repetitions,
+                                         [&]() { check += flattenOneByOne(selection).size(); });
+        const double flatten = bestOf(repetitions, [&]() { check += selection.flatten().size(); });
+        report("flatten", mean_run, one_by_one, flatten);
+
+        if (check == 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
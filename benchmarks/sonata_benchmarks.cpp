@@ -0,0 +1,351 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// The benchmark suite of libsonata, on synthetic files of configurable size.
+//
+// Writes a node population, an edge population with its indices, node sets,
+// spikes and an element report into a directory; then times the common ways of
+// reading them, and prints the results as JSON:
+//
+//   {"sizes": {...}, "results": [{"name": "attribute/dense", "items": ...,
+//    "min_seconds": ..., "median_seconds": ..., "repetitions": ...}, ...]}
+//
+// `items` is the number of values, edges, nodes or spikes returned. The sizes
+// of the files are written next to them, to `sizes.json`. With `--reuse`, the
+// files written before are read again, if they were written with the same
+// sizes; otherwise, the benchmarks refuse to run.
+//
+//   sonata_benchmarks [--dir DIR] [--nodes N] [--fan-in K] [--fan-in-sigma S]
+//                     [--report-nodes N] [--elements-per-node N] [--frames N]
+//                     [--spikes N] [--seed S] [--repetitions R] [--output FILE]
+//                     [--reuse]
+
+#include <bbp/sonata/edges.h>
+#include <bbp/sonata/node_sets.h>
+#include <bbp/sonata/nodes.h>
+#include <bbp/sonata/report_reader.h>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "synthetic_circuit.hpp"
+
+using bbp::sonata::EdgePopulation;
+using bbp::sonata::ElementReportReader;
+using bbp::sonata::NodePopulation;
+using bbp::sonata::NodeSets;
+using bbp::sonata::Selection;
+using bbp::sonata::SpikeReader;
+
+namespace {
+
+struct Options {
+    std::string directory = ".";
+    synthetic::Sizes sizes;
+    int repetitions = 5;
+    std::string output;
+    bool reuse = false;
+};
+
+void usage(const char* name) {
+    std::fprintf(stderr,
+                 "usage: %s [--dir DIR] [--nodes N] [--fan-in K] [--fan-in-sigma S]\n"
+                 "          [--report-nodes N] [--elements-per-node N] [--frames N]\n"
+                 "          [--spikes N] [--seed S] [--repetitions R] [--output FILE]\n"
+                 "          [--reuse]\n",
+                 name);
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--reuse") {
+            options.reuse = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            return false;
+        }
+        const std::string value = argv[++i];
+        auto& sizes = options.sizes;
+        if (arg == "--dir") {
+            options.directory = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--repetitions") {
+            options.repetitions = std::max(1, std::stoi(value));
+        } else if (arg == "--nodes") {
+            sizes.nodes = std::stoull(value);
+        } else if (arg == "--fan-in") {
+            sizes.fan_in = std::stoull(value);
+        } else if (arg == "--fan-in-sigma") {
+            sizes.fan_in_sigma = std::stod(value);
+        } else if (arg == "--report-nodes") {
+            sizes.report_nodes = std::stoull(value);
+        } else if (arg == "--elements-per-node") {
+            sizes.elements_per_node = std::stoull(value);
+        } else if (arg == "--frames") {
+            sizes.frames = std::stoull(value);
+        } else if (arg == "--spikes") {
+            sizes.spikes = std::stoull(value);
+        } else if (arg == "--seed") {
+            sizes.seed = std::stoull(value);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+nlohmann::json toJSON(const synthetic::Sizes& sizes) {
+    return {{"nodes", sizes.nodes},
+            {"fan_in", sizes.fan_in},
+            {"fan_in_sigma", sizes.fan_in_sigma},
+            {"edges", sizes.edges()},
+            {"report_nodes", sizes.report_nodes},
+            {"elements_per_node", sizes.elements_per_node},
+            {"frames", sizes.frames},
+            {"spikes", sizes.spikes},
+            {"seed", sizes.seed}};
+}
+
+std::string sizesPath(const std::string& directory) {
+    return directory + "/sizes.json";
+}
+
+// Whether the files in `directory` were written with `sizes`.
+bool checkSizes(const std::string& directory, const synthetic::Sizes& sizes) {
+    std::ifstream file(sizesPath(directory));
+    if (!file) {
+        std::fprintf(stderr,
+                     "Can't reuse the files: '%s' is missing.\n",
+                     sizesPath(directory).c_str());
+        return false;
+    }
+
+    const auto written = nlohmann::json::parse(file, nullptr, false);
+    if (written != toJSON(sizes)) {
+        std::fprintf(stderr,
+                     "Can't reuse the files: they were written with the sizes\n%s\n",
+                     written.dump(2).c_str());
+        return false;
+    }
+    return true;
+}
+
+double seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+class Suite
+{
+  public:
+    explicit Suite(int repetitions)
+        : repetitions_(repetitions) { }
+
+    /// Time `run`, which returns the number of items it read.
+    template <class Run>
+    void measure(const std::string& name, Run run) {
+        std::vector<double> times;
+        uint64_t items = 0;
+        for (int i = 0; i < repetitions_; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            items = run();
+            times.push_back(seconds(start));
+        }
+        std::sort(times.begin(), times.end());
+
+        results_.push_back({{"name", name},
+                            {"items", items},
+                            {"repetitions", repetitions_},
+                            {"min_seconds", times.front()},
+                            {"median_seconds", times[times.size() / 2]}});
+        std::fprintf(stderr, "  %-32s %12.3f ms\n", name.c_str(), 1e3 * times.front());
+    }
+
+    /// Time `write` once.
+    template <class Write>
+    void measureOnce(const std::string& name, Write write) {
+        const auto start = std::chrono::steady_clock::now();
+        write();
+        results_.push_back({{"name", name},
+                            {"items", 0},
+                            {"repetitions", 1},
+                            {"min_seconds", seconds(start)},
+                            {"median_seconds", seconds(start)}});
+    }
+
+    const nlohmann::json& results() const {
+        return results_;
+    }
+
+  private:
+    int repetitions_;
+    nlohmann::json results_ = nlohmann::json::array();
+};
+
+// `count` node IDs below `size`, in random order.
+std::vector<uint64_t> randomIDs(uint64_t size, uint64_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint64_t> id(0, size - 1);
+    std::vector<uint64_t> ids(count);
+    for (auto& i : ids) {
+        i = id(rng);
+    }
+    return ids;
+}
+
+void writeFiles(const synthetic::Paths& paths, const synthetic::Sizes& sizes, Suite& suite) {
+    suite.measureOnce("write/nodes", [&] { synthetic::writeNodes(paths.nodes, sizes); });
+    suite.measureOnce("write/edges", [&] { synthetic::writeEdges(paths.edges, sizes); });
+    suite.measureOnce("write/edges/indices",
+                      [&] { synthetic::writeEdgeIndices(paths.edges, sizes); });
+    suite.measureOnce("write/spikes", [&] { synthetic::writeSpikes(paths.spikes, sizes); });
+    suite.measureOnce("write/report", [&] { synthetic::writeReport(paths.report, sizes); });
+    synthetic::writeNodeSets(paths.node_sets);
+}
+
+void benchmarkNodes(const synthetic::Paths& paths, const synthetic::Sizes& sizes, Suite& suite) {
+    const NodePopulation population(paths.nodes, "", synthetic::POPULATION);
+    const uint64_t n = sizes.nodes;
+
+    // A tenth of the nodes; every 100th node; 1% of the nodes, in random order.
+    const Selection dense({{n / 4, n / 4 + n / 10}});
+    Selection::Ranges sparse_ranges;
+    for (uint64_t i = 0; i < n; i += 100) {
+        sparse_ranges.push_back({i, i + 1});
+    }
+    const Selection sparse(std::move(sparse_ranges));
+    const auto random = Selection::fromValues(randomIDs(n, n / 100, sizes.seed));
+
+    const std::pair<const char*, const Selection*> selections[] = {{"dense", &dense},
+                                                                    {"sparse", &sparse},
+                                                                    {"random", &random}};
+    for (const auto& it : selections) {
+        const auto& selection = *it.second;
+        suite.measure(std::string("attribute/") + it.first, [&] {
+            return population.getAttribute<float>("x", selection).size();
+        });
+        suite.measure(std::string("attribute/enumeration/") + it.first, [&] {
+            return population.getAttribute<std::string>("mtype", selection).size();
+        });
+    }
+
+    const auto node_sets = NodeSets::fromFile(paths.node_sets);
+    for (const auto& name : node_sets.names()) {
+        suite.measure("node_sets/" + name,
+                      [&] { return node_sets.materialize(name, population).flatSize(); });
+    }
+}
+
+void benchmarkEdges(const synthetic::Paths& paths, const synthetic::Sizes& sizes, Suite& suite) {
+    const EdgePopulation population(paths.edges, "", synthetic::POPULATION);
+    const auto nodes = randomIDs(sizes.nodes, std::min<uint64_t>(sizes.nodes, 1000), sizes.seed);
+
+    suite.measure("edges/afferent", [&] { return population.afferentEdges(nodes).flatSize(); });
+    suite.measure("edges/efferent", [&] { return population.efferentEdges(nodes).flatSize(); });
+
+    const auto afferent = population.afferentEdges(nodes);
+    suite.measure("edges/afferent/source_node_ids",
+                  [&] { return population.sourceNodeIDs(afferent).size(); });
+    suite.measure("edges/afferent/attribute",
+                  [&] { return population.getAttribute<float>("delay", afferent).size(); });
+}
+
+void benchmarkReport(const synthetic::Paths& paths, const synthetic::Sizes& sizes, Suite& suite) {
+    const ElementReportReader reader(paths.report);
+    const auto& population = reader.openPopulation(synthetic::POPULATION);
+    const double tstop = std::get<1>(population.getTimes());
+
+    // The report has every `step`-th node.
+    const uint64_t n_nodes = std::min(sizes.report_nodes, sizes.nodes);
+    const uint64_t step = sizes.nodes / n_nodes;
+    std::vector<uint64_t> node_ids;
+    for (uint64_t i = 0; i < std::min<uint64_t>(n_nodes, 10); ++i) {
+        node_ids.push_back(i * step);
+    }
+    const auto few_nodes = Selection::fromValues(node_ids);
+
+    suite.measure("report/frame", [&] {
+        return population.get(nonstd::nullopt, tstop / 2, tstop / 2).data.size();
+    });
+    suite.measure("report/time_series", [&] { return population.get(few_nodes).data.size(); });
+}
+
+void benchmarkSpikes(const synthetic::Paths& paths, const synthetic::Sizes& sizes, Suite& suite) {
+    const SpikeReader reader(paths.spikes);
+    const auto& population = reader.openPopulation(synthetic::POPULATION);
+    const double tstop = std::get<1>(population.getTimes());
+    const auto nodes = Selection::fromValues(
+        randomIDs(sizes.nodes, std::max<uint64_t>(1, sizes.nodes / 100), sizes.seed));
+
+    suite.measure("spikes/by_node", [&] { return population.get(nodes).size(); });
+    suite.measure("spikes/time_window", [&] {
+        return population.get(nonstd::nullopt, tstop / 4, std::min(tstop, tstop / 4 + 10.0)).size();
+    });
+    suite.measure("spikes/by_node_and_time",
+                  [&] { return population.get(nodes, tstop / 4, tstop / 2).size(); });
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception&) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const auto& sizes = options.sizes;
+    if (sizes.nodes == 0 || sizes.report_nodes == 0 || sizes.frames == 0 || sizes.spikes == 0) {
+        std::fprintf(stderr, "The sizes must not be zero.\n");
+        return EXIT_FAILURE;
+    }
+
+    const synthetic::Paths paths(options.directory);
+    Suite suite(options.repetitions);
+    if (options.reuse) {
+        if (!checkSizes(options.directory, sizes)) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        // Only complete files are described by `sizes.json`.
+        std::remove(sizesPath(options.directory).c_str());
+        writeFiles(paths, sizes, suite);
+        std::ofstream(sizesPath(options.directory)) << toJSON(sizes).dump(2) << std::endl;
+    }
+
+    benchmarkNodes(paths, sizes, suite);
+    benchmarkEdges(paths, sizes, suite);
+    benchmarkReport(paths, sizes, suite);
+    benchmarkSpikes(paths, sizes, suite);
+
+    const nlohmann::json report = {{"sizes", toJSON(sizes)}, {"results", suite.results()}};
+    if (options.output.empty()) {
+        std::cout << report.dump(2) << std::endl;
+    } else {
+        std::ofstream(options.output) << report.dump(2) << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
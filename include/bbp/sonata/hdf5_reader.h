@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
 #include <tuple>
 #include <vector>
 
@@ -9,6 +14,69 @@
 namespace bbp {
 namespace sonata {
 
+namespace detail {
+class BlockCacheImpl;
+class IoStatisticsImpl;
+}  // namespace detail
+
+/// How the default plugin reads a canonical selection from a dataset.
+enum class Hdf5ReadStrategy {
+    /// Merge ranges separated by small gaps into blocks, read each block into
+    /// a buffer and copy the selected elements out of it. One H5Dread per
+    /// block; elements in the gaps are read too.
+    mergedBlocks,
+    /// Combine all ranges into one union hyperslab and read it directly into
+    /// the result with a single H5Dread. Only the selected elements are read.
+    unionHyperslab
+};
+
+/// Parameters for planning reads of the default plugin.
+///
+/// Selections are read by merging nearby ranges into larger blocks, reading
+/// each block into a buffer, and copying the selected elements out of it. All
+/// sizes are in bytes, so the same policy applies to datasets of any type.
+///
+/// The defaults suit a parallel file system with large blocks. Use
+/// `ReadPolicy::calibrate` to derive them from the storage a file is on.
+struct SONATA_API ReadPolicy {
+    /// Ranges separated by a gap of less than this are read as one block.
+    size_t min_gap_bytes = 4 << 20;
+
+    /// Stop merging ranges into a block once it's at least this large.
+    size_t max_block_bytes = 4 << 20;
+
+    /// Like `max_block_bytes`, for the blocks of rows and columns of
+    /// two-dimensional reads; by default, 128 times the minimum gap.
+    size_t max_block_bytes_2d = size_t(512) << 20;
+
+    /// Don't merge ranges if the block would then contain more than this
+    /// many times the bytes that were selected.
+    double max_over_read_ratio = std::numeric_limits<double>::infinity();
+
+    /// Don't merge ranges if the block would then be larger than this; a
+    /// single range larger than this is still read as one block.
+    size_t max_buffer_bytes = std::numeric_limits<size_t>::max();
+
+    /// Measure the latency and bandwidth of reading the file at `path`, and
+    /// pick a policy for it.
+    ///
+    /// A gap is worth reading if that's faster than starting a new read, i.e.
+    /// `min_gap_bytes` is latency times bandwidth; blocks are made large enough
+    /// to amortize the latency. Only `min_gap_bytes` and `max_block_bytes` are
+    /// set. The file is read with plain POSIX I/O; if it's in the page cache,
+    /// the page cache is measured.
+    ///
+    /// @throw SonataError if the file can't be read
+    static ReadPolicy calibrate(const std::string& path);
+};
+
+/// Whether the HDF5 library is built thread-safe.
+///
+/// Without a thread-safe build, libsonata serializes all calls to HDF5 with a
+/// process-wide lock. With one, it leaves this to HDF5, and threads only wait for
+/// each other while they are in HDF5.
+SONATA_API bool isHdf5ThreadSafe();
+
 /// Interface for implementing `readSelection<T>(dset, selection)`.
 template <class T>
 class Hdf5PluginRead1DInterface
@@ -34,9 +102,15 @@ class Hdf5PluginRead2DInterface
     ///
     /// Both selections are canonical, i.e. sorted and non-overlapping. The dataset
     /// is obtained from a `HighFive::File` opened via `this->openFile`.
-    virtual std::vector<std::array<uint64_t, 2>> readSelection(const HighFive::DataSet& dset,
-                                                               const Selection& xsel,
-                                                               const Selection& ysel) const = 0;
+    ///
+    /// The result is row-major. Numeric types hold one column each; arrays
+    /// `std::array<U, N>` hold `N` consecutive columns.
+    ///
+    /// By default, the selection is read like by a default `Hdf5Reader`; hence,
+    /// plugins only need to override this for the types they read differently.
+    virtual std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                         const Selection& xsel,
+                                         const Selection& ysel) const;
 };
 
 template <class T, class U>
@@ -138,11 +212,30 @@ class SONATA_API Hdf5Reader
 #endif
                                           std::string>;
 
-    using supported_2D_types = std::tuple<std::array<uint64_t, 2>>;
+    using supported_2D_types = std::tuple<uint8_t,
+                                          uint16_t,
+                                          uint32_t,
+                                          uint64_t,
+                                          int8_t,
+                                          int16_t,
+                                          int32_t,
+                                          int64_t,
+                                          float,
+                                          double,
+#ifdef __APPLE__
+                                          size_t,
+#endif
+                                          std::array<uint64_t, 2>>;
 
     /// Create a valid Hdf5Reader with the default plugin.
     Hdf5Reader();
 
+    /// Create an Hdf5Reader with the default plugin, reading with `strategy`.
+    explicit Hdf5Reader(Hdf5ReadStrategy strategy, const ReadPolicy& read_policy = ReadPolicy());
+
+    /// Create an Hdf5Reader with the default plugin, planning reads with `read_policy`.
+    explicit Hdf5Reader(const ReadPolicy& read_policy);
+
     /// Create an Hdf5Reader with a user supplied plugin.
     Hdf5Reader(std::shared_ptr<Hdf5PluginInterface<supported_1D_types, supported_2D_types>> impl);
 
@@ -166,6 +259,13 @@ class SONATA_API Hdf5Reader
     ///
     /// Both selections are canonical, i.e. sorted and non-overlapping. The dataset
     /// is obtained from a `HighFive::File` opened via `this->openFile`.
+    ///
+    /// The result is row-major, e.g. reading the columns `ysel` of the rows
+    /// `xsel` as `double` returns `xsel.flatSize() * ysel.flatSize()` values.
+    /// An `std::array<U, N>` holds `N` consecutive selected columns; hence,
+    /// `ysel.flatSize()` must be a multiple of `N`.
+    ///
+    /// @throw SonataError if the selected columns don't fit into `T`
     template <class T>
     std::vector<T> readSelection(const HighFive::DataSet& dset,
                                  const Selection& xsel,
@@ -179,5 +279,177 @@ class SONATA_API Hdf5Reader
     std::shared_ptr<Hdf5PluginInterface<supported_1D_types, supported_2D_types>> impl;
 };
 
+template <class T>
+std::vector<T> Hdf5PluginRead2DInterface<T>::readSelection(const HighFive::DataSet& dset,
+                                                           const Selection& xsel,
+                                                           const Selection& ysel) const {
+    return Hdf5Reader().readSelection<T>(dset, xsel, ysel);
+}
+
+/// Create an Hdf5Reader that decompresses chunks on `n_threads` threads.
+///
+/// HDF5 runs its filters, e.g. decompression, on the reading thread, while
+/// libsonata holds its HDF5 lock. For datasets that are chunked and compressed
+/// with deflate and/or shuffle, this reader fetches the raw chunks with
+/// `H5Dread_chunk` instead, and decompresses them and copies out the selected
+/// elements on a pool of `n_threads` worker threads; `0` means one per
+/// hardware thread. All other datasets are read like by `Hdf5Reader(read_policy)`.
+SONATA_API Hdf5Reader makeDirectChunkReader(size_t n_threads = 0,
+                                            const ReadPolicy& read_policy = ReadPolicy());
+
+/// Create an Hdf5Reader that reads contiguous datasets from a memory mapping.
+///
+/// The first time a dataset is read, its offset in the file is looked up with
+/// `H5Dget_offset` and the file is mapped, through the descriptor HDF5 has
+/// open; hence, it's the same file even if its path was replaced since. After
+/// that, reading a selection only asks HDF5 for the descriptor and the name of
+/// the dataset, and then copies each range out of the mapping with `memcpy`;
+/// any number of threads may copy concurrently. The mapping is released once
+/// HDF5 has closed the file. Datasets that are chunked, filtered, or whose
+/// elements need converting, and files that aren't opened with HDF5's default
+/// POSIX driver, are read like by `Hdf5Reader(read_policy)`.
+SONATA_API Hdf5Reader makeMmapReader(const ReadPolicy& read_policy = ReadPolicy());
+
+/// Create an Hdf5Reader that reads contiguous datasets with io_uring.
+///
+/// Scattered selections need many small reads, each a synchronous `H5Dread`
+/// by default. For contiguous datasets, this reader turns the ranges of a
+/// selection into byte ranges of the file, and submits them as one batch to
+/// an io_uring, keeping up to `queue_depth` reads in flight. Where io_uring
+/// isn't available, or if `queue_depth` is `0`, the byte ranges are read with
+/// `pread`. The file is opened again through the descriptor HDF5 has open,
+/// and closed once HDF5 has closed it. Datasets that are chunked, filtered, or
+/// whose elements need converting are read like by `Hdf5Reader(read_policy)`.
+SONATA_API Hdf5Reader makeIoUringReader(unsigned queue_depth = 128,
+                                        const ReadPolicy& read_policy = ReadPolicy());
+
+/// Create an Hdf5Reader that reads blocks ahead on a dedicated I/O thread.
+///
+/// Like `Hdf5Reader(read_policy)`, selections are read as merged blocks, and
+/// the selected elements are copied out of each block. By default, a block is
+/// only read once the previous one has been copied out. This reader keeps up to
+/// `prefetch_depth` reads queued on its I/O thread, while the calling thread
+/// copies out the elements of the blocks already read. Hence, reading overlaps
+/// with copying; the reads themselves are still one after the other, since HDF5
+/// can't be called concurrently. Up to `prefetch_depth + 1` blocks are held in
+/// memory at once.
+SONATA_API Hdf5Reader makePipelinedReader(size_t prefetch_depth = 2,
+                                          const ReadPolicy& read_policy = ReadPolicy());
+
+/// Counters of a `BlockCache`.
+struct SONATA_API BlockCacheStatistics {
+    /// Blocks that were cached, or were being read by another thread.
+    uint64_t hits = 0;
+    /// Blocks that had to be read.
+    uint64_t misses = 0;
+    /// Blocks that were dropped to stay within the budget.
+    uint64_t evictions = 0;
+    /// Bytes of the cached blocks.
+    size_t size_bytes = 0;
+};
+
+/// A least recently used cache of blocks of datasets, shared by readers.
+///
+/// Datasets are split into blocks of `block_bytes` bytes worth of rows. The cache
+/// keeps the most recently used blocks of all files and datasets, up to `max_bytes`
+/// in total. Copies share the same cache.
+///
+/// @sa makeCachingReader
+class SONATA_API BlockCache
+{
+  public:
+    explicit BlockCache(size_t max_bytes, size_t block_bytes = 64 << 10);
+
+    BlockCacheStatistics statistics() const;
+
+    /// Drop all blocks; the counters are kept.
+    void clear();
+
+  private:
+    std::shared_ptr<detail::BlockCacheImpl> impl;
+
+    friend SONATA_API Hdf5Reader makeCachingReader(const BlockCache& cache,
+                                                   const Hdf5Reader& reader);
+};
+
+/// Create an Hdf5Reader that reads through `cache`.
+///
+/// Each selection is widened to the blocks it touches. The blocks that aren't
+/// cached are read with one call to `reader`, which is made even if all blocks are
+/// cached, such that collective readers keep working. If several threads need the
+/// same block at once, only one of them reads it. All readers created from the same
+/// `cache`, e.g. those of the populations of a circuit, share its blocks.
+///
+/// Blocks are looked up by the file HDF5 has open, i.e. its device and inode, and
+/// its size and modification time; not by its path. Hence, files that are
+/// replaced are read again, and the same relative path opened from different
+/// directories doesn't mix up files. Files that aren't opened with HDF5's default
+/// POSIX driver only find their blocks while they stay open.
+SONATA_API Hdf5Reader makeCachingReader(const BlockCache& cache,
+                                        const Hdf5Reader& reader = Hdf5Reader());
+
+/// Distribution of the durations of one kind of operation.
+struct SONATA_API LatencyHistogram {
+    /// Number of operations.
+    uint64_t count = 0;
+    /// Sum of their durations.
+    double total_seconds = 0.0;
+    /// Duration of the slowest one.
+    double max_seconds = 0.0;
+    /// Number of operations by duration: `buckets[0]` took less than 1 us,
+    /// `buckets[k]` took `2^(k-1)` to `2^k` us; the last bucket has all longer
+    /// ones.
+    std::vector<uint64_t> buckets;
+};
+
+/// Counters of an `IoStatistics`.
+struct SONATA_API IoCounters {
+    /// Calls of `readSelection`.
+    uint64_t reads = 0;
+    /// Bytes of the selected elements.
+    uint64_t bytes_requested = 0;
+    /// Bytes read from files; more than requested if gaps between ranges were
+    /// read, or chunks were read whole.
+    uint64_t bytes_read = 0;
+    /// Blocks, i.e. merged ranges or raw chunks, read from files.
+    uint64_t blocks = 0;
+    /// Time spent waiting for the HDF5 lock.
+    double lock_wait_seconds = 0.0;
+    /// Durations of each kind of operation: `"readSelection"`, `"lock"`, and the
+    /// methods of populations, e.g. `"getAttribute"`.
+    std::map<std::string, LatencyHistogram> latencies;
+};
+
+/// Counters and latency histograms of reads, shared by readers and populations.
+///
+/// Nothing is measured unless a reader is created with `makeInstrumentedReader`,
+/// or a population is given the statistics with `Population::setIoStatistics`.
+/// Copies share the same counters. All methods are thread-safe.
+class SONATA_API IoStatistics
+{
+  public:
+    IoStatistics();
+
+    IoCounters counters() const;
+
+    /// Set all counters to zero.
+    void reset();
+
+  private:
+    std::shared_ptr<detail::IoStatisticsImpl> impl;
+
+    friend SONATA_API Hdf5Reader makeInstrumentedReader(const IoStatistics& statistics,
+                                                        const Hdf5Reader& reader);
+    friend class Population;
+};
+
+/// Create an Hdf5Reader that counts the reads of `reader` in `statistics`.
+///
+/// Every call is counted, with its requested bytes and duration. While `reader`
+/// reads, the bytes and blocks it reads from the file are counted too; by the
+/// default reader and those made by `make*Reader`.
+SONATA_API Hdf5Reader makeInstrumentedReader(const IoStatistics& statistics,
+                                             const Hdf5Reader& reader = Hdf5Reader());
+
 }  // namespace sonata
 }  // namespace bbp
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <bbp/sonata/hdf5_reader.h>
+
+namespace bbp {
+namespace sonata {
+
+/// Create an Hdf5Reader that reads collectively on `comm`, in two phases.
+///
+/// Only available if libsonata was built with `SONATA_MPI`. All ranks of `comm`
+/// must call every method of the reader collectively, i.e. libsonata must be
+/// used collectively, see `Hdf5Reader`.
+///
+/// If HDF5 supports MPI, files are opened with the MPI-IO driver on `comm`. To
+/// read a selection, the ranks first exchange the ranges they need. Their union
+/// is merged into large blocks, according to `read_policy`, and the blocks are
+/// split evenly among `n_aggregators` aggregator ranks. Each aggregator reads
+/// its blocks, and sends each rank the elements it selected. Hence, the file
+/// system sees few large reads, from a few ranks. `0` means one aggregator per
+/// node, i.e. per shared memory domain of `comm`.
+///
+/// The rows selected may differ between ranks, but the columns may not: a
+/// two-dimensional read throws on all ranks unless they pass the same `ysel`.
+///
+/// Selections of strings are read by every rank independently.
+SONATA_API Hdf5Reader makeCollectiveReader(MPI_Comm comm,
+                                           int n_aggregators = 0,
+                                           const ReadPolicy& read_policy = ReadPolicy());
+
+}  // namespace sonata
+}  // namespace bbp
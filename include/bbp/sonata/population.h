@@ -166,6 +166,37 @@ class SONATA_API Population
     template <typename T>
     Selection filterAttribute(const std::string& name, std::function<bool(const T)> pred) const;
 
+    /**
+     * Whether every thread reads through its own HDF5 file handle
+     */
+    bool fileHandlePerThread() const;
+
+    /**
+     * Open a separate HDF5 file handle for every thread that reads
+     *
+     * By default, all threads read through the handle opened with the population.
+     * With `enable`, each thread opens the file again, via the `Hdf5Reader`, the
+     * first time it reads; the handle is closed when the thread exits or the
+     * population is destroyed. Then, threads don't share any HDF5 objects. Only
+     * useful if HDF5 is built thread-safe, see `isHdf5ThreadSafe`; otherwise, all
+     * calls to HDF5 are serialized anyway.
+     */
+    void setFileHandlePerThread(bool enable);
+
+    /**
+     * Count the reads of this population in `statistics`
+     *
+     * Every call reading the file is timed, under the name of the method, e.g.
+     * "getAttribute"; as well as the time spent waiting for the HDF5 lock, as
+     * "lock". The blocks read by the `Hdf5Reader` are counted too.
+     */
+    void setIoStatistics(const IoStatistics& statistics);
+
+    /**
+     * Stop counting the reads of this population
+     */
+    void clearIoStatistics();
+
   protected:
     Population(const std::string& h5FilePath,
                const std::string& csvFilePath,
@@ -185,7 +185,9 @@ class SONATA_API ReportReader
             Selection::Ranges min_max_blocks;
         };
 
-        Population(const HighFive::File& file, const std::string& populationName);
+        Population(const HighFive::File& file,
+                   const std::string& populationName,
+                   size_t default_block_gap_limit);
         std::pair<size_t, size_t> getIndex(const nonstd::optional<double>& tstart,
                                            const nonstd::optional<double>& tstop) const;
         /**
@@ -211,12 +213,20 @@ class SONATA_API ReportReader
         std::string time_units_;
         std::string data_units_;
         bool is_node_ids_sorted_;
+        size_t default_block_gap_limit_;
 
         friend ReportReader;
     };
 
     explicit ReportReader(const std::string& filename);
 
+    /**
+     * Open a report whose data is read in blocks separated by gaps of at least
+     * 16777216 values, scaled by `read_policy.min_gap_bytes` relative to its default
+     * and no less than 4194304 values, unless a `block_gap_limit` is passed explicitly.
+     */
+    ReportReader(const std::string& filename, const ReadPolicy& read_policy);
+
     /**
      * Return a list of all population names.
      */
@@ -226,6 +236,7 @@ class SONATA_API ReportReader
 
   private:
     HighFive::File file_;
+    size_t default_block_gap_limit_;
 
     // Lazy loaded population
     mutable std::map<std::string, Population> populations_;
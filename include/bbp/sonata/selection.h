@@ -2,13 +2,24 @@
 
 #include "common.h"
 
+#include <cstddef>
 #include <cstdint>
-#include <utility>  // std::move
+#include <functional>  // std::function
+#include <iterator>    // std::forward_iterator_tag
+#include <memory>      // std::shared_ptr
+#include <string>
+#include <utility>     // std::move
 #include <vector>
 
 namespace bbp {
 namespace sonata {
 
+namespace detail {
+struct CanonicalRanges;
+struct RangeIndex;
+class CompressedSelection;
+}  // namespace detail
+
 class SONATA_API Selection
 {
   public:
@@ -17,16 +28,54 @@ class SONATA_API Selection
     using Range = std::array<Value, 2>;
     using Ranges = std::vector<Range>;
 
+    class const_iterator;
+
     /**
      * Create Selection from a list of ranges
      * @param ranges is a list of ranges constituting Selection
      */
     Selection(Ranges ranges);
 
+    Selection(const Selection& other);
+    Selection(Selection&&) noexcept = default;
+    Selection& operator=(const Selection& other);
+    Selection& operator=(Selection&&) noexcept = default;
+    ~Selection() = default;
+
     template <typename Iterator>
     static Selection fromValues(Iterator first, Iterator last);
     static Selection fromValues(const Values& values);
 
+    /**
+     * Create Selection from a contiguous array of IDs
+     *
+     * Same as the generic `fromValues`, but uses SIMD instructions to find the runs of
+     * consecutive IDs, if the CPU supports them.
+     */
+    static Selection fromValues(const Value* first, const Value* last);
+
+    /**
+     * Create Selection from a mask: the IDs `i` for which `mask[i]` is non-zero
+     *
+     * The result is canonical. Runs of set bytes are found a block at a time.
+     */
+    static Selection fromMask(const uint8_t* mask, size_t size);
+
+    /**
+     * Union of all `selections`
+     *
+     * This is a single k-way merge of the canonical ranges, rather than a sequence of pairwise
+     * unions. The result is canonical.
+     */
+    static Selection unionAll(const std::vector<Selection>& selections);
+
+    /**
+     * Intersection of all `selections`, empty if there are none
+     *
+     * This is a single k-way merge of the canonical ranges. The result is canonical.
+     */
+    static Selection intersectAll(const std::vector<Selection>& selections);
+
     /**
      * Get a list of ranges constituting Selection
      */
@@ -42,8 +91,37 @@ class SONATA_API Selection
      */
     size_t flatSize() const;
 
+    /**
+     * Write a mask of `size` bytes: `mask[i]` is 1 if `i` is in the Selection, 0 otherwise
+     *
+     * @throw SonataError if the Selection has IDs not less than `size`
+     */
+    void toMask(uint8_t* mask, size_t size) const;
+
     bool empty() const;
 
+    /**
+     * Iterate over the IDs constituting Selection, in the same order as `flatten()`
+     *
+     * Unlike `flatten()`, this doesn't allocate a vector of all the IDs, nor the ranges of a
+     * Selection which is stored compressed:
+     *
+     *     for (const auto id : selection) { ... }
+     *
+     * The iterators are invalidated when the Selection is destroyed or assigned to.
+     */
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /**
+     * Call `f(range)` for every range of the Selection
+     *
+     * The ranges are visited in the order of `ranges()`. Unlike `ranges()`, this doesn't
+     * materialize the ranges of a Selection which is stored compressed.
+     */
+    template <typename F>
+    void forEachRange(F f) const;
+
     /**
      * Check if Selection contains a given node id
      * @param node id to check
@@ -51,8 +129,159 @@ class SONATA_API Selection
      */
     bool contains(Value node_id) const;
 
+    /**
+     * Check which of the given node ids are contained in the Selection
+     *
+     * If `node_ids` is sorted, the lookup is a single merge pass over the canonical ranges,
+     * otherwise every id is looked up by binary search.
+     *
+     * @param node_ids to check
+     * @return a mask with `mask[i] == contains(node_ids[i])`
+     */
+    std::vector<bool> containsMany(const Values& node_ids) const;
+
+    /**
+     * Get the canonical ranges of the Selection
+     *
+     * The canonical ranges are sorted, non-overlapping and non-adjacent; they cover the same
+     * ids as `ranges()`. They are computed at most once, and shared between copies of the
+     * Selection. If `ranges()` is already canonical, it is returned as is.
+     */
+    const Ranges& canonicalRanges() const;
+
+    /**
+     * Get the ids in `[0, universe_size)` which are not part of the Selection
+     *
+     * Ids of the Selection that are not smaller than `universe_size` are ignored. For example,
+     * `population.selectAll()` is a universe of `population.size()` ids.
+     *
+     * @param universe_size number of ids in the universe
+     */
+    Selection complement(Value universe_size) const;
+
+    /**
+     * Get the `k`-th ID of the Selection, i.e. `flatten()[k]`
+     *
+     * Runs in O(log R), for R ranges; an index of the ranges is built on first use.
+     *
+     * @throw SonataError if `k >= flatSize()`
+     */
+    Value select(size_t k) const;
+
+    /**
+     * Get the position of `node_id` in the Selection, i.e. the smallest `k` such that
+     * `flatten()[k] == node_id`
+     *
+     * Runs in O(log R), for R ranges, unless ranges overlap; then it's O(R).
+     *
+     * @throw SonataError if `node_id` isn't part of the Selection
+     */
+    size_t rank(Value node_id) const;
+
+    /**
+     * Get the IDs at positions `[begin, end)` of the Selection, i.e. of `flatten()`
+     *
+     * As in Python, positions past the end are clipped, and if `begin >= end` the result is
+     * empty.
+     */
+    Selection slice(size_t begin, size_t end) const;
+
+    /**
+     * Get `k` distinct positions of the Selection at random, uniformly
+     *
+     * The sampled IDs are returned in the same order as they appear in the Selection. The
+     * result only depends on `seed` and the Selection, on any platform. If `k >= flatSize()`
+     * the whole Selection is returned.
+     */
+    Selection sample(size_t k, uint64_t seed = 0) const;
+
+    /**
+     * Split the Selection into `n` parts of nearly equal `flatSize()`
+     *
+     * The parts are consecutive: concatenating their IDs gives the IDs of the Selection, in
+     * the same order. Ranges are cut where needed. The sizes of any two parts differ by at
+     * most one; if there are fewer than `n` IDs, some parts are empty.
+     *
+     * @throw SonataError if `n` is 0
+     */
+    std::vector<Selection> partition(size_t n) const;
+
+    /**
+     * Split the Selection into `n` consecutive parts of nearly equal cost
+     *
+     * Same as `partition(n)`, except that the parts are balanced by the sum of the costs of
+     * their IDs rather than their number, e.g. to balance by number of edges per node.
+     *
+     * @param costs cost of every ID, in the same order as `flatten()`
+     * @throw SonataError if `n` is 0, the size of `costs` isn't `flatSize()`, or a cost is
+     * negative
+     */
+    std::vector<Selection> partition(size_t n, const std::vector<double>& costs) const;
+
+    /**
+     * Split the Selection into consecutive parts of `chunk_size` IDs
+     *
+     * All parts except for the last one have exactly `chunk_size` IDs.
+     *
+     * @throw SonataError if `chunk_size` is 0
+     */
+    std::vector<Selection> split(size_t chunk_size) const;
+
+    /**
+     * Serialize the Selection into a compact binary representation
+     *
+     * The ranges are delta and varint encoded after a short header with a format version.
+     * The order of `ranges()` is preserved. Selections with many short ranges typically need
+     * 2-3 bytes per range.
+     */
+    std::string serialize() const;
+
+    /**
+     * Create a Selection from the output of `serialize`
+     *
+     * @throw SonataError if `data` isn't a serialized Selection, or was serialized with an
+     * unsupported version of the format
+     */
+    static Selection deserialize(const char* data, size_t size);
+    static Selection deserialize(const std::string& data);
+
   private:
+    // Selection of `ranges`, stored compressed if they're canonical and that saves memory.
+    static Selection compacted(Ranges ranges);
+
+    static Selection fromCompressed(std::shared_ptr<const detail::CompressedSelection> compressed);
+
+    std::shared_ptr<const detail::CompressedSelection> asCompressed() const;
+
+    // Must not be called on an empty Selection.
+    const detail::RangeIndex& rangeIndex() const;
+
+    void forEachCompressedRange(const std::function<void(const Range&)>& f) const;
+
+    // The next range of a `const_iterator` over `compressed`, see `CompressedSelection::nextRange`.
+    static bool nextCompressedRange(const detail::CompressedSelection& compressed,
+                                    size_t& block,
+                                    uint32_t& position,
+                                    Range& range);
+
+    // Consecutive parts, the i-th one has `sizes[i]` ids; `sizes` must sum to `flatSize()`.
+    std::vector<Selection> splitBySizes(const std::vector<size_t>& sizes) const;
+
     Ranges ranges_;
+    // `nullptr` iff `ranges_` is canonical
+    std::shared_ptr<detail::CanonicalRanges> canonical_;
+    // Results of set operations, `fromValues` and `fromMask` with many short
+    // ranges are stored compressed; then `ranges_` is empty and the ranges are
+    // only materialized if requested. Ranges passed by the caller are kept.
+    std::shared_ptr<const detail::CompressedSelection> compressed_;
+    // Prefix sums over `ranges()` for positional queries; built on first use,
+    // hence only accessed with `std::atomic_load` and friends.
+    mutable std::shared_ptr<const detail::RangeIndex> index_;
+
+    friend Selection operator&(const Selection&, const Selection&);
+    friend Selection operator|(const Selection&, const Selection&);
+    friend Selection operator-(const Selection&, const Selection&);
+    friend Selection operator^(const Selection&, const Selection&);
 };
 
 bool SONATA_API operator==(const Selection&, const Selection&);
@@ -60,6 +289,130 @@ bool SONATA_API operator!=(const Selection&, const Selection&);
 
 Selection SONATA_API operator&(const Selection&, const Selection&);
 Selection SONATA_API operator|(const Selection&, const Selection&);
+/// Ids in `lhs` but not in `rhs`
+Selection SONATA_API operator-(const Selection& lhs, const Selection& rhs);
+/// Ids in exactly one of `lhs` and `rhs`
+Selection SONATA_API operator^(const Selection& lhs, const Selection& rhs);
+
+class Selection::const_iterator
+{
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Value*;
+    using reference = const Value&;
+
+    const_iterator() = default;
+
+    reference operator*() const {
+        return value_;
+    }
+
+    pointer operator->() const {
+        return &value_;
+    }
+
+    const_iterator& operator++() {
+        if (++value_ == end_of_range_) {
+            nextRange();
+        }
+        return *this;
+    }
+
+    const_iterator operator++(int) {
+        const_iterator tmp = *this;
+        ++(*this);
+        return tmp;
+    }
+
+    bool operator==(const const_iterator& other) const {
+        return range_ == other.range_ && block_ == other.block_ &&
+               position_ == other.position_ && value_ == other.value_;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+        return !(*this == other);
+    }
+
+  private:
+    friend class Selection;
+
+    // Over the ranges `[range, end)`.
+    const_iterator(const Range* range, const Range* end)
+        : range_(range)
+        , end_(end) {
+        if (range_ != end_) {
+            value_ = std::get<0>(*range_);
+            end_of_range_ = std::get<1>(*range_);
+        }
+    }
+
+    // Over `compressed`, from the start if `begin`, else at the end.
+    const_iterator(const detail::CompressedSelection* compressed, bool begin)
+        : compressed_(compressed) {
+        if (begin) {
+            nextRange();
+        } else {
+            block_ = at_end;
+        }
+    }
+
+    void nextRange() {
+        if (compressed_ != nullptr) {
+            Range range;
+            if (Selection::nextCompressedRange(*compressed_, block_, position_, range)) {
+                value_ = std::get<0>(range);
+                end_of_range_ = std::get<1>(range);
+            } else {
+                *this = const_iterator(compressed_, false);
+            }
+        } else if (++range_ != end_) {
+            value_ = std::get<0>(*range_);
+            end_of_range_ = std::get<1>(*range_);
+        } else {
+            value_ = end_of_range_ = 0;
+        }
+    }
+
+    static constexpr size_t at_end = ~size_t(0);
+
+    // Either the ranges, or a cursor into the compressed Selection.
+    const Range* range_ = nullptr;
+    const Range* end_ = nullptr;
+    const detail::CompressedSelection* compressed_ = nullptr;
+    size_t block_ = 0;
+    uint32_t position_ = 0;
+
+    Value value_ = 0;
+    Value end_of_range_ = 0;
+};
+
+inline Selection::const_iterator Selection::begin() const {
+    if (compressed_) {
+        return {compressed_.get(), true};
+    }
+    return {ranges_.data(), ranges_.data() + ranges_.size()};
+}
+
+inline Selection::const_iterator Selection::end() const {
+    if (compressed_) {
+        return {compressed_.get(), false};
+    }
+    return {ranges_.data() + ranges_.size(), ranges_.data() + ranges_.size()};
+}
+
+template <typename F>
+void Selection::forEachRange(F f) const {
+    if (compressed_) {
+        forEachCompressedRange(std::ref(f));
+        return;
+    }
+
+    for (const auto& range : ranges_) {
+        f(range);
+    }
+}
 
 template <typename Iterator>
 Selection Selection::fromValues(Iterator first, Iterator last) {
@@ -84,7 +437,7 @@ Selection Selection::fromValues(Iterator first, Iterator last) {
         ranges.push_back(range);
     }
 
-    return Selection(std::move(ranges));
+    return compacted(std::move(ranges));
 }
 
 }  // namespace sonata
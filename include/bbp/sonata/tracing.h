@@ -0,0 +1,43 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#pragma once
+
+#include <string>
+
+#include <bbp/sonata/common.h>
+
+namespace bbp {
+namespace sonata {
+
+/// Name of the environment variable that starts tracing when the library is loaded.
+///
+/// Its value is the path of the trace file, which is written when the process exits.
+constexpr const char* const TRACE_ENVIRONMENT_VARIABLE = "SONATA_TRACE";
+
+/// Start recording the operations of the library, for `stopTracing` to write to `path`.
+///
+/// Attribute reads, `_readSelection`, edge index lookups, the rules of node sets,
+/// the blocks read by reports and waiting for the HDF5 lock are recorded as pairs
+/// of begin and end events, with the ID of their thread and the bytes they read.
+/// The file is in the Chrome trace event format, and can be opened in Perfetto or
+/// `chrome://tracing`. A trace that's already being recorded is written first.
+SONATA_API void startTracing(const std::string& path);
+
+/// Write the events recorded since `startTracing`, and stop recording.
+///
+/// Does nothing if no trace is being recorded. If the process exits while
+/// recording, the trace is written too.
+SONATA_API void stopTracing();
+
+/// Whether a trace is being recorded.
+SONATA_API bool isTracing();
+
+}  // namespace sonata
+}  // namespace bbp
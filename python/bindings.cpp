@@ -10,6 +10,7 @@
 #include <bbp/sonata/nodes.h>
 #include <bbp/sonata/optional.hpp>  //nonstd::optional
 #include <bbp/sonata/report_reader.h>
+#include <bbp/sonata/tracing.h>
 #include <bbp/sonata/variant.hpp>  //nonstd::variant
 
 #include "generated/docstrings.h"
@@ -202,6 +203,15 @@ py::class_<Population, std::shared_ptr<Population>> bindPopulationClass(py::modu
                  return fmt::format("{} [name={}, count={}]", clsName, obj.name(), obj.size());
              })
         .def("select_all", &Population::selectAll, imbueElementName(DOC_POP(selectAll)).c_str())
+        .def_property("file_handle_per_thread",
+                      &Population::fileHandlePerThread,
+                      &Population::setFileHandlePerThread,
+                      DOC_POP(setFileHandlePerThread))
+        .def("set_io_statistics",
+             &Population::setIoStatistics,
+             py::arg("statistics"),
+             DOC_POP(setIoStatistics))
+        .def("clear_io_statistics", &Population::clearIoStatistics, DOC_POP(clearIoStatistics))
         .def("enumeration_values",
              &Population::enumerationValues,
              py::arg("name"),
@@ -420,7 +430,122 @@ void bindReportReader(py::module& m, const std::string& prefix) {
 
 
 PYBIND11_MODULE(_libsonata, m) {
-    py::class_<Hdf5Reader>(m, "Hdf5Reader").def(py::init([]() { return Hdf5Reader(); }));
+    py::class_<ReadPolicy>(m, "ReadPolicy", DOC(bbp, sonata, ReadPolicy))
+        .def(py::init<>())
+        .def_readwrite("min_gap_bytes",
+                       &ReadPolicy::min_gap_bytes,
+                       DOC(bbp, sonata, ReadPolicy, min_gap_bytes))
+        .def_readwrite("max_block_bytes",
+                       &ReadPolicy::max_block_bytes,
+                       DOC(bbp, sonata, ReadPolicy, max_block_bytes))
+        .def_readwrite("max_block_bytes_2d",
+                       &ReadPolicy::max_block_bytes_2d,
+                       DOC(bbp, sonata, ReadPolicy, max_block_bytes_2d))
+        .def_readwrite("max_over_read_ratio",
+                       &ReadPolicy::max_over_read_ratio,
+                       DOC(bbp, sonata, ReadPolicy, max_over_read_ratio))
+        .def_readwrite("max_buffer_bytes",
+                       &ReadPolicy::max_buffer_bytes,
+                       DOC(bbp, sonata, ReadPolicy, max_buffer_bytes))
+        .def_static("calibrate",
+                    &ReadPolicy::calibrate,
+                    "path"_a,
+                    DOC(bbp, sonata, ReadPolicy, calibrate));
+
+    m.def("is_hdf5_thread_safe", &isHdf5ThreadSafe, DOC(bbp, sonata, isHdf5ThreadSafe));
+
+    m.def("start_tracing", &startTracing, "path"_a, DOC(bbp, sonata, startTracing));
+    m.def("stop_tracing", &stopTracing, DOC(bbp, sonata, stopTracing));
+    m.def("is_tracing", &isTracing, DOC(bbp, sonata, isTracing));
+
+    py::class_<Hdf5Reader>(m, "Hdf5Reader")
+        .def(py::init([]() { return Hdf5Reader(); }))
+        .def(py::init<const ReadPolicy&>(), "read_policy"_a);
+
+    m.def("make_direct_chunk_reader",
+          &makeDirectChunkReader,
+          "n_threads"_a = 0,
+          "read_policy"_a = ReadPolicy(),
+          DOC(bbp, sonata, makeDirectChunkReader));
+
+    m.def("make_mmap_reader",
+          &makeMmapReader,
+          "read_policy"_a = ReadPolicy(),
+          DOC(bbp, sonata, makeMmapReader));
+
+    m.def("make_io_uring_reader",
+          &makeIoUringReader,
+          "queue_depth"_a = 128,
+          "read_policy"_a = ReadPolicy(),
+          DOC(bbp, sonata, makeIoUringReader));
+
+    m.def("make_pipelined_reader",
+          &makePipelinedReader,
+          "prefetch_depth"_a = 2,
+          "read_policy"_a = ReadPolicy(),
+          DOC(bbp, sonata, makePipelinedReader));
+
+    py::class_<BlockCacheStatistics>(m,
+                                     "BlockCacheStatistics",
+                                     DOC(bbp, sonata, BlockCacheStatistics))
+        .def_readonly("hits",
+                      &BlockCacheStatistics::hits,
+                      DOC(bbp, sonata, BlockCacheStatistics, hits))
+        .def_readonly("misses",
+                      &BlockCacheStatistics::misses,
+                      DOC(bbp, sonata, BlockCacheStatistics, misses))
+        .def_readonly("evictions",
+                      &BlockCacheStatistics::evictions,
+                      DOC(bbp, sonata, BlockCacheStatistics, evictions))
+        .def_readonly("size_bytes",
+                      &BlockCacheStatistics::size_bytes,
+                      DOC(bbp, sonata, BlockCacheStatistics, size_bytes));
+
+    py::class_<BlockCache>(m, "BlockCache", DOC(bbp, sonata, BlockCache))
+        .def(py::init<size_t, size_t>(), "max_bytes"_a, "block_bytes"_a = 64 << 10)
+        .def_property_readonly("statistics",
+                               &BlockCache::statistics,
+                               DOC(bbp, sonata, BlockCache, statistics))
+        .def("clear", &BlockCache::clear, DOC(bbp, sonata, BlockCache, clear));
+
+    m.def("make_caching_reader",
+          &makeCachingReader,
+          "cache"_a,
+          "hdf5_reader"_a = Hdf5Reader(),
+          DOC(bbp, sonata, makeCachingReader));
+
+    py::class_<IoStatistics>(m, "IoStatistics", DOC(bbp, sonata, IoStatistics))
+        .def(py::init<>())
+        .def(
+            "as_dict",
+            [](const IoStatistics& statistics) {
+                const auto counters = statistics.counters();
+
+                py::dict latencies;
+                for (const auto& it : counters.latencies) {
+                    const auto& histogram = it.second;
+                    latencies[py::str(it.first)] = py::dict("count"_a = histogram.count,
+                                                            "total_seconds"_a =
+                                                                histogram.total_seconds,
+                                                            "max_seconds"_a = histogram.max_seconds,
+                                                            "buckets"_a = histogram.buckets);
+                }
+
+                return py::dict("reads"_a = counters.reads,
+                                "bytes_requested"_a = counters.bytes_requested,
+                                "bytes_read"_a = counters.bytes_read,
+                                "blocks"_a = counters.blocks,
+                                "lock_wait_seconds"_a = counters.lock_wait_seconds,
+                                "latencies"_a = latencies);
+            },
+            "The counters, as a dict; see `IoCounters` and `LatencyHistogram`")
+        .def("reset", &IoStatistics::reset, DOC(bbp, sonata, IoStatistics, reset));
+
+    m.def("make_instrumented_reader",
+          &makeInstrumentedReader,
+          "statistics"_a,
+          "hdf5_reader"_a = Hdf5Reader(),
+          DOC(bbp, sonata, makeInstrumentedReader));
 
     py::class_<Selection>(m,
                           "Selection",
@@ -464,6 +589,24 @@ PYBIND11_MODULE(_libsonata, m) {
              }),
              "values"_a,
              "Selection from list of IDs: passing np.array with dtype np.uint64 is faster")
+        .def_static(
+            "from_mask",
+            [](py::array_t<bool, py::array::c_style | py::array::forcecast> mask) {
+                const auto raw = mask.unchecked<1>();
+                return Selection::fromMask(reinterpret_cast<const uint8_t*>(raw.data(0)),
+                                           static_cast<size_t>(raw.shape(0)));
+            },
+            "mask"_a,
+            DOC_SEL(fromMask))
+        .def(
+            "to_mask",
+            [](const Selection& obj, size_t size) {
+                py::array_t<bool> mask(static_cast<py::ssize_t>(size));
+                obj.toMask(reinterpret_cast<uint8_t*>(mask.mutable_data()), size);
+                return mask;
+            },
+            "size"_a,
+            DOC_SEL(toMask))
         .def_property_readonly(
             "ranges",
             [](const Selection& obj) {
@@ -484,6 +627,23 @@ PYBIND11_MODULE(_libsonata, m) {
             "__contains__",
             [](const Selection& sel, uint64_t node_id) { return sel.contains(node_id); },
             DOC_SEL(nodeId))
+        .def(
+            "contains_many",
+            [](const Selection& sel,
+               py::array_t<uint64_t, py::array::c_style | py::array::forcecast> node_ids) {
+                const auto raw = node_ids.unchecked<1>();
+                const auto mask = sel.containsMany(
+                    Selection::Values(raw.data(0), raw.data(raw.shape(0))));
+
+                py::array_t<bool> result(static_cast<py::ssize_t>(mask.size()));
+                auto out = result.mutable_unchecked<1>();
+                for (size_t i = 0; i < mask.size(); ++i) {
+                    out(i) = mask[i];
+                }
+                return result;
+            },
+            "node_ids"_a,
+            DOC_SEL(containsMany))
         .def(
             "__bool__",
             [](const Selection& obj) { return !obj.empty(); },
@@ -492,6 +652,37 @@ PYBIND11_MODULE(_libsonata, m) {
         .def("__ne__", &bbp::sonata::operator!=, "Compare selection contents are not equal")
         .def("__or__", &bbp::sonata::operator|, "Union of selections")
         .def("__and__", &bbp::sonata::operator&, "Intersection of selections")
+        .def("__sub__", &bbp::sonata::operator-, "Difference of selections")
+        .def("__xor__", &bbp::sonata::operator^, "Symmetric difference of selections")
+        .def("complement", &Selection::complement, "universe_size"_a, DOC_SEL(complement))
+        .def("select", &Selection::select, "k"_a, DOC_SEL(select))
+        .def("rank", &Selection::rank, "node_id"_a, DOC_SEL(rank))
+        .def("slice", &Selection::slice, "begin"_a, "end"_a, DOC_SEL(slice))
+        .def("sample", &Selection::sample, "k"_a, "seed"_a = 0, DOC_SEL(sample))
+        .def("partition",
+             py::overload_cast<size_t>(&Selection::partition, py::const_),
+             "n"_a,
+             DOC_SEL(partition))
+        .def("partition",
+             py::overload_cast<size_t, const std::vector<double>&>(&Selection::partition,
+                                                                   py::const_),
+             "n"_a,
+             "costs"_a,
+             DOC_SEL(partition_2))
+        .def("split", &Selection::split, "chunk_size"_a, DOC_SEL(split))
+        .def(
+            "serialize",
+            [](const Selection& obj) { return py::bytes(obj.serialize()); },
+            DOC_SEL(serialize))
+        .def_static(
+            "deserialize",
+            [](const py::bytes& data) { return Selection::deserialize(std::string(data)); },
+            "data"_a,
+            DOC_SEL(deserialize))
+        .def(py::pickle([](const Selection& obj) { return py::bytes(obj.serialize()); },
+                        [](const py::bytes& data) {
+                            return Selection::deserialize(std::string(data));
+                        }))
         .def("__repr__", [](Selection& obj) {
             const auto& ranges = obj.ranges();
             const size_t max_count = 10;
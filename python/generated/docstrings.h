@@ -23,6 +23,34 @@
 #endif
 
 
+static const char *__doc_bbp_sonata_BlockCache =
+R"doc(A least recently used cache of blocks of datasets, shared by readers.
+
+Datasets are split into blocks of `block_bytes` bytes worth of rows.
+The cache keeps the most recently used blocks of all files and
+datasets, up to `max_bytes` in total. Copies share the same cache.
+
+See also:
+    makeCachingReader)doc";
+
+static const char *__doc_bbp_sonata_BlockCacheStatistics = R"doc(Counters of a `BlockCache`.)doc";
+
+static const char *__doc_bbp_sonata_BlockCacheStatistics_evictions = R"doc(Blocks that were dropped to stay within the budget.)doc";
+
+static const char *__doc_bbp_sonata_BlockCacheStatistics_hits = R"doc(Blocks that were cached, or were being read by another thread.)doc";
+
+static const char *__doc_bbp_sonata_BlockCacheStatistics_misses = R"doc(Blocks that had to be read.)doc";
+
+static const char *__doc_bbp_sonata_BlockCacheStatistics_size_bytes = R"doc(Bytes of the cached blocks.)doc";
+
+static const char *__doc_bbp_sonata_BlockCache_BlockCache = R"doc()doc";
+
+static const char *__doc_bbp_sonata_BlockCache_clear = R"doc(Drop all blocks; the counters are kept.)doc";
+
+static const char *__doc_bbp_sonata_BlockCache_impl = R"doc()doc";
+
+static const char *__doc_bbp_sonata_BlockCache_statistics = R"doc()doc";
+
 static const char *__doc_bbp_sonata_CircuitConfig = R"doc(Read access to a SONATA circuit config file.)doc";
 
 static const char *__doc_bbp_sonata_CircuitConfig_CircuitConfig =
@@ -221,7 +249,14 @@ R"doc(Read the Cartesian product of the two selections.
 
 Both selections are canonical, i.e. sorted and non-overlapping. The
 dataset is obtained from a `HighFive::File` opened via
-`this->openFile`.)doc";
+`this->openFile`.
+
+The result is row-major. Numeric types hold one column each; arrays
+`std::array<U, N>` hold `N` consecutive columns.
+
+By default, the selection is read like by a default `Hdf5Reader`;
+hence, plugins only need to override this for the types they read
+differently.)doc";
 
 static const char *__doc_bbp_sonata_Hdf5Reader =
 R"doc(Abstraction for reading HDF5 datasets.
@@ -292,7 +327,63 @@ R"doc(Read the Cartesian product of the two selections.
 
 Both selections are canonical, i.e. sorted and non-overlapping. The
 dataset is obtained from a `HighFive::File` opened via
-`this->openFile`.)doc";
+`this->openFile`.
+
+The result is row-major, e.g. reading the columns `ysel` of the rows
+`xsel` as `double` returns `xsel.flatSize() * ysel.flatSize()`
+values. An `std::array<U, N>` holds `N` consecutive selected columns;
+hence, `ysel.flatSize()` must be a multiple of `N`.
+
+Throws:
+    SonataError if the selected columns don't fit into `T`)doc";
+
+static const char *__doc_bbp_sonata_IoCounters = R"doc(Counters of an `IoStatistics`.)doc";
+
+static const char *__doc_bbp_sonata_IoCounters_blocks = R"doc(Blocks, i.e. merged ranges or raw chunks, read from files.)doc";
+
+static const char *__doc_bbp_sonata_IoCounters_bytes_read =
+R"doc(Bytes read from files; more than requested if gaps between ranges were
+read, or chunks were read whole.)doc";
+
+static const char *__doc_bbp_sonata_IoCounters_bytes_requested = R"doc(Bytes of the selected elements.)doc";
+
+static const char *__doc_bbp_sonata_IoCounters_latencies =
+R"doc(Durations of each kind of operation: `"readSelection"`, `"lock"`, and
+the methods of populations, e.g. `"getAttribute"`.)doc";
+
+static const char *__doc_bbp_sonata_IoCounters_lock_wait_seconds = R"doc(Time spent waiting for the HDF5 lock.)doc";
+
+static const char *__doc_bbp_sonata_IoCounters_reads = R"doc(Calls of `readSelection`.)doc";
+
+static const char *__doc_bbp_sonata_IoStatistics =
+R"doc(Counters and latency histograms of reads, shared by readers and
+populations.
+
+Nothing is measured unless a reader is created with
+`makeInstrumentedReader`, or a population is given the statistics with
+`Population::setIoStatistics`. Copies share the same counters. All
+methods are thread-safe.)doc";
+
+static const char *__doc_bbp_sonata_IoStatistics_IoStatistics = R"doc()doc";
+
+static const char *__doc_bbp_sonata_IoStatistics_counters = R"doc()doc";
+
+static const char *__doc_bbp_sonata_IoStatistics_impl = R"doc()doc";
+
+static const char *__doc_bbp_sonata_IoStatistics_reset = R"doc(Set all counters to zero.)doc";
+
+static const char *__doc_bbp_sonata_LatencyHistogram = R"doc(Distribution of the durations of one kind of operation.)doc";
+
+static const char *__doc_bbp_sonata_LatencyHistogram_buckets =
+R"doc(Number of operations by duration: `buckets[0]` took less than 1 us,
+`buckets[k]` took `2^(k-1)` to `2^k` us; the last bucket has all
+longer ones.)doc";
+
+static const char *__doc_bbp_sonata_LatencyHistogram_count = R"doc(Number of operations.)doc";
+
+static const char *__doc_bbp_sonata_LatencyHistogram_max_seconds = R"doc(Duration of the slowest one.)doc";
+
+static const char *__doc_bbp_sonata_LatencyHistogram_total_seconds = R"doc(Sum of their durations.)doc";
 
 static const char *__doc_bbp_sonata_NodePopulation = R"doc()doc";
 
@@ -469,6 +560,8 @@ static const char *__doc_bbp_sonata_Population_attributeNames =
 R"doc(All attribute names (CSV columns + required attributes + union of
 attributes in groups))doc";
 
+static const char *__doc_bbp_sonata_Population_clearIoStatistics = R"doc(Stop counting the reads of this population)doc";
+
 static const char *__doc_bbp_sonata_Population_dynamicsAttributeDataType =
 R"doc(Get dynamics attribute data type
 
@@ -494,6 +587,8 @@ Parameter ``name``:
 Throws:
     if there is no such attribute for the population)doc";
 
+static const char *__doc_bbp_sonata_Population_fileHandlePerThread = R"doc(Whether every thread reads through its own HDF5 file handle)doc";
+
 static const char *__doc_bbp_sonata_Population_filterAttribute = R"doc()doc";
 
 static const char *__doc_bbp_sonata_Population_getAttribute =
@@ -595,8 +690,65 @@ static const char *__doc_bbp_sonata_Population_name = R"doc(Name of the populati
 
 static const char *__doc_bbp_sonata_Population_selectAll = R"doc(Selection covering all elements)doc";
 
+static const char *__doc_bbp_sonata_Population_setFileHandlePerThread =
+R"doc(Open a separate HDF5 file handle for every thread that reads
+
+By default, all threads read through the handle opened with the
+population. With `enable`, each thread opens the file again, via the
+`Hdf5Reader`, the first time it reads; the handle is closed when the
+thread exits or the population is destroyed. Then, threads don't share
+any HDF5 objects. Only useful if HDF5 is built thread-safe, see
+`isHdf5ThreadSafe`; otherwise, all calls to HDF5 are serialized anyway.)doc";
+
+static const char *__doc_bbp_sonata_Population_setIoStatistics =
+R"doc(Count the reads of this population in `statistics`
+
+Every call reading the file is timed, under the name of the method,
+e.g. "getAttribute"; as well as the time spent waiting for the HDF5
+lock, as "lock". The blocks read by the `Hdf5Reader` are counted too.)doc";
+
 static const char *__doc_bbp_sonata_Population_size = R"doc(Total number of elements)doc";
 
+static const char *__doc_bbp_sonata_ReadPolicy =
+R"doc(Parameters for planning reads of the default plugin.
+
+Selections are read by merging nearby ranges into larger blocks,
+reading each block into a buffer, and copying the selected elements
+out of it. All sizes are in bytes, so the same policy applies to
+datasets of any type.
+
+The defaults suit a parallel file system with large blocks. Use
+`ReadPolicy::calibrate` to derive them from the storage a file is on.)doc";
+
+static const char *__doc_bbp_sonata_ReadPolicy_calibrate =
+R"doc(Measure the latency and bandwidth of reading the file at `path`, and
+pick a policy for it.
+
+A gap is worth reading if that's faster than starting a new read,
+i.e. `min_gap_bytes` is latency times bandwidth; blocks are made large
+enough to amortize the latency. Only `min_gap_bytes` and
+`max_block_bytes` are set. The file is read with plain POSIX I/O; if
+it's in the page cache, the page cache is measured.
+
+Throws:
+    SonataError if the file can't be read)doc";
+
+static const char *__doc_bbp_sonata_ReadPolicy_max_block_bytes = R"doc(Stop merging ranges into a block once it's at least this large.)doc";
+
+static const char *__doc_bbp_sonata_ReadPolicy_max_block_bytes_2d =
+R"doc(Like `max_block_bytes`, for the blocks of rows and columns of
+two-dimensional reads; by default, 128 times the minimum gap.)doc";
+
+static const char *__doc_bbp_sonata_ReadPolicy_max_buffer_bytes =
+R"doc(Don't merge ranges if the block would then be larger than this; a
+single range larger than this is still read as one block.)doc";
+
+static const char *__doc_bbp_sonata_ReadPolicy_max_over_read_ratio =
+R"doc(Don't merge ranges if the block would then contain more than this
+many times the bytes that were selected.)doc";
+
+static const char *__doc_bbp_sonata_ReadPolicy_min_gap_bytes = R"doc(Ranges separated by a gap of less than this are read as one block.)doc";
+
 static const char *__doc_bbp_sonata_ReportReader = R"doc()doc";
 
 static const char *__doc_bbp_sonata_ReportReader_Population = R"doc()doc";
@@ -712,20 +864,148 @@ static const char *__doc_bbp_sonata_Selection = R"doc()doc";
 
 static const char *__doc_bbp_sonata_Selection_Selection = R"doc()doc";
 
+static const char *__doc_bbp_sonata_Selection_canonicalRanges =
+R"doc(Get the canonical ranges of the Selection
+
+The canonical ranges are sorted, non-overlapping and non-adjacent;
+they cover the same ids as `ranges()`. They are computed at most once,
+and shared between copies of the Selection. If `ranges()` is already
+canonical, it is returned as is.)doc";
+
+static const char *__doc_bbp_sonata_Selection_canonical = R"doc()doc";
+
+static const char *__doc_bbp_sonata_Selection_complement =
+R"doc(Get the ids in `[0, universe_size)` which are not part of the
+Selection
+
+Ids of the Selection that are not smaller than `universe_size` are
+ignored. For example, `population.selectAll()` is a universe of
+`population.size()` ids.
+
+Parameter ``universe_size``:
+    number of ids in the universe)doc";
+
+static const char *__doc_bbp_sonata_Selection_containsMany =
+R"doc(Check which of the given node ids are contained in the Selection
+
+If `node_ids` is sorted, the lookup is a single merge pass over the
+canonical ranges, otherwise every id is looked up by binary search.
+
+Parameter ``node_ids``:
+    to check
+
+Returns:
+    a mask with `mask[i] == contains(node_ids[i])`)doc";
+
+static const char *__doc_bbp_sonata_Selection_deserialize =
+R"doc(Create a Selection from the output of `serialize`
+
+Throws:
+    SonataError if `data` isn't a serialized Selection, or was
+    serialized with an unsupported version of the format)doc";
+
+static const char *__doc_bbp_sonata_Selection_deserialize_2 = R"doc()doc";
+
 static const char *__doc_bbp_sonata_Selection_empty = R"doc()doc";
 
 static const char *__doc_bbp_sonata_Selection_flatSize = R"doc(Total number of elements constituting Selection)doc";
 
 static const char *__doc_bbp_sonata_Selection_flatten = R"doc(Array of IDs constituting Selection)doc";
 
+static const char *__doc_bbp_sonata_Selection_fromMask =
+R"doc(Create Selection from a mask: the IDs `i` for which `mask[i]` is non-
+zero
+
+The result is canonical. Runs of set bytes are found a block at a
+time.)doc";
+
 static const char *__doc_bbp_sonata_Selection_fromValues = R"doc()doc";
 
 static const char *__doc_bbp_sonata_Selection_fromValues_2 = R"doc()doc";
 
+static const char *__doc_bbp_sonata_Selection_partition =
+R"doc(Split the Selection into `n` parts of nearly equal `flatSize()`
+
+The parts are consecutive: concatenating their IDs gives the IDs of
+the Selection, in the same order. Ranges are cut where needed. The
+sizes of any two parts differ by at most one; if there are fewer than
+`n` IDs, some parts are empty.
+
+Throws:
+    SonataError if `n` is 0)doc";
+
+static const char *__doc_bbp_sonata_Selection_partition_2 =
+R"doc(Split the Selection into `n` consecutive parts of nearly equal cost
+
+Same as `partition(n)`, except that the parts are balanced by the sum
+of the costs of their IDs rather than their number, e.g. to balance by
+number of edges per node.
+
+Parameter ``costs``:
+    cost of every ID, in the same order as `flatten()`
+
+Throws:
+    SonataError if `n` is 0, the size of `costs` isn't `flatSize()`,
+    or a cost is negative)doc";
+
+static const char *__doc_bbp_sonata_Selection_rank =
+R"doc(Get the position of `node_id` in the Selection, i.e. the smallest `k`
+such that `flatten()[k] == node_id`
+
+Runs in O(log R), for R ranges, unless ranges overlap; then it's O(R).
+
+Throws:
+    SonataError if `node_id` isn't part of the Selection)doc";
+
 static const char *__doc_bbp_sonata_Selection_ranges = R"doc(Get a list of ranges constituting Selection)doc";
 
 static const char *__doc_bbp_sonata_Selection_ranges_2 = R"doc()doc";
 
+static const char *__doc_bbp_sonata_Selection_sample =
+R"doc(Get `k` distinct positions of the Selection at random, uniformly
+
+The sampled IDs are returned in the same order as they appear in the
+Selection. The result only depends on `seed` and the Selection, on
+any platform. If `k >= flatSize()` the whole Selection is returned.)doc";
+
+static const char *__doc_bbp_sonata_Selection_select =
+R"doc(Get the `k`-th ID of the Selection, i.e. `flatten()[k]`
+
+Runs in O(log R), for R ranges; an index of the ranges is built on
+first use.
+
+Throws:
+    SonataError if `k >= flatSize()`)doc";
+
+static const char *__doc_bbp_sonata_Selection_serialize =
+R"doc(Serialize the Selection into a compact binary representation
+
+The ranges are delta and varint encoded after a short header with a
+format version. The order of `ranges()` is preserved. Selections with
+many short ranges typically need 2-3 bytes per range.)doc";
+
+static const char *__doc_bbp_sonata_Selection_slice =
+R"doc(Get the IDs at positions `[begin, end)` of the Selection, i.e. of
+`flatten()`
+
+As in Python, positions past the end are clipped, and if `begin >=
+end` the result is empty.)doc";
+
+static const char *__doc_bbp_sonata_Selection_split =
+R"doc(Split the Selection into consecutive parts of `chunk_size` IDs
+
+All parts except for the last one have exactly `chunk_size` IDs.
+
+Throws:
+    SonataError if `chunk_size` is 0)doc";
+
+static const char *__doc_bbp_sonata_Selection_toMask =
+R"doc(Write a mask of `size` bytes: `mask[i]` is 1 if `i` is in the
+Selection, 0 otherwise
+
+Throws:
+    SonataError if the Selection has IDs not less than `size`)doc";
+
 static const char *__doc_bbp_sonata_Selection_nodeId = R"doc(Check if a node id is contained in the selection)doc";
 
 static const char *__doc_bbp_sonata_SimulationConfig = R"doc(Read access to a SONATA simulation config file.)doc";
@@ -1413,6 +1693,92 @@ static const char *__doc_bbp_sonata_fromValues = R"doc()doc";
 
 static const char *__doc_bbp_sonata_getAttribute = R"doc()doc";
 
+static const char *__doc_bbp_sonata_isHdf5ThreadSafe =
+R"doc(Whether the HDF5 library is built thread-safe.
+
+Without a thread-safe build, libsonata serializes all calls to HDF5
+with a process-wide lock. With one, it leaves this to HDF5, and
+threads only wait for each other while they are in HDF5.)doc";
+
+static const char *__doc_bbp_sonata_isTracing = R"doc(Whether a trace is being recorded.)doc";
+
+static const char *__doc_bbp_sonata_makeCachingReader =
+R"doc(Create an Hdf5Reader that reads through `cache`.
+
+Each selection is widened to the blocks it touches. The blocks that
+aren't cached are read with one call to `reader`, which is made even if
+all blocks are cached, such that collective readers keep working. If
+several threads need the same block at once, only one of them reads it.
+All readers created from the same `cache`, e.g. those of the
+populations of a circuit, share its blocks.
+
+Blocks are looked up by the file HDF5 has open, i.e. its device and
+inode, and its size and modification time; not by its path. Hence,
+files that are replaced are read again, and the same relative path
+opened from different directories doesn't mix up files. Files that
+aren't opened with HDF5's default POSIX driver only find their blocks
+while they stay open.)doc";
+
+static const char *__doc_bbp_sonata_makeDirectChunkReader =
+R"doc(Create an Hdf5Reader that decompresses chunks on `n_threads` threads.
+
+HDF5 runs its filters, e.g. decompression, on the reading thread, while
+libsonata holds its HDF5 lock. For datasets that are chunked and
+compressed with deflate and/or shuffle, this reader fetches the raw
+chunks with `H5Dread_chunk` instead, and decompresses them and copies
+out the selected elements on a pool of `n_threads` worker threads; `0`
+means one per hardware thread. All other datasets are read like by
+`Hdf5Reader(read_policy)`.)doc";
+
+static const char *__doc_bbp_sonata_makeInstrumentedReader =
+R"doc(Create an Hdf5Reader that counts the reads of `reader` in
+`statistics`.
+
+Every call is counted, with its requested bytes and duration. While
+`reader` reads, the bytes and blocks it reads from the file are
+counted too; by the default reader and those made by `make*Reader`.)doc";
+
+static const char *__doc_bbp_sonata_makeIoUringReader =
+R"doc(Create an Hdf5Reader that reads contiguous datasets with io_uring.
+
+Scattered selections need many small reads, each a synchronous
+`H5Dread` by default. For contiguous datasets, this reader turns the
+ranges of a selection into byte ranges of the file, and submits them as
+one batch to an io_uring, keeping up to `queue_depth` reads in flight.
+Where io_uring isn't available, or if `queue_depth` is `0`, the byte
+ranges are read with `pread`. The file is opened again through the
+descriptor HDF5 has open, and closed once HDF5 has closed it. Datasets
+that are chunked, filtered, or whose elements need converting are read
+like by `Hdf5Reader(read_policy)`.)doc";
+
+static const char *__doc_bbp_sonata_makeMmapReader =
+R"doc(Create an Hdf5Reader that reads contiguous datasets from a memory
+mapping.
+
+The first time a dataset is read, its offset in the file is looked up
+with `H5Dget_offset` and the file is mapped, through the descriptor
+HDF5 has open; hence, it's the same file even if its path was replaced
+since. After that, reading a selection only asks HDF5 for the
+descriptor and the name of the dataset, and then copies each range out
+of the mapping with `memcpy`; any number of threads may copy
+concurrently. The mapping is released once HDF5 has closed the file.
+Datasets that are chunked, filtered, or whose elements need
+converting, and files that aren't opened with HDF5's default POSIX
+driver, are read like by `Hdf5Reader(read_policy)`.)doc";
+
+static const char *__doc_bbp_sonata_makePipelinedReader =
+R"doc(Create an Hdf5Reader that reads blocks ahead on a dedicated I/O
+thread.
+
+Like `Hdf5Reader(read_policy)`, selections are read as merged blocks,
+and the selected elements are copied out of each block. By default, a
+block is only read once the previous one has been copied out. This
+reader keeps up to `prefetch_depth` reads queued on its I/O thread,
+while the calling thread copies out the elements of the blocks already
+read. Hence, reading overlaps with copying; the reads themselves are
+still one after the other, since HDF5 can't be called concurrently. Up
+to `prefetch_depth + 1` blocks are held in memory at once.)doc";
+
 static const char *__doc_bbp_sonata_operator_band = R"doc()doc";
 
 static const char *__doc_bbp_sonata_operator_bor = R"doc()doc";
@@ -1421,6 +1787,23 @@ static const char *__doc_bbp_sonata_operator_eq = R"doc()doc";
 
 static const char *__doc_bbp_sonata_operator_ne = R"doc()doc";
 
+static const char *__doc_bbp_sonata_startTracing =
+R"doc(Start recording the operations of the library, for `stopTracing` to
+write to `path`.
+
+Attribute reads, `_readSelection`, edge index lookups, the rules of
+node sets, the blocks read by reports and waiting for the HDF5 lock are
+recorded as pairs of begin and end events, with the ID of their thread
+and the bytes they read. The file is in the Chrome trace event format,
+and can be opened in Perfetto or `chrome://tracing`. A trace that's
+already being recorded is written first.)doc";
+
+static const char *__doc_bbp_sonata_stopTracing =
+R"doc(Write the events recorded since `startTracing`, and stop recording.
+
+Does nothing if no trace is being recorded. If the process exits while
+recording, the trace is written too.)doc";
+
 static const char *__doc_bbp_sonata_version = R"doc()doc";
 
 #if defined(__GNUG__)
@@ -27,6 +27,20 @@ from libsonata._libsonata import (
     SpikeReader,
     version,
     Hdf5Reader,
+    ReadPolicy,
+    is_hdf5_thread_safe,
+    make_direct_chunk_reader,
+    make_io_uring_reader,
+    make_mmap_reader,
+    make_pipelined_reader,
+    BlockCache,
+    BlockCacheStatistics,
+    make_caching_reader,
+    IoStatistics,
+    make_instrumented_reader,
+    start_tracing,
+    stop_tracing,
+    is_tracing,
 )
 
 
@@ -54,6 +68,20 @@ __all__ = [
     "SpikeReader",
     "version",
     "Hdf5Reader",
+    "ReadPolicy",
+    "is_hdf5_thread_safe",
+    "make_direct_chunk_reader",
+    "make_io_uring_reader",
+    "make_mmap_reader",
+    "make_pipelined_reader",
+    "BlockCache",
+    "BlockCacheStatistics",
+    "make_caching_reader",
+    "IoStatistics",
+    "make_instrumented_reader",
+    "start_tracing",
+    "stop_tracing",
+    "is_tracing",
 ]
 
 def make_collective_reader(comm, collective_metadata, collective_transfer):
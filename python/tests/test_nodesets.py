@@ -135,6 +135,23 @@ class TestNodePopulationNodeSet(unittest.TestCase):
         self.assertEqual(NodeSets(j).materialize("NodeSetCompound4", self.population), expected)
         self.assertEqual(NodeSets(j).materialize("NodeSetCompound5", self.population), expected)
 
+    def test_NodeSetExclude(self):
+        j = json.dumps({
+                "NodeSet0": { "attr-Y": { "$gt": 23 } },
+                "NodeSet1": { "node_id": [0] },
+                "NotNodeSet0": { "$not": "NodeSet0" },
+                "NotNodeSets": { "$not": ["NodeSet0", "NodeSet1"] },
+                "NodeSetCompound0": ["NotNodeSets", "NodeSet1"],
+            })
+        ns = NodeSets(j)
+        self.assertEqual(ns.materialize("NotNodeSet0", self.population), Selection(((0, 3), )))
+        self.assertEqual(ns.materialize("NotNodeSets", self.population), Selection(((1, 3), )))
+        self.assertEqual(ns.materialize("NodeSetCompound0", self.population), Selection(((0, 3), )))
+        self.assertEqual(NodeSets(ns.toJSON()).toJSON(), ns.toJSON())
+
+        self.assertRaises(SonataError, NodeSets, json.dumps({"NotNodeSet0": { "$not": "NodeSet0" }}))
+        self.assertRaises(SonataError, NodeSets, json.dumps({"NotNodeSet0": { "$not": 1 }}))
+
     def test_NodeSet_toJSON(self):
         j = json.dumps(
         {"bio_layer45": {
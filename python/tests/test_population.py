@@ -1,23 +1,40 @@
+import json
 import os
 import pathlib
+import pickle
+import tempfile
 import unittest
 
 import numpy as np
 
 from libsonata import (
+    BlockCache,
     CircuitConfig,
     CompartmentSets,
     EdgePopulation,
     EdgeStorage,
     ElementReportReader,
+    Hdf5Reader,
+    IoStatistics,
     NodePopulation,
     NodeSets,
     NodeStorage,
+    ReadPolicy,
     Selection,
     SimulationConfig,
     SomaReportReader,
     SonataError,
     SpikeReader,
+    is_hdf5_thread_safe,
+    is_tracing,
+    make_caching_reader,
+    make_direct_chunk_reader,
+    make_instrumented_reader,
+    make_io_uring_reader,
+    make_mmap_reader,
+    make_pipelined_reader,
+    start_tracing,
+    stop_tracing,
     )
 
 
@@ -105,6 +122,85 @@ class TestSelection(unittest.TestCase):
         self.assertEqual(Selection(list(range(10))), odd | even)
 
 
+    def test_contains_many(self):
+        selection = Selection(((10, 15), (2, 5)))
+        self.assertEqual(selection.contains_many([0, 2, 4, 5, 10, 14, 15]).tolist(),
+                         [False, True, True, False, True, True, False])
+        self.assertEqual(selection.contains_many(np.array([14, 2, 20], dtype=np.uint64)).tolist(),
+                         [True, True, False])
+        self.assertEqual(selection.contains_many([]).tolist(), [])
+
+    def test_mask(self):
+        mask = np.zeros(100, dtype=bool)
+        mask[[2, 3, 4, 40, 41, 99]] = True
+        selection = Selection.from_mask(mask)
+        self.assertEqual(selection.ranges, [(2, 5), (40, 42), (99, 100)])
+        self.assertEqual(selection, Selection(np.nonzero(mask)[0].astype(np.uint64)))
+        self.assertEqual(selection.to_mask(100).tolist(), mask.tolist())
+        self.assertEqual(selection.to_mask(100).dtype, bool)
+        self.assertEqual(Selection.from_mask([0, 1, 1, 0]).ranges, [(1, 3)])
+        self.assertFalse(Selection.from_mask(np.zeros(0, dtype=bool)))
+
+        self.assertEqual(Selection(((5, 7), (0, 1))).to_mask(8).tolist(),
+                         [True, False, False, False, False, True, True, False])
+        self.assertRaises(SonataError, selection.to_mask, 99)
+
+    def test_select_rank(self):
+        selection = Selection(((10, 15), (0, 3), (20, 22)))
+        for k, node_id in enumerate(selection.flatten()):
+            self.assertEqual(selection.select(k), node_id)
+            self.assertEqual(selection.rank(node_id), k)
+        self.assertRaises(SonataError, selection.select, 10)
+        self.assertRaises(SonataError, selection.rank, 5)
+
+        self.assertEqual(selection.slice(3, 7), Selection(((13, 15), (0, 2))))
+        self.assertEqual(selection.slice(9, 100), Selection(((21, 22), )))
+
+        sample = selection.sample(4, seed=42)
+        self.assertEqual(sample.flat_size, 4)
+        self.assertEqual(sample, selection.sample(4, seed=42))
+        self.assertFalse(sample - selection)
+
+    def test_partition(self):
+        selection = Selection(((10, 15), (0, 3), (20, 22)))
+        parts = selection.partition(3)
+        self.assertEqual([p.ranges for p in parts],
+                         [[(10, 14)], [(14, 15), (0, 2)], [(2, 3), (20, 22)]])
+        self.assertEqual(np.concatenate([p.flatten() for p in parts]).tolist(),
+                         selection.flatten().tolist())
+
+        parts = selection.partition(2, costs=[9, 1, 1, 1, 1, 1, 1, 1, 1, 1])
+        self.assertEqual([p.ranges for p in parts],
+                         [[(10, 11)], [(11, 15), (0, 3), (20, 22)]])
+
+        parts = selection.split(4)
+        self.assertEqual([p.flat_size for p in parts], [4, 4, 2])
+
+        self.assertRaises(SonataError, selection.partition, 0)
+        self.assertRaises(SonataError, selection.partition, 2, [1, 2])
+        self.assertRaises(SonataError, selection.split, 0)
+
+    def test_serialize(self):
+        for selection in (Selection([]),
+                          Selection(((0, 2), (5, 10))),
+                          Selection(((10, 15), (2, 5), (3, 4)))):
+            data = selection.serialize()
+            self.assertIsInstance(data, bytes)
+            self.assertEqual(Selection.deserialize(data).ranges, selection.ranges)
+            self.assertEqual(pickle.loads(pickle.dumps(selection)).ranges, selection.ranges)
+
+        self.assertRaises(SonataError, Selection.deserialize, b'not a selection')
+
+    def test_difference(self):
+        a = Selection(((0, 2), (5, 10), (13, 23)))
+        b = Selection(((1, 6), (8, 13), (15, 23)))
+        self.assertEqual(a - b, Selection(((0, 1), (6, 8), (13, 15))))
+        self.assertEqual(b - a, Selection(((2, 5), (10, 13))))
+        self.assertEqual(a ^ b, Selection(((0, 1), (2, 5), (6, 8), (10, 15))))
+        self.assertEqual(a - a, Selection([]))
+        self.assertEqual(a.complement(25), Selection(((2, 5), (10, 13), (23, 25))))
+        self.assertEqual(a.complement(universe_size=4), Selection(((2, 4), )))
+
 class TestNodePopulation(unittest.TestCase):
     def setUp(self):
         path = os.path.join(PATH, 'nodes1.h5')
@@ -145,6 +241,104 @@ class TestNodePopulation(unittest.TestCase):
 
         self.assertRaises(SonataError, self.test_obj.get_attribute, 'no-such-attribute', 0)
 
+    def test_read_policy(self):
+        path = os.path.join(PATH, 'nodes1.h5')
+
+        read_policy = ReadPolicy()
+        self.assertEqual(read_policy.max_block_bytes_2d, 128 * read_policy.min_gap_bytes)
+        read_policy.min_gap_bytes = 8
+        read_policy.max_over_read_ratio = 1.5
+        population = NodeStorage(path, hdf5_reader=Hdf5Reader(read_policy)).open_population('nodes-A')
+        self.assertEqual(population.get_attribute('attr-X', Selection([0, 2, 5])).tolist(),
+                         [11., 13., 16.])
+
+        calibrated = ReadPolicy.calibrate(path)
+        self.assertGreater(calibrated.min_gap_bytes, 0)
+        self.assertGreaterEqual(calibrated.max_block_bytes, calibrated.min_gap_bytes)
+        self.assertRaises(SonataError, ReadPolicy.calibrate, 'no-such-file.h5')
+
+    def test_plugin_readers(self):
+        path = os.path.join(PATH, 'nodes1.h5')
+        for hdf5_reader in [make_direct_chunk_reader(),
+                            make_direct_chunk_reader(n_threads=2),
+                            make_mmap_reader(),
+                            make_io_uring_reader(),
+                            make_io_uring_reader(queue_depth=0),
+                            make_pipelined_reader(),
+                            make_pipelined_reader(prefetch_depth=1)]:
+            population = NodeStorage(path, hdf5_reader=hdf5_reader).open_population('nodes-A')
+            self.assertEqual(population.get_attribute('attr-X', Selection([0, 2, 5])).tolist(),
+                             [11., 13., 16.])
+            self.assertEqual(population.get_attribute('attr-Z', Selection([0, 1])).tolist(),
+                             ['aa', 'bb'])
+
+    def test_file_handle_per_thread(self):
+        path = os.path.join(PATH, 'nodes1.h5')
+        population = NodeStorage(path).open_population('nodes-A')
+        self.assertFalse(population.file_handle_per_thread)
+        population.file_handle_per_thread = True
+        self.assertTrue(population.file_handle_per_thread)
+        self.assertEqual(population.get_attribute('attr-X', Selection([0, 2, 5])).tolist(),
+                         [11., 13., 16.])
+        self.assertIsInstance(is_hdf5_thread_safe(), bool)
+
+    def test_caching_reader(self):
+        path = os.path.join(PATH, 'nodes1.h5')
+        cache = BlockCache(max_bytes=1 << 20)
+        hdf5_reader = make_caching_reader(cache, hdf5_reader=make_mmap_reader())
+        for _ in range(2):
+            population = NodeStorage(path, hdf5_reader=hdf5_reader).open_population('nodes-A')
+            self.assertEqual(population.get_attribute('attr-X', Selection([0, 2, 5])).tolist(),
+                             [11., 13., 16.])
+
+        self.assertEqual(cache.statistics.misses, 1)
+        self.assertEqual(cache.statistics.hits, 1)
+        self.assertGreater(cache.statistics.size_bytes, 0)
+
+        cache.clear()
+        self.assertEqual(cache.statistics.size_bytes, 0)
+
+    def test_io_statistics(self):
+        path = os.path.join(PATH, 'nodes1.h5')
+        statistics = IoStatistics()
+        hdf5_reader = make_instrumented_reader(statistics)
+        population = NodeStorage(path, hdf5_reader=hdf5_reader).open_population('nodes-A')
+        population.set_io_statistics(statistics)
+        self.assertEqual(population.get_attribute('attr-X', Selection([0, 2, 5])).tolist(),
+                         [11., 13., 16.])
+
+        counters = statistics.as_dict()
+        self.assertGreaterEqual(counters['reads'], 1)
+        self.assertGreaterEqual(counters['bytes_read'], 3 * 8)
+        self.assertGreaterEqual(counters['blocks'], 1)
+        self.assertEqual(counters['latencies']['getAttribute']['count'], 1)
+        self.assertEqual(sum(counters['latencies']['readSelection']['buckets']),
+                         counters['latencies']['readSelection']['count'])
+
+        statistics.reset()
+        population.clear_io_statistics()
+        population.get_attribute('attr-X', Selection([0]))
+        self.assertNotIn('getAttribute', statistics.as_dict()['latencies'])
+
+    def test_tracing(self):
+        path = os.path.join(PATH, 'nodes1.h5')
+        population = NodeStorage(path).open_population('nodes-A')
+        with tempfile.TemporaryDirectory() as tmpdir:
+            trace_path = os.path.join(tmpdir, 'trace.json')
+            start_tracing(trace_path)
+            self.assertTrue(is_tracing())
+            population.get_attribute('attr-X', Selection([0, 2, 5]))
+            stop_tracing()
+            self.assertFalse(is_tracing())
+
+            with open(trace_path) as fd:
+                events = json.load(fd)['traceEvents']
+
+        names = {event['name'] for event in events}
+        self.assertIn('Population::getAttribute', names)
+        self.assertIn('_readSelection', names)
+        self.assertTrue(all(event['ph'] in ('B', 'E') for event in events))
+
     def test_get_dynamics_attribute(self):
         self.assertEqual(self.test_obj.get_dynamics_attribute('dparam-X', 0), 1011.)
         self.assertEqual(self.test_obj.get_dynamics_attribute('dparam-X', Selection([0, 5])).tolist(), [1011., 1016.])
@@ -0,0 +1,100 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "block_cache.hpp"
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+BlockCacheImpl::BlockCacheImpl(size_t max_bytes, size_t block_bytes)
+    : max_bytes_(max_bytes)
+    , block_bytes_(block_bytes) {
+    if (block_bytes == 0) {
+        throw SonataError("Blocks of a BlockCache must not be empty");
+    }
+}
+
+BlockCacheImpl::Lookup BlockCacheImpl::lookup(const std::vector<Key>& keys) {
+    Lookup lookup;
+    lookup.values.resize(keys.size());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const auto entry = entries_.find(keys[i]);
+        if (entry != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, entry->second.position);
+            lookup.values[i] = entry->second.value;
+            ++statistics_.hits;
+            continue;
+        }
+
+        const auto in_flight = in_flight_.find(keys[i]);
+        if (in_flight != in_flight_.end()) {
+            lookup.pending.emplace_back(i, in_flight->second.future);
+            ++statistics_.hits;
+            continue;
+        }
+
+        auto& claimed = in_flight_[keys[i]];
+        claimed.future = claimed.promise.get_future().share();
+        lookup.claimed.push_back(i);
+        ++statistics_.misses;
+    }
+
+    return lookup;
+}
+
+void BlockCacheImpl::publish(const Key& key, Value value, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto in_flight = in_flight_.find(key);
+    in_flight->second.promise.set_value(value);
+    in_flight_.erase(in_flight);
+
+    // Blocks larger than the whole budget aren't kept.
+    if (size <= max_bytes_) {
+        lru_.push_front(key);
+        entries_[key] = Entry{std::move(value), size, lru_.begin()};
+        statistics_.size_bytes += size;
+        _evict();
+    }
+}
+
+void BlockCacheImpl::abandon(const Key& key, std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto in_flight = in_flight_.find(key);
+    in_flight->second.promise.set_exception(std::move(error));
+    in_flight_.erase(in_flight);
+}
+
+BlockCacheStatistics BlockCacheImpl::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+}
+
+void BlockCacheImpl::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    entries_.clear();
+    statistics_.size_bytes = 0;
+}
+
+void BlockCacheImpl::_evict() {
+    while (statistics_.size_bytes > max_bytes_) {
+        const auto entry = entries_.find(lru_.back());
+        statistics_.size_bytes -= entry->second.size;
+        entries_.erase(entry);
+        lru_.pop_back();
+        ++statistics_.evictions;
+    }
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
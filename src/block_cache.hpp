@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include <bbp/sonata/hdf5_reader.h>
+#include <highfive/H5File.hpp>
+
+#include "io_statistics.hpp"    // _byteSize
+#include "read_contiguous.hpp"  // _datasetName, _fileVersion
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/** The shared state of a `BlockCache`.
+ *
+ * Blocks are type-erased vectors of elements, keyed by the version of the file
+ * HDF5 has open, see `_fileVersion`, dataset, element type, selected columns and
+ * block index. Hence, paths don't matter: blocks of files that were replaced
+ * are never found again, and age out. All methods are thread-safe.
+ */
+class BlockCacheImpl
+{
+  public:
+    using Value = std::shared_ptr<const void>;
+
+    struct Key {
+        FileVersion file;
+        std::string dataset;
+        std::type_index type;
+        Selection::Ranges columns;
+        uint64_t block;
+
+        bool operator<(const Key& other) const {
+            return std::tie(file, dataset, type, columns, block) <
+                   std::tie(other.file,
+                            other.dataset,
+                            other.type,
+                            other.columns,
+                            other.block);
+        }
+    };
+
+    /// The state of the blocks of one read, in the order of the keys.
+    struct Lookup {
+        /// The blocks that are cached; null for the others.
+        std::vector<Value> values;
+        /// Blocks that must be read, and then passed to `publish` or `abandon`.
+        std::vector<size_t> claimed;
+        /// Blocks that are being read by another thread.
+        std::vector<std::pair<size_t, std::shared_future<Value>>> pending;
+    };
+
+    BlockCacheImpl(size_t max_bytes, size_t block_bytes);
+
+    size_t blockBytes() const noexcept {
+        return block_bytes_;
+    }
+
+    /// Look up `keys`, and claim the ones that nobody is reading yet.
+    Lookup lookup(const std::vector<Key>& keys);
+
+    /// Cache a block of `size` bytes that was claimed, and pass it to those waiting for it.
+    void publish(const Key& key, Value value, size_t size);
+
+    /// Give up on a block that was claimed, and pass `error` to those waiting for it.
+    void abandon(const Key& key, std::exception_ptr error);
+
+    BlockCacheStatistics statistics() const;
+
+    void clear();
+
+  private:
+    struct Entry {
+        Value value;
+        size_t size;
+        std::list<Key>::iterator position;
+    };
+
+    struct InFlight {
+        std::promise<Value> promise;
+        std::shared_future<Value> future;
+    };
+
+    /// Drop the least recently used blocks until the cache is within budget.
+    void _evict();
+
+    const size_t max_bytes_;
+    const size_t block_bytes_;
+
+    mutable std::mutex mutex_;
+    /// Most recently used first.
+    std::list<Key> lru_;
+    std::map<Key, Entry> entries_;
+    std::map<Key, InFlight> in_flight_;
+    BlockCacheStatistics statistics_;
+};
+
+/** Read a canonical selection of rows through the block cache.
+ *
+ * The dataset is split into blocks of rows. The blocks of `xsel` that aren't
+ * cached are read with exactly one call of
+ *
+ *     read(selection)  // -> std::vector<T>, `row_width` elements per row
+ *
+ * even if all blocks are cached; plugins may need to be called collectively.
+ * The selected rows are then copied out of the blocks.
+ */
+template <class T, class Read>
+std::vector<T> readCachedSelection(BlockCacheImpl& cache,
+                                   const HighFive::DataSet& dset,
+                                   const Selection& xsel,
+                                   const Selection::Ranges& columns,
+                                   Read read,
+                                   size_t row_width = 1) {
+    const auto& ranges = xsel.ranges();
+    const size_t n_rows = dset.getSpace().getDimensions()[0];
+    if (ranges.empty() || row_width == 0 || std::get<1>(ranges.back()) > n_rows) {
+        // Nothing to cache, or the plugin reports the error.
+        return read(xsel);
+    }
+
+    // The blocks that `xsel` touches, in order.
+    const size_t block_rows = std::max<size_t>(1, cache.blockBytes() / (sizeof(T) * row_width));
+    std::vector<uint64_t> blocks;
+    for (const auto& range : ranges) {
+        for (uint64_t block = range[0] / block_rows; block * block_rows < range[1]; ++block) {
+            if (blocks.empty() || blocks.back() != block) {
+                blocks.push_back(block);
+            }
+        }
+    }
+
+    const auto file = _fileVersion(dset);
+    const auto dataset = _datasetName(dset);
+    std::vector<BlockCacheImpl::Key> keys;
+    keys.reserve(blocks.size());
+    for (const auto block : blocks) {
+        keys.push_back({file, dataset, std::type_index(typeid(T)), columns, block});
+    }
+
+    auto lookup = cache.lookup(keys);
+    const auto blockRange = [&](size_t i) -> Selection::Range {
+        return {blocks[i] * block_rows, std::min<uint64_t>((blocks[i] + 1) * block_rows, n_rows)};
+    };
+
+    Selection::Ranges missing;
+    missing.reserve(lookup.claimed.size());
+    for (const auto i : lookup.claimed) {
+        missing.push_back(blockRange(i));
+    }
+
+    size_t n_published = 0;
+    try {
+        const auto values = read(Selection(std::move(missing)));
+
+        size_t offset = 0;
+        for (const auto i : lookup.claimed) {
+            const auto range = blockRange(i);
+            const auto begin = values.begin() + static_cast<std::ptrdiff_t>(offset);
+            const auto end = begin + static_cast<std::ptrdiff_t>((range[1] - range[0]) * row_width);
+            const auto block = std::make_shared<const std::vector<T>>(begin, end);
+
+            cache.publish(keys[i], block, _byteSize(*block));
+            lookup.values[i] = block;
+            offset += (range[1] - range[0]) * row_width;
+            ++n_published;
+        }
+    } catch (...) {
+        for (size_t k = n_published; k < lookup.claimed.size(); ++k) {
+            cache.abandon(keys[lookup.claimed[k]], std::current_exception());
+        }
+        throw;
+    }
+
+    for (auto& pending : lookup.pending) {
+        lookup.values[pending.first] = pending.second.get();
+    }
+
+    // Copy the selected rows out of the blocks.
+    std::vector<T> result;
+    result.reserve(xsel.flatSize() * row_width);
+    size_t i = 0;
+    for (const auto& range : ranges) {
+        for (uint64_t row = range[0]; row < range[1];) {
+            while (blockRange(i)[1] <= row) {
+                ++i;
+            }
+            const auto& block = *std::static_pointer_cast<const std::vector<T>>(lookup.values[i]);
+            const uint64_t end = std::min<uint64_t>(range[1], blockRange(i)[1]);
+            const auto begin = block.begin() +
+                               static_cast<std::ptrdiff_t>((row - blockRange(i)[0]) * row_width);
+            result.insert(result.end(),
+                          begin,
+                          begin + static_cast<std::ptrdiff_t>((end - row) * row_width));
+            row = end;
+        }
+    }
+
+    return result;
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
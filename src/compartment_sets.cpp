@@ -219,7 +219,7 @@ class CompartmentSet
             }
         }
         sort(result.begin(), result.end());
-        return Selection::fromValues(result.begin(), result.end());
+        return Selection::fromValues(result);
     }
 
     const std::string& population() const {
@@ -0,0 +1,544 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "compressed_selection.h"
+
+#include <algorithm>  // std::lower_bound, std::merge, std::min, std::max
+#include <iterator>   // std::back_inserter
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+namespace {
+
+// Below this many ranges, the ranges are small enough as they are.
+constexpr size_t MIN_COMPRESSED_RANGES = 1024;
+
+// Bounds the number of blocks `fromRanges` can touch to about twice the
+// number of ranges.
+constexpr size_t MAX_COMPRESSED_MEAN_RANGE_SIZE = 64;
+
+// Beyond this many ids an array container is larger than a bitmap.
+constexpr uint32_t MAX_ARRAY_CARDINALITY = 4096;
+
+void _setBits(std::vector<uint64_t>& words, uint32_t begin, uint32_t end) {
+    if (begin >= end) {
+        return;
+    }
+
+    const uint32_t w_begin = begin / 64;
+    const uint32_t w_last = (end - 1) / 64;
+    const uint64_t first_mask = ~uint64_t(0) << (begin % 64);
+    const uint64_t last_mask = ~uint64_t(0) >> (63 - (end - 1) % 64);
+
+    if (w_begin == w_last) {
+        words[w_begin] |= first_mask & last_mask;
+        return;
+    }
+
+    words[w_begin] |= first_mask;
+    for (uint32_t w = w_begin + 1; w < w_last; ++w) {
+        words[w] = ~uint64_t(0);
+    }
+    words[w_last] |= last_mask;
+}
+
+}  // unnamed namespace
+
+
+CompressedSelection::Container CompressedSelection::makeContainer(uint64_t key,
+                                                                  const LocalRuns& runs) {
+    Container container;
+    container.key = key;
+    for (const auto& run : runs) {
+        container.cardinality += std::get<1>(run) - std::get<0>(run);
+    }
+
+    // Pick the smallest container; bitmaps have a fixed size.
+    const size_t runs_bytes = 2 * sizeof(uint16_t) * runs.size();
+    const size_t array_bytes = sizeof(uint16_t) * container.cardinality;
+    const size_t bitmap_bytes = sizeof(uint64_t) * bitmap_words;
+
+    if (runs_bytes <= std::min(array_bytes, bitmap_bytes)) {
+        container.kind = Kind::runs;
+        container.values.reserve(2 * runs.size());
+        for (const auto& run : runs) {
+            container.values.push_back(static_cast<uint16_t>(std::get<0>(run)));
+            container.values.push_back(static_cast<uint16_t>(std::get<1>(run) - 1));
+        }
+    } else if (container.cardinality <= MAX_ARRAY_CARDINALITY) {
+        container.kind = Kind::array;
+        container.values.reserve(container.cardinality);
+        for (const auto& run : runs) {
+            for (uint32_t i = std::get<0>(run); i < std::get<1>(run); ++i) {
+                container.values.push_back(static_cast<uint16_t>(i));
+            }
+        }
+    } else {
+        container.kind = Kind::bitmap;
+        container.words.assign(bitmap_words, 0);
+        for (const auto& run : runs) {
+            _setBits(container.words, std::get<0>(run), std::get<1>(run));
+        }
+    }
+
+    return container;
+}
+
+
+CompressedSelection::Container CompressedSelection::makeContainer(
+    uint64_t key, const std::vector<uint64_t>& words) {
+    Container bitmap;
+    bitmap.kind = Kind::bitmap;
+    bitmap.words = words;
+    return makeContainer(key, localRuns(bitmap));
+}
+
+
+CompressedSelection::LocalRuns CompressedSelection::localRuns(const Container& container) {
+    LocalRuns runs;
+    forEachLocalRun(container, [&runs](const LocalRun& run) { runs.push_back(run); });
+    return runs;
+}
+
+
+std::vector<uint64_t> CompressedSelection::toBitmap(const Container& container) {
+    if (container.kind == Kind::bitmap) {
+        return container.words;
+    }
+
+    std::vector<uint64_t> words(bitmap_words, 0);
+    forEachLocalRun(container, [&words](const LocalRun& run) {
+        _setBits(words, std::get<0>(run), std::get<1>(run));
+    });
+    return words;
+}
+
+
+bool CompressedSelection::contains(const Container& container, uint32_t offset) {
+    const auto& values = container.values;
+    switch (container.kind) {
+    case Kind::runs: {
+        // Find the first run whose `last` is not smaller than `offset`.
+        size_t lo = 0;
+        size_t hi = values.size() / 2;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (values[2 * mid + 1] < offset) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo < values.size() / 2 && values[2 * lo] <= offset;
+    }
+    case Kind::array:
+        return std::binary_search(values.begin(), values.end(), static_cast<uint16_t>(offset));
+    case Kind::bitmap:
+        return ((container.words[offset / 64] >> (offset % 64)) & 1) != 0;
+    }
+
+    LIBSONATA_THROW_IF_REACHED  // LCOV_EXCL_LINE
+}
+
+
+CompressedSelection::Container CompressedSelection::intersection(const Container& lhs,
+                                                                 const Container& rhs) {
+    if (lhs.kind == Kind::array || rhs.kind == Kind::array) {
+        const auto& array = lhs.kind == Kind::array ? lhs : rhs;
+        const auto& other = lhs.kind == Kind::array ? rhs : lhs;
+
+        LocalRuns runs;
+        for (const auto v : array.values) {
+            if (!contains(other, v)) {
+                continue;
+            }
+            if (!runs.empty() && std::get<1>(runs.back()) == v) {
+                ++std::get<1>(runs.back());
+            } else {
+                runs.push_back({v, uint32_t(v) + 1});
+            }
+        }
+        return makeContainer(lhs.key, runs);
+    }
+
+    if (lhs.kind == Kind::runs && rhs.kind == Kind::runs) {
+        const auto r0 = localRuns(lhs);
+        const auto r1 = localRuns(rhs);
+
+        LocalRuns runs;
+        auto it0 = r0.cbegin();
+        auto it1 = r1.cbegin();
+        while (it0 != r0.cend() && it1 != r1.cend()) {
+            const auto begin = std::max(std::get<0>(*it0), std::get<0>(*it1));
+            const auto end = std::min(std::get<1>(*it0), std::get<1>(*it1));
+            if (begin < end) {
+                runs.push_back({begin, end});
+            }
+
+            if (std::get<1>(*it0) < std::get<1>(*it1)) {
+                ++it0;
+            } else {
+                ++it1;
+            }
+        }
+        return makeContainer(lhs.key, runs);
+    }
+
+    auto words = toBitmap(lhs);
+    const auto other = toBitmap(rhs);
+    for (size_t i = 0; i < bitmap_words; ++i) {
+        words[i] &= other[i];
+    }
+    return makeContainer(lhs.key, words);
+}
+
+
+CompressedSelection::Container CompressedSelection::union_(const Container& lhs,
+                                                           const Container& rhs) {
+    if (lhs.kind == Kind::bitmap || rhs.kind == Kind::bitmap) {
+        auto words = toBitmap(lhs);
+        const auto other = toBitmap(rhs);
+        for (size_t i = 0; i < bitmap_words; ++i) {
+            words[i] |= other[i];
+        }
+        return makeContainer(lhs.key, words);
+    }
+
+    const auto r0 = localRuns(lhs);
+    const auto r1 = localRuns(rhs);
+
+    LocalRuns merged;
+    merged.reserve(r0.size() + r1.size());
+    std::merge(r0.begin(), r0.end(), r1.begin(), r1.end(), std::back_inserter(merged));
+
+    LocalRuns runs;
+    for (const auto& run : merged) {
+        if (!runs.empty() && std::get<0>(run) <= std::get<1>(runs.back())) {
+            std::get<1>(runs.back()) = std::max(std::get<1>(runs.back()), std::get<1>(run));
+        } else {
+            runs.push_back(run);
+        }
+    }
+    return makeContainer(lhs.key, runs);
+}
+
+
+CompressedSelection::Container CompressedSelection::difference(const Container& lhs,
+                                                               const Container& rhs) {
+    if (lhs.kind == Kind::array) {
+        LocalRuns runs;
+        for (const auto v : lhs.values) {
+            if (contains(rhs, v)) {
+                continue;
+            }
+            if (!runs.empty() && std::get<1>(runs.back()) == v) {
+                ++std::get<1>(runs.back());
+            } else {
+                runs.push_back({v, uint32_t(v) + 1});
+            }
+        }
+        return makeContainer(lhs.key, runs);
+    }
+
+    if (lhs.kind == Kind::runs && rhs.kind != Kind::bitmap) {
+        const auto runs = _combineRanges(localRuns(lhs), localRuns(rhs), [](bool a, bool b) {
+            return a && !b;
+        });
+        return makeContainer(lhs.key, runs);
+    }
+
+    auto words = toBitmap(lhs);
+    const auto other = toBitmap(rhs);
+    for (size_t i = 0; i < bitmap_words; ++i) {
+        words[i] &= ~other[i];
+    }
+    return makeContainer(lhs.key, words);
+}
+
+
+CompressedSelection::Container CompressedSelection::symmetricDifference(const Container& lhs,
+                                                                        const Container& rhs) {
+    if (lhs.kind == Kind::bitmap || rhs.kind == Kind::bitmap) {
+        auto words = toBitmap(lhs);
+        const auto other = toBitmap(rhs);
+        for (size_t i = 0; i < bitmap_words; ++i) {
+            words[i] ^= other[i];
+        }
+        return makeContainer(lhs.key, words);
+    }
+
+    const auto runs = _combineRanges(localRuns(lhs), localRuns(rhs), [](bool a, bool b) {
+        return a != b;
+    });
+    return makeContainer(lhs.key, runs);
+}
+
+
+CompressedSelection CompressedSelection::fromRanges(const Ranges& canonical) {
+    CompressedSelection ret;
+
+    LocalRuns runs;
+    uint64_t key = 0;
+    auto flush = [&ret, &runs, &key]() {
+        if (!runs.empty()) {
+            ret.blocks_.push_back(makeContainer(key, runs));
+            runs.clear();
+        }
+    };
+
+    for (const auto& range : canonical) {
+        Value begin = std::get<0>(range);
+        const Value end = std::get<1>(range);
+        while (begin < end) {
+            const uint64_t k = begin >> block_bits;
+            const Value offset = k << block_bits;
+            const Value block_end = std::min<Value>(end, offset + block_size);
+
+            if (k != key) {
+                flush();
+                key = k;
+            }
+            runs.push_back({uint32_t(begin - offset), uint32_t(block_end - offset)});
+            begin = block_end;
+        }
+    }
+    flush();
+
+    return ret;
+}
+
+
+bool CompressedSelection::isWorthCompressing(const Ranges& canonical) {
+    if (canonical.size() < MIN_COMPRESSED_RANGES) {
+        return false;
+    }
+
+    size_t flat_size = 0;
+    for (const auto& range : canonical) {
+        flat_size += std::get<1>(range) - std::get<0>(range);
+    }
+    return flat_size <= MAX_COMPRESSED_MEAN_RANGE_SIZE * canonical.size();
+}
+
+
+CompressedSelection::Ranges CompressedSelection::toRanges() const {
+    Ranges ranges;
+    ranges.reserve(rangeCount());
+    forEachRange([&ranges](const Range& range) { ranges.push_back(range); });
+    return ranges;
+}
+
+
+bool CompressedSelection::nextLocalRun(const Container& container,
+                                       uint32_t& position,
+                                       LocalRun& run) {
+    switch (container.kind) {
+    case Kind::runs:
+        if (position >= container.values.size()) {
+            return false;
+        }
+        run = LocalRun{container.values[position], uint32_t(container.values[position + 1]) + 1};
+        position += 2;
+        return true;
+    case Kind::array: {
+        const auto& values = container.values;
+        if (position >= values.size()) {
+            return false;
+        }
+        uint32_t end = uint32_t(values[position]) + 1;
+        run[0] = values[position];
+        for (++position; position < values.size() && values[position] == end; ++position) {
+            ++end;
+        }
+        run[1] = end;
+        return true;
+    }
+    case Kind::bitmap: {
+        // The first bit at or after `pos` which is `set`, or `block_size`.
+        const auto find = [&container](uint32_t pos, bool set) {
+            while (pos < block_size) {
+                const uint64_t word = set ? container.words[pos / 64] : ~container.words[pos / 64];
+                const uint64_t rest = word >> (pos % 64);
+                if (rest != 0) {
+                    return pos + static_cast<uint32_t>(_countTrailingZeros(rest));
+                }
+                pos = (pos / 64 + 1) * 64;
+            }
+            return block_size;
+        };
+        const uint32_t begin = find(position, true);
+        if (begin == block_size) {
+            position = block_size;
+            return false;
+        }
+        position = find(begin, false);
+        run = LocalRun{begin, position};
+        return true;
+    }
+    }
+    return false;  // LCOV_EXCL_LINE
+}
+
+
+bool CompressedSelection::nextRange(size_t& block, uint32_t& position, Range& range) const {
+    for (; block < blocks_.size(); ++block, position = 0) {
+        LocalRun run;
+        if (nextLocalRun(blocks_[block], position, run)) {
+            const Value offset = blocks_[block].key << block_bits;
+            range = Range{offset + std::get<0>(run), offset + std::get<1>(run)};
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool CompressedSelection::contains(Value id) const {
+    const uint64_t key = id >> block_bits;
+    const auto it = std::lower_bound(blocks_.begin(),
+                                     blocks_.end(),
+                                     key,
+                                     [](const Container& c, uint64_t k) { return c.key < k; });
+    if (it == blocks_.end() || it->key != key) {
+        return false;
+    }
+    return contains(*it, static_cast<uint32_t>(id - (key << block_bits)));
+}
+
+
+bool CompressedSelection::empty() const {
+    return blocks_.empty();
+}
+
+
+size_t CompressedSelection::flatSize() const {
+    size_t size = 0;
+    for (const auto& container : blocks_) {
+        size += container.cardinality;
+    }
+    return size;
+}
+
+
+size_t CompressedSelection::rangeCount() const {
+    size_t count = 0;
+    forEachRange([&count](const Range&) { ++count; });
+    return count;
+}
+
+
+size_t CompressedSelection::sizeInBytes() const {
+    size_t size = sizeof(*this) + blocks_.capacity() * sizeof(Container);
+    for (const auto& container : blocks_) {
+        size += container.values.capacity() * sizeof(uint16_t);
+        size += container.words.capacity() * sizeof(uint64_t);
+    }
+    return size;
+}
+
+
+CompressedSelection operator&(const CompressedSelection& lhs, const CompressedSelection& rhs) {
+    CompressedSelection ret;
+
+    auto it0 = lhs.blocks_.cbegin();
+    auto it1 = rhs.blocks_.cbegin();
+    while (it0 != lhs.blocks_.cend() && it1 != rhs.blocks_.cend()) {
+        if (it0->key < it1->key) {
+            ++it0;
+        } else if (it1->key < it0->key) {
+            ++it1;
+        } else {
+            auto container = CompressedSelection::intersection(*it0, *it1);
+            if (container.cardinality > 0) {
+                ret.blocks_.push_back(std::move(container));
+            }
+            ++it0;
+            ++it1;
+        }
+    }
+
+    return ret;
+}
+
+
+CompressedSelection operator|(const CompressedSelection& lhs, const CompressedSelection& rhs) {
+    CompressedSelection ret;
+    ret.blocks_.reserve(std::max(lhs.blocks_.size(), rhs.blocks_.size()));
+
+    auto it0 = lhs.blocks_.cbegin();
+    auto it1 = rhs.blocks_.cbegin();
+    while (it0 != lhs.blocks_.cend() || it1 != rhs.blocks_.cend()) {
+        if (it1 == rhs.blocks_.cend() || (it0 != lhs.blocks_.cend() && it0->key < it1->key)) {
+            ret.blocks_.push_back(*(it0++));
+        } else if (it0 == lhs.blocks_.cend() || it1->key < it0->key) {
+            ret.blocks_.push_back(*(it1++));
+        } else {
+            ret.blocks_.push_back(CompressedSelection::union_(*it0, *it1));
+            ++it0;
+            ++it1;
+        }
+    }
+
+    return ret;
+}
+
+
+CompressedSelection operator-(const CompressedSelection& lhs, const CompressedSelection& rhs) {
+    CompressedSelection ret;
+    ret.blocks_.reserve(lhs.blocks_.size());
+
+    auto it1 = rhs.blocks_.cbegin();
+    for (const auto& container : lhs.blocks_) {
+        while (it1 != rhs.blocks_.cend() && it1->key < container.key) {
+            ++it1;
+        }
+        if (it1 == rhs.blocks_.cend() || container.key < it1->key) {
+            ret.blocks_.push_back(container);
+            continue;
+        }
+
+        auto diff = CompressedSelection::difference(container, *it1);
+        if (diff.cardinality > 0) {
+            ret.blocks_.push_back(std::move(diff));
+        }
+    }
+
+    return ret;
+}
+
+
+CompressedSelection operator^(const CompressedSelection& lhs, const CompressedSelection& rhs) {
+    CompressedSelection ret;
+    ret.blocks_.reserve(std::max(lhs.blocks_.size(), rhs.blocks_.size()));
+
+    auto it0 = lhs.blocks_.cbegin();
+    auto it1 = rhs.blocks_.cbegin();
+    while (it0 != lhs.blocks_.cend() || it1 != rhs.blocks_.cend()) {
+        if (it1 == rhs.blocks_.cend() || (it0 != lhs.blocks_.cend() && it0->key < it1->key)) {
+            ret.blocks_.push_back(*(it0++));
+        } else if (it0 == lhs.blocks_.cend() || it1->key < it0->key) {
+            ret.blocks_.push_back(*(it1++));
+        } else {
+            auto container = CompressedSelection::symmetricDifference(*it0, *it1);
+            if (container.cardinality > 0) {
+                ret.blocks_.push_back(std::move(container));
+            }
+            ++it0;
+            ++it1;
+        }
+    }
+
+    return ret;
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,270 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#pragma once
+
+#include <bbp/sonata/selection.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/** Roaring-style representation of a canonical selection.
+ *
+ * The id space is split into blocks of `block_size` ids. Every non-empty
+ * block is stored in whichever of the following containers is smallest for
+ * its content:
+ *
+ *   - runs:   `[first, last]` pairs of offsets into the block; dense areas,
+ *   - array:  sorted offsets into the block; sparse blocks,
+ *   - bitmap: one bit per id of the block; everything else.
+ *
+ * For selections with many short ranges, e.g. the result of filtering an
+ * attribute, this needs far less memory than one `Selection::Range` per
+ * range, and intersection and union become word-wise operations on the
+ * bitmaps.
+ */
+class CompressedSelection
+{
+  public:
+    using Value = Selection::Value;
+    using Range = Selection::Range;
+    using Ranges = Selection::Ranges;
+
+    static constexpr size_t block_bits = 16;
+    static constexpr uint32_t block_size = uint32_t(1) << block_bits;
+    static constexpr size_t bitmap_words = block_size / 64;
+
+    /// `canonical` must be sorted and non-overlapping.
+    static CompressedSelection fromRanges(const Ranges& canonical);
+
+    /** Should `canonical` be stored as a `CompressedSelection`?
+     *
+     * This is a cheap heuristic: it checks that there are many ranges and
+     * that they are short on average. The latter bounds the number of blocks
+     * touched, hence the cost of `fromRanges`.
+     */
+    static bool isWorthCompressing(const Ranges& canonical);
+
+    /// The canonical ranges, i.e. sorted, non-overlapping and non-adjacent.
+    Ranges toRanges() const;
+
+    /// Call `f(range)` for every canonical range, in order.
+    template <class F>
+    void forEachRange(F f) const;
+
+    /** The range at the cursor `(block, position)`, and advance the cursor.
+     *
+     * Starting from `(0, 0)`, this visits the same ids as `forEachRange`,
+     * except that ranges are cut at block boundaries. Returns `false` once
+     * there are no ranges left. Doesn't allocate.
+     */
+    bool nextRange(size_t& block, uint32_t& position, Range& range) const;
+
+    bool contains(Value id) const;
+    bool empty() const;
+    size_t flatSize() const;
+
+    /// Number of canonical ranges, i.e. `toRanges().size()`.
+    size_t rangeCount() const;
+
+    /// Approximate number of bytes used.
+    size_t sizeInBytes() const;
+
+    friend CompressedSelection operator&(const CompressedSelection& lhs,
+                                         const CompressedSelection& rhs);
+    friend CompressedSelection operator|(const CompressedSelection& lhs,
+                                         const CompressedSelection& rhs);
+    friend CompressedSelection operator-(const CompressedSelection& lhs,
+                                         const CompressedSelection& rhs);
+    friend CompressedSelection operator^(const CompressedSelection& lhs,
+                                         const CompressedSelection& rhs);
+
+  private:
+    enum class Kind : uint8_t { runs, array, bitmap };
+
+    struct Container {
+        uint64_t key = 0;  // the block contains the ids `[key << block_bits, (key + 1) << block_bits)`
+        Kind kind = Kind::runs;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> values;  // runs: `first, last` pairs; array: offsets.
+        std::vector<uint64_t> words;   // bitmap
+    };
+
+    // A range `[begin, end)` of offsets into a block; `end` can be `block_size`.
+    using LocalRun = std::array<uint32_t, 2>;
+    using LocalRuns = std::vector<LocalRun>;
+
+    static Container makeContainer(uint64_t key, const LocalRuns& runs);
+    static Container makeContainer(uint64_t key, const std::vector<uint64_t>& words);
+
+    static LocalRuns localRuns(const Container& container);
+    static std::vector<uint64_t> toBitmap(const Container& container);
+    static bool contains(const Container& container, uint32_t offset);
+
+    static Container intersection(const Container& lhs, const Container& rhs);
+    static Container union_(const Container& lhs, const Container& rhs);
+    static Container difference(const Container& lhs, const Container& rhs);
+    static Container symmetricDifference(const Container& lhs, const Container& rhs);
+
+    template <class F>
+    static void forEachLocalRun(const Container& container, F f);
+
+    // The run of `container` starting at or after `position`, which is then
+    // moved past it; see `nextRange`.
+    static bool nextLocalRun(const Container& container, uint32_t& position, LocalRun& run);
+
+    // Sorted by `key`, no empty containers.
+    std::vector<Container> blocks_;
+};
+
+/** Combine two lists of canonical ranges in a single merge pass.
+ *
+ * Walks the boundaries of `lhs` and `rhs` in increasing order; an id is part
+ * of the result iff `op(in_lhs, in_rhs)`. The result is canonical.
+ *
+ * `RangeList` is a vector of `std::array<T, 2>` ranges `[begin, end)`.
+ */
+template <class RangeList, class Op>
+RangeList _combineRanges(const RangeList& lhs, const RangeList& rhs, Op op) {
+    using T = typename RangeList::value_type::value_type;
+
+    // The `k`-th boundary of `ranges` is `ranges[k / 2][k % 2]`; an odd number
+    // of boundaries has been passed iff we're inside a range.
+    const size_t n0 = 2 * lhs.size();
+    const size_t n1 = 2 * rhs.size();
+    size_t k0 = 0;
+    size_t k1 = 0;
+
+    RangeList ret;
+    bool inside = false;
+    T begin = 0;
+    while (k0 < n0 || k1 < n1) {
+        T x;
+        if (k1 == n1 || (k0 < n0 && lhs[k0 / 2][k0 % 2] < rhs[k1 / 2][k1 % 2])) {
+            x = lhs[k0 / 2][k0 % 2];
+        } else {
+            x = rhs[k1 / 2][k1 % 2];
+        }
+
+        // Canonical ranges are non-adjacent, each list has at most one boundary at `x`.
+        if (k0 < n0 && lhs[k0 / 2][k0 % 2] == x) {
+            ++k0;
+        }
+        if (k1 < n1 && rhs[k1 / 2][k1 % 2] == x) {
+            ++k1;
+        }
+
+        const bool keep = op(k0 % 2 == 1, k1 % 2 == 1);
+        if (keep && !inside) {
+            begin = x;
+        } else if (!keep && inside) {
+            ret.push_back({begin, x});
+        }
+        inside = keep;
+    }
+
+    return ret;
+}
+
+inline int _countTrailingZeros(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int n = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+template <class F>
+void CompressedSelection::forEachLocalRun(const Container& container, F f) {
+    switch (container.kind) {
+    case Kind::runs:
+        for (size_t i = 0; i < container.values.size(); i += 2) {
+            f(LocalRun{container.values[i], uint32_t(container.values[i + 1]) + 1});
+        }
+        break;
+    case Kind::array: {
+        const auto& values = container.values;
+        size_t i = 0;
+        while (i < values.size()) {
+            uint32_t begin = values[i];
+            uint32_t end = begin + 1;
+            for (++i; i < values.size() && values[i] == end; ++i) {
+                ++end;
+            }
+            f(LocalRun{begin, end});
+        }
+        break;
+    }
+    case Kind::bitmap: {
+        bool in_run = false;
+        uint32_t begin = 0;
+        for (uint32_t i = 0; i < bitmap_words; ++i) {
+            const uint64_t word = container.words[i];
+            uint32_t pos = 0;
+            while (pos < 64) {
+                // Look for the next bit that differs from the current state.
+                const uint64_t rest = (in_run ? ~word : word) >> pos;
+                if (rest == 0) {
+                    break;
+                }
+                pos += static_cast<uint32_t>(_countTrailingZeros(rest));
+                if (in_run) {
+                    f(LocalRun{begin, 64 * i + pos});
+                } else {
+                    begin = 64 * i + pos;
+                }
+                in_run = !in_run;
+            }
+        }
+        if (in_run) {
+            f(LocalRun{begin, block_size});
+        }
+        break;
+    }
+    }
+}
+
+template <class F>
+void CompressedSelection::forEachRange(F f) const {
+    Range pending{0, 0};
+    for (const auto& container : blocks_) {
+        const Value offset = container.key << block_bits;
+        forEachLocalRun(container, [&pending, &f, offset](const LocalRun& run) {
+            const Value begin = offset + std::get<0>(run);
+            const Value end = offset + std::get<1>(run);
+            if (std::get<0>(pending) < std::get<1>(pending)) {
+                if (std::get<1>(pending) == begin) {
+                    // Adjacent across the block boundary.
+                    std::get<1>(pending) = end;
+                    return;
+                }
+                f(pending);
+            }
+            pending = Range{begin, end};
+        });
+    }
+
+    if (std::get<0>(pending) < std::get<1>(pending)) {
+        f(pending);
+    }
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -18,6 +18,7 @@
 #include <vector>
 
 #include "read_bulk.hpp"
+#include "tracing.hpp"
 
 namespace bbp {
 namespace sonata {
@@ -57,6 +58,7 @@ const HighFive::Group targetIndex(const HighFive::Group& h5Root) {
 Selection resolve(const HighFive::Group& indexGroup,
                   const std::vector<NodeID>& nodeIDs,
                   const Hdf5Reader& reader) {
+    detail::TraceScope trace("edge_index::resolve");
     auto node2ranges_dset = indexGroup.getDataSet(NODE_ID_TO_RANGES_DSET);
     auto node_dim = node2ranges_dset.getSpace().getDimensions()[0];
     auto sortedNodeIds = nodeIDs;
@@ -82,6 +84,8 @@ Selection resolve(const HighFive::Group& indexGroup,
     auto secondaryRange = reader.readSelection<std::array<uint64_t, 2>>(
         indexGroup.getDataSet(RANGE_TO_EDGE_ID_DSET), primaryRange, RawIndex{{0, 2}});
 
+    trace.setBytes((primaryRange.size() + secondaryRange.size()) * sizeof(secondaryRange[0]));
+
     // Sort and eliminate empty ranges.
     secondaryRange = bulk_read::sortAndMerge(secondaryRange);
 
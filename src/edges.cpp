@@ -49,7 +49,7 @@ EdgePopulation::EdgePopulation(const std::string& h5FilePath,
 std::string EdgePopulation::source() const {
     HDF5_LOCK_GUARD
     std::string result;
-    impl_->h5Root.getDataSet(SOURCE_NODE_ID_DSET).getAttribute(NODE_POPULATION_ATTR).read(result);
+    impl_->root().getDataSet(SOURCE_NODE_ID_DSET).getAttribute(NODE_POPULATION_ATTR).read(result);
     return result;
 }
 
@@ -57,47 +57,44 @@ std::string EdgePopulation::source() const {
 std::string EdgePopulation::target() const {
     HDF5_LOCK_GUARD
     std::string result;
-    impl_->h5Root.getDataSet(TARGET_NODE_ID_DSET).getAttribute(NODE_POPULATION_ATTR).read(result);
+    impl_->root().getDataSet(TARGET_NODE_ID_DSET).getAttribute(NODE_POPULATION_ATTR).read(result);
     return result;
 }
 
 
 std::vector<NodeID> EdgePopulation::sourceNodeIDs(const Selection& selection) const {
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "sourceNodeIDs");
     HDF5_LOCK_GUARD
-    const auto dset = impl_->h5Root.getDataSet(SOURCE_NODE_ID_DSET);
+    const auto dset = impl_->root().getDataSet(SOURCE_NODE_ID_DSET);
     return _readSelection<NodeID>(dset, selection, impl_->hdf5_reader);
 }
 
 
 std::vector<NodeID> EdgePopulation::targetNodeIDs(const Selection& selection) const {
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "targetNodeIDs");
     HDF5_LOCK_GUARD
-    const auto dset = impl_->h5Root.getDataSet(TARGET_NODE_ID_DSET);
+    const auto dset = impl_->root().getDataSet(TARGET_NODE_ID_DSET);
     return _readSelection<NodeID>(dset, selection, impl_->hdf5_reader);
 }
 
 
 Selection EdgePopulation::afferentEdges(const std::vector<NodeID>& target) const {
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "afferentEdges");
     HDF5_LOCK_GUARD
-    return edge_index::resolve(edge_index::targetIndex(impl_->h5Root), target, impl_->hdf5_reader);
+    return edge_index::resolve(edge_index::targetIndex(impl_->root()), target, impl_->hdf5_reader);
 }
 
 
 Selection EdgePopulation::efferentEdges(const std::vector<NodeID>& source) const {
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "efferentEdges");
     HDF5_LOCK_GUARD
-    return edge_index::resolve(edge_index::sourceIndex(impl_->h5Root), source, impl_->hdf5_reader);
+    return edge_index::resolve(edge_index::sourceIndex(impl_->root()), source, impl_->hdf5_reader);
 }
 
 
 Selection EdgePopulation::connectingEdges(const std::vector<NodeID>& source,
                                           const std::vector<NodeID>& target) const {
-    // TODO optimize: range intersection
-    const auto pre = efferentEdges(source).flatten();
-    const auto post = afferentEdges(target).flatten();
-    assert(std::is_sorted(pre.begin(), pre.end()));  // return result of _resolveIndex is sorted
-    assert(std::is_sorted(post.begin(), post.end()));
-    Selection::Values result;
-    set_intersection(pre.begin(), pre.end(), post.begin(), post.end(), std::back_inserter(result));
-    return Selection::fromValues(result);
+    return efferentEdges(source) & afferentEdges(target);
 }
 
 //--------------------------------------------------------------------------------------------------
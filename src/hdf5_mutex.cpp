@@ -9,6 +9,10 @@
 
 #include <mutex>
 
+#include <H5public.h>  // H5is_library_threadsafe
+
+#include "hdf5_mutex.hpp"
+
 
 namespace bbp {
 namespace sonata {
@@ -18,5 +22,13 @@ std::mutex& hdf5Mutex() {
     return _hdf5Mutex;
 }
 
+bool isHdf5ThreadSafe() {
+    static const bool _isThreadSafe = [] {
+        hbool_t is_ts = false;
+        return H5is_library_threadsafe(&is_ts) >= 0 && is_ts;
+    }();
+    return _isThreadSafe;
+}
+
 }  // namespace sonata
 }  // namespace bbp
@@ -9,12 +9,18 @@
 
 #pragma once
 
+#include <chrono>
 #include <mutex>
 
+#include <bbp/sonata/hdf5_reader.h>  // isHdf5ThreadSafe
+
+#include "io_statistics.hpp"
+#include "tracing.hpp"
+
 // Every access to hdf5 must be serialized if HDF5 does not take care of it
 // which needs a thread-safe built of the library.
 // https://support.hdfgroup.org/HDF5/faq/threadsafe.html
-#define HDF5_LOCK_GUARD std::lock_guard<std::mutex> _hdf5_lock(hdf5Mutex());
+#define HDF5_LOCK_GUARD Hdf5LockGuard _hdf5_lock;
 
 
 namespace bbp {
@@ -22,5 +28,37 @@ namespace sonata {
 
 std::mutex& hdf5Mutex();
 
-}
+/**
+ * Holds `hdf5Mutex`, unless HDF5 is built thread-safe.
+ *
+ * A thread-safe HDF5 serializes its API calls itself. Then, libsonata doesn't
+ * lock, and the work between HDF5 calls, e.g. copying selected elements out of
+ * blocks, runs concurrently.
+ */
+class Hdf5LockGuard
+{
+  public:
+    Hdf5LockGuard()
+        : lock_(hdf5Mutex(), std::defer_lock) {
+        if (isHdf5ThreadSafe()) {
+            return;
+        }
+
+        // The time spent waiting counts as "lock" in the statistics of this thread.
+        detail::TraceScope trace("lock");
+        auto* statistics = detail::currentIoStatistics();
+        if (statistics == nullptr) {
+            lock_.lock();
+        } else {
+            const auto start = std::chrono::steady_clock::now();
+            lock_.lock();
+            statistics->recordLatency("lock", std::chrono::steady_clock::now() - start);
+        }
+    }
+
+  private:
+    std::unique_lock<std::mutex> lock_;
+};
+
+}  // namespace sonata
 }  // namespace bbp
@@ -1,15 +1,107 @@
 #include <bbp/sonata/hdf5_reader.h>
 
+#include <fcntl.h>     // open, posix_fadvise
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // pread, close
+
+#include <algorithm>  // std::min, std::max
+#include <chrono>
+#include <fmt/format.h>
+
 #include "hdf5_reader.hpp"
 
 namespace bbp {
 namespace sonata {
 
+namespace {
+
+using Seconds = std::chrono::duration<double>;
+
+// Time to `pread` `size` bytes at `offset`.
+Seconds _timeRead(int fd, std::vector<char>& buffer, size_t size, off_t offset) {
+    buffer.resize(std::max(buffer.size(), size));
+    const auto start = std::chrono::steady_clock::now();
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = ::pread(fd, buffer.data() + done, size - done, offset + done);
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return std::chrono::steady_clock::now() - start;
+}
+
+}  // unnamed namespace
+
+
+ReadPolicy ReadPolicy::calibrate(const std::string& path) {
+    constexpr size_t small_read = 4 << 10;
+    constexpr size_t large_read = 64 << 20;
+    constexpr int n_small_reads = 16;
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw SonataError(fmt::format("Can't open '{}' for calibration", path));
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw SonataError(fmt::format("Can't stat '{}' for calibration", path));
+    }
+    const auto file_size = static_cast<size_t>(info.st_size);
+
+#ifdef POSIX_FADV_DONTNEED
+    // Ask to drop the file from the page cache, to measure the storage.
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+
+    std::vector<char> buffer;
+
+    // Latency: the fastest of a few small reads spread over the file.
+    Seconds latency = Seconds::max();
+    for (int i = 0; i < n_small_reads; ++i) {
+        const auto offset = static_cast<off_t>(file_size / n_small_reads * i);
+        latency = std::min(latency, _timeRead(fd, buffer, small_read, offset));
+    }
+
+    // Bandwidth: one large read, less the latency.
+    const size_t size = std::min(file_size, large_read);
+    const Seconds elapsed = _timeRead(fd, buffer, size, 0);
+    ::close(fd);
+
+    ReadPolicy read_policy;
+    if (size == 0 || elapsed <= latency) {
+        return read_policy;
+    }
+    const double bandwidth = static_cast<double>(size) / (elapsed - latency).count();
+
+    // Reading a gap of `latency * bandwidth` bytes takes as long as a new read; a
+    // block of 16 times that amortizes the latency to a few percent.
+    const auto gap = static_cast<size_t>(latency.count() * bandwidth);
+    read_policy.min_gap_bytes = std::min(std::max(gap, small_read), size_t(64) << 20);
+    read_policy.max_block_bytes = std::min(std::max(16 * read_policy.min_gap_bytes,
+                                                    size_t(1) << 20),
+                                           size_t(1) << 30);
+
+    return read_policy;
+}
+
 
 Hdf5Reader::Hdf5Reader()
     : impl(std::make_shared<
            Hdf5PluginDefault<Hdf5Reader::supported_1D_types, supported_2D_types>>()) { }
 
+Hdf5Reader::Hdf5Reader(Hdf5ReadStrategy strategy, const ReadPolicy& read_policy)
+    : impl(std::make_shared<
+           Hdf5PluginDefault<Hdf5Reader::supported_1D_types, supported_2D_types>>(strategy,
+                                                                                  read_policy)) {
+}
+
+Hdf5Reader::Hdf5Reader(const ReadPolicy& read_policy)
+    : Hdf5Reader(Hdf5ReadStrategy::mergedBlocks, read_policy) { }
+
 Hdf5Reader::Hdf5Reader(
     std::shared_ptr<Hdf5PluginInterface<supported_1D_types, supported_2D_types>> impl)
     : impl(std::move(impl)) { }
@@ -18,5 +110,68 @@ HighFive::File Hdf5Reader::openFile(const std::string& filename) const {
     return impl->openFile(filename);
 }
 
+Hdf5Reader makeDirectChunkReader(size_t n_threads, const ReadPolicy& read_policy) {
+    return Hdf5Reader(std::make_shared<Hdf5PluginDirectChunk<Hdf5Reader::supported_1D_types,
+                                                             Hdf5Reader::supported_2D_types>>(
+        n_threads, read_policy));
+}
+
+Hdf5Reader makeMmapReader(const ReadPolicy& read_policy) {
+    return Hdf5Reader(
+        std::make_shared<
+            Hdf5PluginMmap<Hdf5Reader::supported_1D_types, Hdf5Reader::supported_2D_types>>(
+            read_policy));
+}
+
+Hdf5Reader makeIoUringReader(unsigned queue_depth, const ReadPolicy& read_policy) {
+    return Hdf5Reader(
+        std::make_shared<
+            Hdf5PluginIoUring<Hdf5Reader::supported_1D_types, Hdf5Reader::supported_2D_types>>(
+            queue_depth, read_policy));
+}
+
+BlockCache::BlockCache(size_t max_bytes, size_t block_bytes)
+    : impl(std::make_shared<detail::BlockCacheImpl>(max_bytes, block_bytes)) { }
+
+BlockCacheStatistics BlockCache::statistics() const {
+    return impl->statistics();
+}
+
+void BlockCache::clear() {
+    impl->clear();
+}
+
+Hdf5Reader makeCachingReader(const BlockCache& cache, const Hdf5Reader& reader) {
+    return Hdf5Reader(
+        std::make_shared<
+            Hdf5PluginCaching<Hdf5Reader::supported_1D_types, Hdf5Reader::supported_2D_types>>(
+            cache.impl, reader));
+}
+
+Hdf5Reader makePipelinedReader(size_t prefetch_depth, const ReadPolicy& read_policy) {
+    return Hdf5Reader(
+        std::make_shared<
+            Hdf5PluginPipelined<Hdf5Reader::supported_1D_types, Hdf5Reader::supported_2D_types>>(
+            prefetch_depth, read_policy));
+}
+
+IoStatistics::IoStatistics()
+    : impl(std::make_shared<detail::IoStatisticsImpl>()) { }
+
+IoCounters IoStatistics::counters() const {
+    return impl->counters();
+}
+
+void IoStatistics::reset() {
+    impl->reset();
+}
+
+Hdf5Reader makeInstrumentedReader(const IoStatistics& statistics, const Hdf5Reader& reader) {
+    return Hdf5Reader(
+        std::make_shared<Hdf5PluginInstrumented<Hdf5Reader::supported_1D_types,
+                                                Hdf5Reader::supported_2D_types>>(statistics.impl,
+                                                                                 reader));
+}
+
 }  // namespace sonata
 }  // namespace bbp
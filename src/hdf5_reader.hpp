@@ -1,46 +1,69 @@
 #pragma once
 
+#include "block_cache.hpp"
+#include "io_statistics.hpp"
 #include "population.hpp"
 #include "read_bulk.hpp"
 #include "read_canonical_selection.hpp"
+#include "read_direct_chunk.hpp"
+#include "read_io_uring.hpp"
+#include "read_mmap.hpp"
+#include "thread_pool.h"
 
 namespace bbp {
 namespace sonata {
 
-namespace detail {
-template <class Range>
-HighFive::HyperSlab _makeHyperslab(const std::vector<Range>& ranges) {
-    HighFive::HyperSlab slab;
-    for (const auto& range : ranges) {
-        size_t i_begin = std::get<0>(range);
-        size_t i_end = std::get<1>(range);
-        slab |= HighFive::RegularHyperSlab({i_begin}, {i_end - i_begin});
-    }
-
-    return slab;
-}
-}  // namespace detail
 
 
 template <class T>
 class Hdf5PluginRead1DDefault: virtual public Hdf5PluginRead1DInterface<T>
 {
   public:
+    explicit Hdf5PluginRead1DDefault(Hdf5ReadStrategy strategy = Hdf5ReadStrategy::mergedBlocks,
+                                     const ReadPolicy& read_policy = ReadPolicy())
+        : strategy_(strategy)
+        , read_policy_(read_policy) { }
+
     std::vector<T> readSelection(const HighFive::DataSet& dset,
                                  const Selection& selection) const override {
-        return detail::readCanonicalSelection<T>(dset, selection);
+        switch (strategy_) {
+        case Hdf5ReadStrategy::unionHyperslab:
+            return detail::readCanonicalSelectionUnion<T>(dset, selection);
+        case Hdf5ReadStrategy::mergedBlocks:
+            return detail::readCanonicalSelection<T>(dset, selection, read_policy_);
+        }
+        LIBSONATA_THROW_IF_REACHED
     }
+
+  private:
+    Hdf5ReadStrategy strategy_;
+    ReadPolicy read_policy_;
 };
 
 template <class T>
 class Hdf5PluginRead2DDefault: virtual public Hdf5PluginRead2DInterface<T>
 {
   public:
+    explicit Hdf5PluginRead2DDefault(Hdf5ReadStrategy strategy = Hdf5ReadStrategy::mergedBlocks,
+                                     const ReadPolicy& read_policy = ReadPolicy())
+        : strategy_(strategy)
+        , read_policy_(read_policy) { }
+
     std::vector<T> readSelection(const HighFive::DataSet& dset,
                                  const Selection& xsel,
                                  const Selection& ysel) const override {
-        return detail::readCanonicalSelection<T>(dset, xsel, ysel);
+        switch (strategy_) {
+        case Hdf5ReadStrategy::unionHyperslab:
+            return detail::readCanonicalSelectionUnion<T>(dset, xsel, ysel);
+        case Hdf5ReadStrategy::mergedBlocks:
+            return detail::readCanonicalSelection<T>(dset, xsel, ysel, read_policy_);
+        }
+        LIBSONATA_THROW_IF_REACHED
     }
+
+  private:
+    Hdf5ReadStrategy strategy_;
+    ReadPolicy read_policy_;
 };
 
 template <class T, class U>
@@ -53,11 +76,464 @@ class Hdf5PluginDefault<std::tuple<Ts...>, std::tuple<Us...>>
       virtual public Hdf5PluginRead2DDefault<Us>...
 {
   public:
+    explicit Hdf5PluginDefault(Hdf5ReadStrategy strategy = Hdf5ReadStrategy::mergedBlocks,
+                               const ReadPolicy& read_policy = ReadPolicy())
+        : Hdf5PluginRead1DDefault<Ts>(strategy, read_policy)...
+        , Hdf5PluginRead2DDefault<Us>(strategy, read_policy)... { }
+
+    HighFive::File openFile(const std::string& path) const override {
+        return HighFive::File(path);
+    }
+};
+
+template <class T>
+class Hdf5PluginRead1DDirectChunk: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    Hdf5PluginRead1DDirectChunk(std::shared_ptr<detail::ThreadPool> pool,
+                                const ReadPolicy& read_policy)
+        : pool_(std::move(pool))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        return detail::readDirectChunkSelection<T>(dset, selection, *pool_, read_policy_);
+    }
+
+  private:
+    std::shared_ptr<detail::ThreadPool> pool_;
+    ReadPolicy read_policy_;
+};
+
+template <class T>
+class Hdf5PluginRead2DDirectChunk: virtual public Hdf5PluginRead2DInterface<T>
+{
+  public:
+    Hdf5PluginRead2DDirectChunk(std::shared_ptr<detail::ThreadPool> pool,
+                                const ReadPolicy& read_policy)
+        : pool_(std::move(pool))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& xsel,
+                                 const Selection& ysel) const override {
+        return detail::readDirectChunkSelection<T>(dset, xsel, ysel, *pool_, read_policy_);
+    }
+
+  private:
+    std::shared_ptr<detail::ThreadPool> pool_;
+    ReadPolicy read_policy_;
+};
+
+/// Reads chunked datasets with `H5Dread_chunk`, and decodes them on a thread pool.
+///
+/// @sa `makeDirectChunkReader`.
+template <class T, class U>
+class Hdf5PluginDirectChunk;
+
+template <class... Ts, class... Us>
+class Hdf5PluginDirectChunk<std::tuple<Ts...>, std::tuple<Us...>>
+    : virtual public Hdf5PluginInterface<std::tuple<Ts...>, std::tuple<Us...>>,
+      virtual public Hdf5PluginRead1DDirectChunk<Ts>...,
+      virtual public Hdf5PluginRead2DDirectChunk<Us>...
+{
+  public:
+    Hdf5PluginDirectChunk(size_t n_threads, const ReadPolicy& read_policy)
+        : Hdf5PluginDirectChunk(std::make_shared<detail::ThreadPool>(n_threads), read_policy) { }
+
+    HighFive::File openFile(const std::string& path) const override {
+        return HighFive::File(path);
+    }
+
+  private:
+    Hdf5PluginDirectChunk(const std::shared_ptr<detail::ThreadPool>& pool,
+                          const ReadPolicy& read_policy)
+        : Hdf5PluginRead1DDirectChunk<Ts>(pool, read_policy)...
+        , Hdf5PluginRead2DDirectChunk<Us>(pool, read_policy)... { }
+};
+
+template <class T>
+class Hdf5PluginRead1DMmap: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    Hdf5PluginRead1DMmap(std::shared_ptr<detail::MmapCache> cache, const ReadPolicy& read_policy)
+        : cache_(std::move(cache))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        return detail::readContiguousSelection<T>(
+            dset, selection, *cache_, detail::_gatherMapped, read_policy_);
+    }
+
+  private:
+    std::shared_ptr<detail::MmapCache> cache_;
+    ReadPolicy read_policy_;
+};
+
+template <class T>
+class Hdf5PluginRead2DMmap: virtual public Hdf5PluginRead2DInterface<T>
+{
+  public:
+    Hdf5PluginRead2DMmap(std::shared_ptr<detail::MmapCache> cache, const ReadPolicy& read_policy)
+        : cache_(std::move(cache))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& xsel,
+                                 const Selection& ysel) const override {
+        return detail::readContiguousSelection<T>(
+            dset, xsel, ysel, *cache_, detail::_gatherMapped, read_policy_);
+    }
+
+  private:
+    std::shared_ptr<detail::MmapCache> cache_;
+    ReadPolicy read_policy_;
+};
+
+/// Reads contiguous datasets by copying them out of the memory mapped file.
+///
+/// @sa `makeMmapReader`.
+template <class T, class U>
+class Hdf5PluginMmap;
+
+template <class... Ts, class... Us>
+class Hdf5PluginMmap<std::tuple<Ts...>, std::tuple<Us...>>
+    : virtual public Hdf5PluginInterface<std::tuple<Ts...>, std::tuple<Us...>>,
+      virtual public Hdf5PluginRead1DMmap<Ts>...,
+      virtual public Hdf5PluginRead2DMmap<Us>...
+{
+  public:
+    explicit Hdf5PluginMmap(const ReadPolicy& read_policy)
+        : Hdf5PluginMmap(std::make_shared<detail::MmapCache>(), read_policy) { }
+
+    HighFive::File openFile(const std::string& path) const override {
+        return HighFive::File(path);
+    }
+
+  private:
+    Hdf5PluginMmap(const std::shared_ptr<detail::MmapCache>& cache, const ReadPolicy& read_policy)
+        : Hdf5PluginRead1DMmap<Ts>(cache, read_policy)...
+        , Hdf5PluginRead2DMmap<Us>(cache, read_policy)... { }
+};
+
+template <class T>
+class Hdf5PluginRead1DIoUring: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    Hdf5PluginRead1DIoUring(std::shared_ptr<detail::BatchReader> reader,
+                            std::shared_ptr<detail::IoUringCache> cache,
+                            const ReadPolicy& read_policy)
+        : reader_(std::move(reader))
+        , cache_(std::move(cache))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        return detail::readContiguousSelection<T>(dset, selection, *cache_, gather(), read_policy_);
+    }
+
+  private:
+    auto gather() const {
+        return [this](const auto&... args) { detail::_gatherIoUring(*reader_, args...); };
+    }
+
+    std::shared_ptr<detail::BatchReader> reader_;
+    std::shared_ptr<detail::IoUringCache> cache_;
+    ReadPolicy read_policy_;
+};
+
+template <class T>
+class Hdf5PluginRead2DIoUring: virtual public Hdf5PluginRead2DInterface<T>
+{
+  public:
+    Hdf5PluginRead2DIoUring(std::shared_ptr<detail::BatchReader> reader,
+                            std::shared_ptr<detail::IoUringCache> cache,
+                            const ReadPolicy& read_policy)
+        : reader_(std::move(reader))
+        , cache_(std::move(cache))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& xsel,
+                                 const Selection& ysel) const override {
+        return detail::readContiguousSelection<T>(
+            dset, xsel, ysel, *cache_, gather(), read_policy_);
+    }
+
+  private:
+    auto gather() const {
+        return [this](const auto&... args) { detail::_gatherIoUring(*reader_, args...); };
+    }
+
+    std::shared_ptr<detail::BatchReader> reader_;
+    std::shared_ptr<detail::IoUringCache> cache_;
+    ReadPolicy read_policy_;
+};
+
+/// Reads contiguous datasets with batches of io_uring requests.
+///
+/// @sa `makeIoUringReader`.
+template <class T, class U>
+class Hdf5PluginIoUring;
+
+template <class... Ts, class... Us>
+class Hdf5PluginIoUring<std::tuple<Ts...>, std::tuple<Us...>>
+    : virtual public Hdf5PluginInterface<std::tuple<Ts...>, std::tuple<Us...>>,
+      virtual public Hdf5PluginRead1DIoUring<Ts>...,
+      virtual public Hdf5PluginRead2DIoUring<Us>...
+{
+  public:
+    Hdf5PluginIoUring(unsigned queue_depth, const ReadPolicy& read_policy)
+        : Hdf5PluginIoUring(std::make_shared<detail::BatchReader>(queue_depth),
+                            std::make_shared<detail::IoUringCache>(),
+                            read_policy) { }
+
+    HighFive::File openFile(const std::string& path) const override {
+        return HighFive::File(path);
+    }
+
+  private:
+    Hdf5PluginIoUring(const std::shared_ptr<detail::BatchReader>& reader,
+                      const std::shared_ptr<detail::IoUringCache>& cache,
+                      const ReadPolicy& read_policy)
+        : Hdf5PluginRead1DIoUring<Ts>(reader, cache, read_policy)...
+        , Hdf5PluginRead2DIoUring<Us>(reader, cache, read_policy)... { }
+};
+
+template <class T>
+class Hdf5PluginRead1DCaching: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    Hdf5PluginRead1DCaching(std::shared_ptr<detail::BlockCacheImpl> cache,
+                            const Hdf5Reader& reader)
+        : cache_(std::move(cache))
+        , reader_(reader) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        return detail::readCachedSelection<T>(
+            *cache_, dset, selection, {}, [&](const Selection& blocks) {
+                return reader_.readSelection<T>(dset, blocks);
+            });
+    }
+
+  private:
+    std::shared_ptr<detail::BlockCacheImpl> cache_;
+    Hdf5Reader reader_;
+};
+
+template <class T>
+class Hdf5PluginRead2DCaching: virtual public Hdf5PluginRead2DInterface<T>
+{
+  public:
+    Hdf5PluginRead2DCaching(std::shared_ptr<detail::BlockCacheImpl> cache,
+                            const Hdf5Reader& reader)
+        : cache_(std::move(cache))
+        , reader_(reader) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& xsel,
+                                 const Selection& ysel) const override {
+        return detail::readCachedSelection<T>(
+            *cache_,
+            dset,
+            xsel,
+            ysel.ranges(),
+            [&](const Selection& blocks) { return reader_.readSelection<T>(dset, blocks, ysel); },
+            detail::_rowWidth<T>(ysel));
+    }
+
+  private:
+    std::shared_ptr<detail::BlockCacheImpl> cache_;
+    Hdf5Reader reader_;
+};
+
+/// Reads blocks of datasets with another reader, and keeps them in a `BlockCache`.
+///
+/// @sa `makeCachingReader`.
+template <class T, class U>
+class Hdf5PluginCaching;
+
+template <class... Ts, class... Us>
+class Hdf5PluginCaching<std::tuple<Ts...>, std::tuple<Us...>>
+    : virtual public Hdf5PluginInterface<std::tuple<Ts...>, std::tuple<Us...>>,
+      virtual public Hdf5PluginRead1DCaching<Ts>...,
+      virtual public Hdf5PluginRead2DCaching<Us>...
+{
+  public:
+    Hdf5PluginCaching(const std::shared_ptr<detail::BlockCacheImpl>& cache,
+                      const Hdf5Reader& reader)
+        : Hdf5PluginRead1DCaching<Ts>(cache, reader)...
+        , Hdf5PluginRead2DCaching<Us>(cache, reader)...
+        , reader_(reader) { }
+
+    HighFive::File openFile(const std::string& path) const override {
+        return reader_.openFile(path);
+    }
+
+  private:
+    Hdf5Reader reader_;
+};
+
+template <class T>
+class Hdf5PluginRead1DPipelined: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    Hdf5PluginRead1DPipelined(std::shared_ptr<detail::ThreadPool> io_thread,
+                              size_t prefetch_depth,
+                              const ReadPolicy& read_policy)
+        : io_thread_(std::move(io_thread))
+        , prefetch_depth_(prefetch_depth)
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        return detail::readCanonicalSelection<T>(dset,
+                                                 selection,
+                                                 read_policy_,
+                                                 {io_thread_.get(), prefetch_depth_});
+    }
+
+  private:
+    std::shared_ptr<detail::ThreadPool> io_thread_;
+    size_t prefetch_depth_;
+    ReadPolicy read_policy_;
+};
+
+template <class T>
+class Hdf5PluginRead2DPipelined: virtual public Hdf5PluginRead2DInterface<T>
+{
+  public:
+    Hdf5PluginRead2DPipelined(std::shared_ptr<detail::ThreadPool> io_thread,
+                              size_t prefetch_depth,
+                              const ReadPolicy& read_policy)
+        : io_thread_(std::move(io_thread))
+        , prefetch_depth_(prefetch_depth)
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& xsel,
+                                 const Selection& ysel) const override {
+        return detail::readCanonicalSelection<T>(
+            dset, xsel, ysel, read_policy_, {io_thread_.get(), prefetch_depth_});
+    }
+
+  private:
+    std::shared_ptr<detail::ThreadPool> io_thread_;
+    size_t prefetch_depth_;
+    ReadPolicy read_policy_;
+};
+
+/// Reads merged blocks on a dedicated I/O thread, ahead of extracting them.
+///
+/// @sa `makePipelinedReader`.
+template <class T, class U>
+class Hdf5PluginPipelined;
+
+template <class... Ts, class... Us>
+class Hdf5PluginPipelined<std::tuple<Ts...>, std::tuple<Us...>>
+    : virtual public Hdf5PluginInterface<std::tuple<Ts...>, std::tuple<Us...>>,
+      virtual public Hdf5PluginRead1DPipelined<Ts>...,
+      virtual public Hdf5PluginRead2DPipelined<Us>...
+{
+  public:
+    Hdf5PluginPipelined(size_t prefetch_depth, const ReadPolicy& read_policy)
+        : Hdf5PluginPipelined(std::make_shared<detail::ThreadPool>(1),
+                              prefetch_depth,
+                              read_policy) { }
+
     HighFive::File openFile(const std::string& path) const override {
         return HighFive::File(path);
     }
+
+  private:
+    Hdf5PluginPipelined(const std::shared_ptr<detail::ThreadPool>& io_thread,
+                        size_t prefetch_depth,
+                        const ReadPolicy& read_policy)
+        : Hdf5PluginRead1DPipelined<Ts>(io_thread, prefetch_depth, read_policy)...
+        , Hdf5PluginRead2DPipelined<Us>(io_thread, prefetch_depth, read_policy)... { }
 };
 
+template <class T>
+class Hdf5PluginRead1DInstrumented: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    Hdf5PluginRead1DInstrumented(std::shared_ptr<detail::IoStatisticsImpl> statistics,
+                                 const Hdf5Reader& reader)
+        : statistics_(std::move(statistics))
+        , reader_(reader) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        // A population counting into the same statistics counts the read itself.
+        const bool counted = detail::currentIoStatistics() == statistics_.get();
+        detail::IoStatisticsScope scope(statistics_, "readSelection");
+        auto values = reader_.readSelection<T>(dset, selection);
+        if (!counted) {
+            statistics_->recordRead(detail::_byteSize(values));
+        }
+        return values;
+    }
+
+  private:
+    std::shared_ptr<detail::IoStatisticsImpl> statistics_;
+    Hdf5Reader reader_;
+};
+
+template <class T>
+class Hdf5PluginRead2DInstrumented: virtual public Hdf5PluginRead2DInterface<T>
+{
+  public:
+    Hdf5PluginRead2DInstrumented(std::shared_ptr<detail::IoStatisticsImpl> statistics,
+                                 const Hdf5Reader& reader)
+        : statistics_(std::move(statistics))
+        , reader_(reader) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& xsel,
+                                 const Selection& ysel) const override {
+        // A population counting into the same statistics counts the read itself.
+        const bool counted = detail::currentIoStatistics() == statistics_.get();
+        detail::IoStatisticsScope scope(statistics_, "readSelection");
+        auto values = reader_.readSelection<T>(dset, xsel, ysel);
+        if (!counted) {
+            statistics_->recordRead(detail::_byteSize(values));
+        }
+        return values;
+    }
+
+  private:
+    std::shared_ptr<detail::IoStatisticsImpl> statistics_;
+    Hdf5Reader reader_;
+};
+
+/// Reads with another reader, and counts the reads in an `IoStatistics`.
+///
+/// @sa `makeInstrumentedReader`.
+template <class T, class U>
+class Hdf5PluginInstrumented;
+
+template <class... Ts, class... Us>
+class Hdf5PluginInstrumented<std::tuple<Ts...>, std::tuple<Us...>>
+    : virtual public Hdf5PluginInterface<std::tuple<Ts...>, std::tuple<Us...>>,
+      virtual public Hdf5PluginRead1DInstrumented<Ts>...,
+      virtual public Hdf5PluginRead2DInstrumented<Us>...
+{
+  public:
+    Hdf5PluginInstrumented(const std::shared_ptr<detail::IoStatisticsImpl>& statistics,
+                           const Hdf5Reader& reader)
+        : Hdf5PluginRead1DInstrumented<Ts>(statistics, reader)...
+        , Hdf5PluginRead2DInstrumented<Us>(statistics, reader)...
+        , reader_(reader) { }
+
+    HighFive::File openFile(const std::string& path) const override {
+        return reader_.openFile(path);
+    }
+
+  private:
+    Hdf5Reader reader_;
+};
 
 }  // namespace sonata
 }  // namespace bbp
@@ -0,0 +1,103 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include <bbp/sonata/hdf5_reader_mpi.h>
+
+#include <H5public.h>  // H5_HAVE_PARALLEL
+
+#include "read_collective.hpp"
+
+namespace bbp {
+namespace sonata {
+
+template <class T>
+class Hdf5PluginRead1DMPI: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    Hdf5PluginRead1DMPI(std::shared_ptr<detail::CollectiveComm> comm,
+                        const ReadPolicy& read_policy)
+        : comm_(std::move(comm))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        return detail::readCollectiveSelection<T>(*comm_, dset, selection, read_policy_);
+    }
+
+  private:
+    std::shared_ptr<detail::CollectiveComm> comm_;
+    ReadPolicy read_policy_;
+};
+
+template <class T>
+class Hdf5PluginRead2DMPI: virtual public Hdf5PluginRead2DInterface<T>
+{
+  public:
+    Hdf5PluginRead2DMPI(std::shared_ptr<detail::CollectiveComm> comm,
+                        const ReadPolicy& read_policy)
+        : comm_(std::move(comm))
+        , read_policy_(read_policy) { }
+
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& xsel,
+                                 const Selection& ysel) const override {
+        return detail::readCollectiveSelection<T>(*comm_, dset, xsel, ysel, read_policy_);
+    }
+
+  private:
+    std::shared_ptr<detail::CollectiveComm> comm_;
+    ReadPolicy read_policy_;
+};
+
+/// Reads collectively, with a few aggregator ranks reading for all.
+///
+/// @sa `makeCollectiveReader`.
+template <class T, class U>
+class Hdf5PluginMPI;
+
+template <class... Ts, class... Us>
+class Hdf5PluginMPI<std::tuple<Ts...>, std::tuple<Us...>>
+    : virtual public Hdf5PluginInterface<std::tuple<Ts...>, std::tuple<Us...>>,
+      virtual public Hdf5PluginRead1DMPI<Ts>...,
+      virtual public Hdf5PluginRead2DMPI<Us>...
+{
+  public:
+    Hdf5PluginMPI(MPI_Comm comm, int n_aggregators, const ReadPolicy& read_policy)
+        : Hdf5PluginMPI(std::make_shared<detail::CollectiveComm>(comm, n_aggregators),
+                        read_policy) { }
+
+    HighFive::File openFile(const std::string& path) const override {
+#ifdef H5_HAVE_PARALLEL
+        HighFive::FileAccessProps fapl;
+        fapl.add(HighFive::MPIOFileAccess{comm_->get(), MPI_INFO_NULL});
+        return HighFive::File(path, HighFive::File::ReadOnly, fapl);
+#else
+        return HighFive::File(path);
+#endif
+    }
+
+  private:
+    Hdf5PluginMPI(const std::shared_ptr<detail::CollectiveComm>& comm,
+                  const ReadPolicy& read_policy)
+        : Hdf5PluginRead1DMPI<Ts>(comm, read_policy)...
+        , Hdf5PluginRead2DMPI<Us>(comm, read_policy)...
+        , comm_(comm) { }
+
+    std::shared_ptr<detail::CollectiveComm> comm_;
+};
+
+Hdf5Reader makeCollectiveReader(MPI_Comm comm, int n_aggregators, const ReadPolicy& read_policy) {
+    return Hdf5Reader(
+        std::make_shared<
+            Hdf5PluginMPI<Hdf5Reader::supported_1D_types, Hdf5Reader::supported_2D_types>>(
+            comm, n_aggregators, read_policy));
+}
+
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,102 @@
+#include "io_statistics.hpp"
+
+#include <algorithm>  // std::max
+#include <cmath>      // std::ceil, std::log2
+#include <utility>    // std::move
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+namespace {
+
+thread_local IoStatisticsImpl* _currentIoStatistics = nullptr;
+
+// `0` below 1 us, `k` for `2^(k-1)` to `2^k` us, capped at the last bucket.
+size_t _bucket(double seconds) {
+    const double us = seconds * 1e6;
+    if (us < 1.0) {
+        return 0;
+    }
+    const auto k = static_cast<size_t>(std::ceil(std::log2(us)));
+    const size_t last = IoStatisticsImpl::n_buckets - 1;
+    return k < last ? std::max<size_t>(k, 1) : last;
+}
+
+}  // unnamed namespace
+
+
+void IoStatisticsImpl::recordLatency(const char* name, Seconds elapsed) {
+    const double seconds = elapsed.count();
+    const size_t bucket = _bucket(seconds);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& histogram = histograms_[name];
+    histogram.count += 1;
+    histogram.total_seconds += seconds;
+    histogram.max_seconds = std::max(histogram.max_seconds, seconds);
+    histogram.buckets[bucket] += 1;
+}
+
+IoCounters IoStatisticsImpl::counters() const {
+    IoCounters counters;
+    counters.reads = reads_;
+    counters.bytes_requested = bytes_requested_;
+    counters.bytes_read = bytes_read_;
+    counters.blocks = blocks_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& it : histograms_) {
+        const auto& histogram = it.second;
+        LatencyHistogram latency;
+        latency.count = histogram.count;
+        latency.total_seconds = histogram.total_seconds;
+        latency.max_seconds = histogram.max_seconds;
+        latency.buckets.assign(histogram.buckets.begin(), histogram.buckets.end());
+        counters.latencies.emplace(it.first, std::move(latency));
+    }
+
+    const auto lock_wait = histograms_.find("lock");
+    if (lock_wait != histograms_.end()) {
+        counters.lock_wait_seconds = lock_wait->second.total_seconds;
+    }
+
+    return counters;
+}
+
+void IoStatisticsImpl::reset() {
+    reads_ = 0;
+    bytes_requested_ = 0;
+    bytes_read_ = 0;
+    blocks_ = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms_.clear();
+}
+
+
+IoStatisticsImpl* currentIoStatistics() noexcept {
+    return _currentIoStatistics;
+}
+
+IoStatisticsScope::IoStatisticsScope(std::shared_ptr<IoStatisticsImpl> statistics,
+                                     const char* name)
+    : statistics_(std::move(statistics))
+    , previous_(_currentIoStatistics)
+    , name_(name) {
+    if (statistics_ != nullptr) {
+        _currentIoStatistics = statistics_.get();
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+IoStatisticsScope::~IoStatisticsScope() {
+    if (statistics_ != nullptr) {
+        statistics_->recordLatency(name_, std::chrono::steady_clock::now() - start_);
+        _currentIoStatistics = previous_;
+    }
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <bbp/sonata/hdf5_reader.h>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/** The shared state of an `IoStatistics`.
+ *
+ * Counters are atomic, such that blocks read on other threads, e.g. the I/O
+ * thread of a pipelined reader, can be counted. All methods are thread-safe.
+ */
+class IoStatisticsImpl
+{
+  public:
+    using Seconds = std::chrono::duration<double>;
+
+    static constexpr size_t n_buckets = 32;
+
+    /// A call of `readSelection`, for `bytes` of selected elements.
+    void recordRead(uint64_t bytes) noexcept {
+        reads_ += 1;
+        bytes_requested_ += bytes;
+    }
+
+    /// `n_blocks` blocks read from a file, of `bytes` in total.
+    void recordBlocks(uint64_t n_blocks, uint64_t bytes) noexcept {
+        blocks_ += n_blocks;
+        bytes_read_ += bytes;
+    }
+
+    /// An operation `name`, that took `elapsed`.
+    void recordLatency(const char* name, Seconds elapsed);
+
+    IoCounters counters() const;
+
+    void reset();
+
+  private:
+    struct Histogram {
+        uint64_t count = 0;
+        double total_seconds = 0.0;
+        double max_seconds = 0.0;
+        std::array<uint64_t, n_buckets> buckets{};
+    };
+
+    std::atomic<uint64_t> reads_{0};
+    std::atomic<uint64_t> bytes_requested_{0};
+    std::atomic<uint64_t> bytes_read_{0};
+    std::atomic<uint64_t> blocks_{0};
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Histogram> histograms_;
+};
+
+/// The statistics that reads on this thread are counted in; `nullptr` if none.
+IoStatisticsImpl* currentIoStatistics() noexcept;
+
+/** Count the reads of this thread in `statistics`, and time an operation.
+ *
+ * Until the scope ends, `currentIoStatistics()` is `statistics`; then, the
+ * duration of the scope is recorded as `name`, and the previous statistics are
+ * restored. Scopes may nest. If `statistics` is `nullptr`, nothing is counted.
+ */
+class IoStatisticsScope
+{
+  public:
+    IoStatisticsScope(std::shared_ptr<IoStatisticsImpl> statistics, const char* name);
+    ~IoStatisticsScope();
+
+    IoStatisticsScope(const IoStatisticsScope&) = delete;
+    IoStatisticsScope& operator=(const IoStatisticsScope&) = delete;
+
+  private:
+    std::shared_ptr<IoStatisticsImpl> statistics_;
+    IoStatisticsImpl* previous_;
+    const char* name_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/// Approximate bytes of memory used by `values`.
+template <class T>
+size_t _byteSize(const std::vector<T>& values) {
+    return values.size() * sizeof(T);
+}
+
+inline size_t _byteSize(const std::vector<std::string>& values) {
+    size_t size = values.size() * sizeof(std::string);
+    for (const auto& value : values) {
+        size += value.capacity();
+    }
+    return size;
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
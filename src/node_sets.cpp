@@ -10,6 +10,7 @@
 #include <nlohmann/json.hpp>
 #include <utility>
 
+#include "tracing.hpp"
 #include "utils.h"  // readFile
 
 #include <bbp/sonata/node_sets.h>
@@ -23,6 +24,8 @@ namespace detail {
 
 const size_t MAX_COMPOUND_RECURSION = 10;
 
+const char* const EXCLUDE_KEY = "$not";
+
 using json = nlohmann::json;
 
 void replace_trailing_coma(std::string& s, char c) {
@@ -40,6 +43,9 @@ std::string toString(const std::string& key, const std::vector<T>& values) {
 
 template <>
 std::string toString(const std::string& key, const std::vector<std::string>& values) {
+    if (values.empty()) {
+        return fmt::format(R"("{}": [])", key);
+    }
     // strings need to be wrapped in quotes
     return fmt::format(R"("{}": ["{}"])", key, fmt::join(values, "\", \""));
 }
@@ -232,7 +238,7 @@ class NodeSetBasicNodeIds: public NodeSetRule
 
     Selection materialize(const detail::NodeSets& /* unused */,
                           const NodePopulation& np) const final {
-        return np.selectAll() & Selection::fromValues(values_.begin(), values_.end());
+        return np.selectAll() & Selection::fromValues(values_);
     }
 
     std::string toJSON() const final {
@@ -259,11 +265,12 @@ class NodeSetBasicMultiClause: public NodeSetRule
         : clauses_(std::move(clauses)) { }
 
     Selection materialize(const detail::NodeSets& ns, const NodePopulation& np) const final {
-        Selection ret = np.selectAll();
+        std::vector<Selection> selections{np.selectAll()};
+        selections.reserve(clauses_.size() + 1);
         for (const auto& clause : clauses_) {
-            ret = ret & clause->materialize(ns, np);
+            selections.push_back(clause->materialize(ns, np));
         }
-        return ret;
+        return Selection::intersectAll(selections);
     }
 
     std::string toJSON() const final {
@@ -435,11 +442,12 @@ class NodeSetCompoundRule: public NodeSetRule
         , targets_(std::move(targets)) { }
 
     Selection materialize(const detail::NodeSets& ns, const NodePopulation& np) const final {
-        Selection ret{{}};
+        std::vector<Selection> selections;
+        selections.reserve(targets_.size());
         for (const auto& target : targets_) {
-            ret = ret | ns.materialize(target, np);
+            selections.push_back(ns.materialize(target, np));
         }
-        return ret;
+        return Selection::unionAll(selections);
     }
 
     std::string toJSON() const final {
@@ -462,6 +470,40 @@ class NodeSetCompoundRule: public NodeSetRule
     CompoundTargets targets_;
 };
 
+// `{"$not": [targets...]}`: all the nodes of the population not in any of the targets
+class NodeSetExcludeRule: public NodeSetRule
+{
+  public:
+    NodeSetExcludeRule(std::string name, CompoundTargets targets)
+        : name_(std::move(name))
+        , targets_(std::move(targets)) { }
+
+    Selection materialize(const detail::NodeSets& ns, const NodePopulation& np) const final {
+        std::vector<Selection> excluded;
+        excluded.reserve(targets_.size());
+        for (const auto& target : targets_) {
+            excluded.push_back(ns.materialize(target, np));
+        }
+        return np.selectAll() - Selection::unionAll(excluded);
+    }
+
+    std::string toJSON() const final {
+        return toString(EXCLUDE_KEY, targets_);
+    }
+
+    std::unique_ptr<NodeSetRule> clone() const final {
+        return std::make_unique<detail::NodeSetExcludeRule>(name_, targets_);
+    }
+
+  private:
+    std::string name_;
+    CompoundTargets targets_;
+};
+
+bool is_exclude(const json& value) {
+    return value.is_object() && value.count(EXCLUDE_KEY) > 0;
+}
+
 NodeSetRulePtr _dispatch_node(const std::string& attribute, const json& value) {
     if (value.is_number()) {
         if (attribute == "population") {
@@ -565,7 +607,9 @@ NodeSetRulePtr _dispatch_node(const std::string& attribute, const json& value) {
 void parse_basic(const json& j, std::map<std::string, NodeSetRulePtr>& node_sets) {
     for (const auto& el : j.items()) {
         const auto& value = el.value();
-        if (value.is_object()) {
+        if (is_exclude(value)) {
+            // will be parsed by the parse_compound
+        } else if (value.is_object()) {
             if (value.empty()) {
                 // ignore
             } else if (value.size() == 1) {
@@ -612,25 +656,56 @@ void check_compound(const std::map<std::string, NodeSetRulePtr>& node_sets,
 
 void parse_compound(const json& j, std::map<std::string, NodeSetRulePtr>& node_sets) {
     std::map<std::string, CompoundTargets> compound_rules;
+    std::set<std::string> exclude_rules;
     for (auto& el : j.items()) {
+        const json* array = nullptr;
         if (el.value().is_array()) {
-            CompoundTargets targets;
-            for (const auto& name : el.value()) {
-                if (!name.is_string()) {
-                    throw SonataError("All compound elements must be strings");
-                }
+            array = &el.value();
+        } else if (is_exclude(el.value())) {
+            const auto& value = el.value();
+            if (value.size() != 1) {
+                throw SonataError(fmt::format("'{}' must be the only key of node_set '{}'",
+                                              EXCLUDE_KEY,
+                                              el.key()));
+            }
 
-                targets.emplace_back(name);
+            array = &value[EXCLUDE_KEY];
+            if (array->is_string()) {
+                compound_rules[el.key()] = CompoundTargets{array->get<std::string>()};
+                exclude_rules.insert(el.key());
+                continue;
+            }
+            if (!array->is_array()) {
+                throw SonataError(
+                    fmt::format("'{}' must be a node_set name or a list of node_set names",
+                                EXCLUDE_KEY));
             }
-            compound_rules[el.key()] = targets;
+            exclude_rules.insert(el.key());
+        } else {
+            continue;
         }
+
+        CompoundTargets targets;
+        for (const auto& name : *array) {
+            if (!name.is_string()) {
+                throw SonataError("All compound elements must be strings");
+            }
+
+            targets.emplace_back(name);
+        }
+        compound_rules[el.key()] = targets;
     }
 
 
     for (const auto& rule : compound_rules) {
         check_compound(node_sets, compound_rules, rule.first, 0);
 
-        NodeSetRulePtr rules = std::make_unique<NodeSetCompoundRule>(rule.first, rule.second);
+        NodeSetRulePtr rules;
+        if (exclude_rules.count(rule.first) > 0) {
+            rules = std::make_unique<NodeSetExcludeRule>(rule.first, rule.second);
+        } else {
+            rules = std::make_unique<NodeSetCompoundRule>(rule.first, rule.second);
+        }
         node_sets.emplace(rule.first, std::move(rules));
     }
 }
@@ -642,6 +717,7 @@ Selection NodeSets::materialize(const std::string& name, const NodePopulation& p
     }
     const auto& ns = node_set->second;
     if (!ns->is_compound()) {
+        TraceScope trace("NodeSets::materialize", name);
         return population.selectAll() & ns->materialize(*this, population);
     }
 
@@ -649,7 +725,7 @@ Selection NodeSets::materialize(const std::string& name, const NodePopulation& p
     // (ie: a whole hierarchy of regions), all checking the same attribute
     // rather than `materializing` them separately, we group them, and materialize
     // them all at once
-    Selection ret{{}};
+    std::vector<Selection> selections;
 
     std::vector<NodeSetRule*> queue{ns.get()};
     std::map<std::string, std::set<std::string>> attribute2rule_strings;
@@ -685,24 +761,29 @@ Selection NodeSets::materialize(const std::string& name, const NodePopulation& p
                     }
                 }
 
-                ret = ret | ns->materialize(*this, population);
+                TraceScope trace("NodeSets::materialize", target);
+                selections.push_back(node_set->materialize(*this, population));
             }
         } else {
-            ret = ret | ns->materialize(*this, population);
+            TraceScope trace("NodeSets::materialize", name);
+            selections.push_back(ns->materialize(*this, population));
         }
     }
 
+    // The basic rules, grouped by attribute.
     for (const auto& it : attribute2rule_strings) {
+        TraceScope trace("NodeSets::materialize", it.first);
         std::vector<std::string> values(it.second.begin(), it.second.end());
-        ret = ret | population.matchAttributeValues(it.first, values);
+        selections.push_back(population.matchAttributeValues(it.first, values));
     }
 
     for (const auto& it : attribute2rule_int64) {
+        TraceScope trace("NodeSets::materialize", it.first);
         std::vector<int64_t> values(it.second.begin(), it.second.end());
-        ret = ret | population.matchAttributeValues(it.first, values);
+        selections.push_back(population.matchAttributeValues(it.first, values));
     }
 
-    return ret;
+    return Selection::unionAll(selections);
 }
 }  // namespace detail
 
@@ -80,7 +80,7 @@ std::string Population::name() const {
 
 uint64_t Population::size() const {
     HDF5_LOCK_GUARD
-    const auto dset = impl_->h5Root.getDataSet(fmt::format("{}_type_id", impl_->prefix));
+    const auto dset = impl_->root().getDataSet(fmt::format("{}_type_id", impl_->prefix));
     return dset.getSpace().getDimensions()[0];
 }
 
@@ -101,6 +101,7 @@ const std::set<std::string>& Population::enumerationNames() const {
 
 
 std::vector<std::string> Population::enumerationValues(const std::string& name) const {
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "enumerationValues");
     HDF5_LOCK_GUARD
     const auto dset = impl_->getLibraryDataSet(name);
 
@@ -112,19 +113,29 @@ std::vector<std::string> Population::enumerationValues(const std::string& name)
 
 template <typename T>
 std::vector<T> Population::getAttribute(const std::string& name, const Selection& selection) const {
+    detail::TraceScope trace("Population::getAttribute", name);
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "getAttribute");
     HDF5_LOCK_GUARD
-    return _readSelection<T>(impl_->getAttributeDataSet(name), selection, impl_->hdf5_reader);
+    auto values = _readSelection<T>(impl_->getAttributeDataSet(name),
+                                    selection,
+                                    impl_->hdf5_reader);
+    trace.setBytes(detail::_byteSize(values));
+    return values;
 }
 
 
 template <>
 std::vector<std::string> Population::getAttribute<std::string>(const std::string& name,
                                                                const Selection& selection) const {
+    detail::TraceScope trace("Population::getAttribute", name);
     if (impl_->attributeEnumNames.count(name) == 0) {
+        detail::IoStatisticsScope scope(impl_->ioStatistics(), "getAttribute");
         HDF5_LOCK_GUARD
-        return _readSelection<std::string>(impl_->getAttributeDataSet(name),
-                                           selection,
-                                           impl_->hdf5_reader);
+        auto values = _readSelection<std::string>(impl_->getAttributeDataSet(name),
+                                                  selection,
+                                                  impl_->hdf5_reader);
+        trace.setBytes(detail::_byteSize(values));
+        return values;
     }
 
     const auto indices = getAttribute<size_t>(name, selection);
@@ -141,6 +152,7 @@ std::vector<std::string> Population::getAttribute<std::string>(const std::string
         resolved.emplace_back(values[i]);
     }
 
+    trace.setBytes(detail::_byteSize(resolved));
     return resolved;
 }
 
@@ -164,6 +176,7 @@ std::vector<T> Population::getEnumeration(const std::string& name,
         throw SonataError(fmt::format("Enumeration attribute '{}' can only be integer", name));
     }
 
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "getEnumeration");
     HDF5_LOCK_GUARD
     return _readSelection<T>(impl_->getAttributeDataSet(name), selection, impl_->hdf5_reader);
 }
@@ -180,6 +193,26 @@ std::string Population::_attributeDataType(const std::string& name,
 }
 
 
+bool Population::fileHandlePerThread() const {
+    return impl_->fileHandlePerThread;
+}
+
+
+void Population::setFileHandlePerThread(bool enable) {
+    impl_->fileHandlePerThread = enable;
+}
+
+
+void Population::setIoStatistics(const IoStatistics& statistics) {
+    std::atomic_store(&impl_->ioStatisticsImpl, statistics.impl);
+}
+
+
+void Population::clearIoStatistics() {
+    std::atomic_store(&impl_->ioStatisticsImpl, std::shared_ptr<detail::IoStatisticsImpl>());
+}
+
+
 const std::set<std::string>& Population::dynamicsAttributeNames() const {
     return impl_->dynamicsAttributeNames;
 }
@@ -188,6 +221,7 @@ const std::set<std::string>& Population::dynamicsAttributeNames() const {
 template <typename T>
 std::vector<T> Population::getDynamicsAttribute(const std::string& name,
                                                 const Selection& selection) const {
+    detail::IoStatisticsScope scope(impl_->ioStatistics(), "getDynamicsAttribute");
     HDF5_LOCK_GUARD
     return _readSelection<T>(impl_->getDynamicsAttributeDataSet(name),
                              selection,
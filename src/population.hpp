@@ -13,13 +13,21 @@
 
 #include <bbp/sonata/population.h>
 
-#include <algorithm>  // stable_sort, transform
-#include <iterator>   // back_inserter
-#include <numeric>    // iota
+#include <algorithm>  // upper_bound
+#include <atomic>
+#include <functional>
+#include <iterator>  // distance
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>  // std::pair
 #include <vector>
 
 #include <fmt/format.h>
 
+#include "io_statistics.hpp"
+#include "tracing.hpp"
 #include "read_bulk.hpp"
 #include <highfive/H5File.hpp>
 
@@ -66,37 +74,56 @@ std::vector<T> _readSelection(const HighFive::DataSet& dset,
         return {};
     }
 
+    detail::TraceScope trace("_readSelection");
+    auto* statistics = detail::currentIoStatistics();
     if (bulk_read::detail::isCanonical(selection)) {
-        return hdf5_reader.readSelection<T>(dset, selection);
+        auto result = hdf5_reader.readSelection<T>(dset, selection);
+        if (statistics != nullptr) {
+            statistics->recordRead(detail::_byteSize(result));
+        }
+        trace.setBytes(detail::_byteSize(result));
+        return result;
     }
 
     // The fully general case:
     //
-    // 1. Create a canonical selection and read into `linear_result`.
-    // 2. Copy values from the canonical `linear_results` to their final
-    //    destination.
-    auto canonicalRanges = bulk_read::sortAndMerge(selection, 0);
-    auto linear_result = hdf5_reader.readSelection<T>(dset, canonicalRanges);
-
-    const auto ids = selection.flatten();
-
-    std::vector<std::size_t> ids_index(ids.size());
-    std::iota(ids_index.begin(), ids_index.end(), std::size_t(0));
-    std::stable_sort(ids_index.begin(), ids_index.end(), [&ids](size_t i0, size_t i1) {
-        return ids[i0] < ids[i1];
-    });
+    // 1. Read the canonical ranges into `linear_result`.
+    // 2. Every range of `selection` lies within one canonical range, copy it
+    //    from `linear_result` to its final destination.
+    const auto& canonical = selection.canonicalRanges();
+    const auto linear_result = hdf5_reader.readSelection<T>(dset, Selection(canonical));
+
+    // Offset of each canonical range in `linear_result`.
+    std::vector<size_t> offsets(canonical.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < canonical.size(); ++i) {
+        offsets[i] = offset;
+        offset += std::get<1>(canonical[i]) - std::get<0>(canonical[i]);
+    }
 
-    std::vector<T> result(ids.size());
-    size_t linear_index = 0;
-    result[ids_index[0]] = linear_result[0];
-    for (size_t i = 1; i < ids.size(); ++i) {
-        if (ids[ids_index[i - 1]] != ids[ids_index[i]]) {
-            linear_index += 1;
-        }
+    std::vector<T> result;
+    result.reserve(selection.flatSize());
+    selection.forEachRange([&](const Selection::Range& range) {
+        const auto it = std::upper_bound(canonical.begin(),
+                                         canonical.end(),
+                                         std::get<0>(range),
+                                         [](Selection::Value v, const Selection::Range& r) {
+                                             return v < std::get<0>(r);
+                                         }) -
+                        1;
+        const auto i = static_cast<size_t>(std::distance(canonical.begin(), it));
+        const auto begin = linear_result.begin() +
+                           static_cast<std::ptrdiff_t>(offsets[i] + std::get<0>(range) -
+                                                       std::get<0>(*it));
+        result.insert(result.end(),
+                      begin,
+                      begin + static_cast<std::ptrdiff_t>(std::get<1>(range) - std::get<0>(range)));
+    });
 
-        result[ids_index[i]] = linear_result[linear_index];
+    if (statistics != nullptr) {
+        statistics->recordRead(detail::_byteSize(result));
     }
-
+    trace.setBytes(detail::_byteSize(result));
     return result;
 }
 
@@ -107,6 +134,103 @@ inline HighFive::File open_hdf5_file(const std::string& filename, const Hdf5Read
     return hdf5_reader.openFile(filename);
 }
 
+namespace detail {
+
+/**
+ * A group opened in a separate file handle for every thread that reads it.
+ *
+ * The handle of a thread is closed when the thread exits, or when the
+ * `ThreadHandles` are destroyed; whichever comes first. Hence, neither exited
+ * threads nor a new thread that gets the id of an exited one keep a handle.
+ */
+class ThreadHandles: public std::enable_shared_from_this<ThreadHandles>
+{
+  public:
+    using Handle = std::pair<HighFive::File, HighFive::Group>;
+
+    explicit ThreadHandles(std::function<Handle()> open)
+        : open_(std::move(open)) { }
+
+    /** The group, opened in the file handle of the calling thread.
+     *
+     * Must be called with the HDF5 lock held.
+     */
+    HighFive::Group get() {
+        const auto id = std::this_thread::get_id();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto it = handles_.find(id);
+            if (it != handles_.end()) {
+                return it->second.second;
+            }
+        }
+
+        auto handle = open_();
+        auto group = handle.second;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            handles_.emplace(id, std::move(handle));
+        }
+        threadExit().watch(shared_from_this());
+        return group;
+    }
+
+  private:
+    /** Closes the handles of its thread, when the thread exits. */
+    class ThreadExit
+    {
+      public:
+        void watch(std::weak_ptr<ThreadHandles> handles) {
+            watched_.erase(std::remove_if(watched_.begin(),
+                                          watched_.end(),
+                                          [](const std::weak_ptr<ThreadHandles>& h) {
+                                              return h.expired();
+                                          }),
+                           watched_.end());
+            watched_.push_back(std::move(handles));
+        }
+
+        ~ThreadExit() {
+            HDF5_LOCK_GUARD
+            const auto id = std::this_thread::get_id();
+            for (const auto& watched : watched_) {
+                if (auto handles = watched.lock()) {
+                    handles->release(id);
+                }
+            }
+        }
+
+      private:
+        std::vector<std::weak_ptr<ThreadHandles>> watched_;
+    };
+
+    static ThreadExit& threadExit() {
+        thread_local ThreadExit thread_exit;
+        return thread_exit;
+    }
+
+    /** Must be called with the HDF5 lock held. */
+    void release(std::thread::id id) {
+        Handle handle;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto it = handles_.find(id);
+            if (it == handles_.end()) {
+                return;
+            }
+            handle = std::move(it->second);
+            handles_.erase(it);
+        }
+        // `handle` is closed here, without holding `mutex_`.
+    }
+
+    const std::function<Handle()> open_;
+    std::mutex mutex_;
+    std::map<std::thread::id, Handle> handles_;
+};
+
+}  // namespace detail
+
 struct Population::Impl {
     Impl(const std::string& h5FilePath,
          const std::string&,
@@ -117,6 +241,11 @@ struct Population::Impl {
         , prefix(_prefix)
         , h5File(open_hdf5_file(h5FilePath, hdf5_reader))
         , h5Root(h5File.getGroup(fmt::format("/{}s", prefix)).getGroup(name))
+        , threadHandles(std::make_shared<detail::ThreadHandles>([h5FilePath, hdf5_reader, _prefix, _name]() {
+            auto file = open_hdf5_file(h5FilePath, hdf5_reader);
+            auto group = file.getGroup(fmt::format("/{}s", _prefix)).getGroup(_name);
+            return detail::ThreadHandles::Handle(std::move(file), std::move(group));
+        }))
         , attributeNames(_listChildren(h5Root.getGroup("0"), {H5_DYNAMICS_PARAMS, H5_LIBRARY}))
         , attributeEnumNames(
               h5Root.getGroup("0").exist(H5_LIBRARY)
@@ -133,35 +262,54 @@ struct Population::Impl {
         }
     }
 
+    /// The population group, opened in the file handle of the calling thread if
+    /// `fileHandlePerThread`.
+    ///
+    /// Must be called with the HDF5 lock held.
+    HighFive::Group root() const {
+        return fileHandlePerThread ? threadHandles->get() : h5Root;
+    }
+
+    /// The statistics that reads are counted in, or `nullptr`.
+    std::shared_ptr<detail::IoStatisticsImpl> ioStatistics() const {
+        return std::atomic_load(&ioStatisticsImpl);
+    }
+
     HighFive::DataSet getAttributeDataSet(const std::string& name) const {
         if (!attributeNames.count(name)) {
             throw SonataError(fmt::format("No such attribute: '{}'", name));
         }
-        return h5Root.getGroup("0").getDataSet(name);
+        return root().getGroup("0").getDataSet(name);
     }
 
     HighFive::DataSet getLibraryDataSet(const std::string& name) const {
         if (!attributeEnumNames.count(name)) {
             throw SonataError(fmt::format("No such enumeration attribute: '{}'", name));
         }
-        return h5Root.getGroup("0").getGroup(H5_LIBRARY).getDataSet(name);
+        return root().getGroup("0").getGroup(H5_LIBRARY).getDataSet(name);
     }
 
     HighFive::DataSet getDynamicsAttributeDataSet(const std::string& name) const {
         if (!dynamicsAttributeNames.count(name)) {
             throw SonataError(fmt::format("No such dynamics attribute: '{}'", name));
         }
-        return h5Root.getGroup("0").getGroup(H5_DYNAMICS_PARAMS).getDataSet(name);
+        return root().getGroup("0").getGroup(H5_DYNAMICS_PARAMS).getDataSet(name);
     }
 
     const std::string name;
     const std::string prefix;
     const HighFive::File h5File;
     const HighFive::Group h5Root;
+    const std::shared_ptr<detail::ThreadHandles> threadHandles;
     const std::set<std::string> attributeNames;
     const std::set<std::string> attributeEnumNames;
     const std::set<std::string> dynamicsAttributeNames;
     const Hdf5Reader hdf5_reader;
+
+    std::atomic<bool> fileHandlePerThread{false};
+
+    /// Accessed with `std::atomic_load` and `std::atomic_store`.
+    std::shared_ptr<detail::IoStatisticsImpl> ioStatisticsImpl;
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -2,11 +2,13 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <future>
+#include <limits>
 #include <fmt/format.h>
 
 #include <bbp/sonata/population.h>
 
-#define SONATA_PAGESIZE (4 * 1 << 20)
+#include "thread_pool.h"
 
 namespace bbp {
 namespace sonata {
@@ -50,6 +52,43 @@ void erase_if(std::vector<T>& v, Pred pred) {
 }
 }  // namespace detail
 
+/** Limits on merging ranges into blocks, in number of elements.
+ *
+ *  @sa `sortAndMerge`.
+ */
+struct MergeLimits {
+    size_t min_gap_size = 1;
+    size_t max_aggregated_block_size = size_t(-1);
+    size_t max_buffer_size = size_t(-1);
+    double max_over_read_ratio = std::numeric_limits<double>::infinity();
+    size_t chunk_size = 0;
+
+    /// The limits of `read_policy`, for elements of `element_size` bytes.
+    static MergeLimits fromPolicy(const ReadPolicy& read_policy,
+                                  size_t element_size,
+                                  size_t chunk_size = 0) {
+        MergeLimits limits;
+        limits.min_gap_size = read_policy.min_gap_bytes / element_size;
+        limits.max_aggregated_block_size = std::max<size_t>(1,
+                                                            read_policy.max_block_bytes /
+                                                                element_size);
+        limits.max_buffer_size = std::max<size_t>(1, read_policy.max_buffer_bytes / element_size);
+        limits.max_over_read_ratio = read_policy.max_over_read_ratio;
+        limits.chunk_size = chunk_size;
+        return limits;
+    }
+
+    /// The limits of `read_policy` for two-dimensional reads, i.e. with blocks
+    /// of at most `max_block_bytes_2d`.
+    static MergeLimits fromPolicy2D(const ReadPolicy& read_policy,
+                                    size_t element_size,
+                                    size_t chunk_size = 0) {
+        ReadPolicy policy_2d = read_policy;
+        policy_2d.max_block_bytes = read_policy.max_block_bytes_2d;
+        return fromPolicy(policy_2d, element_size, chunk_size);
+    }
+};
+
 /** Sort the selection and merge small gaps.
  *
  * The ranges of the selection are sorted and then ranges that are separated by
@@ -60,16 +99,24 @@ void erase_if(std::vector<T>& v, Pred pred) {
  * Reading only a few elements from each page could lead to reading very large
  * ranges into memory. To avoid this issue the one must pick a maximum
  * aggregated block size. Consecutive blocks wont be merged if the current
- * block exceeds the threshold `max_aggregated_block_size`.
+ * block exceeds the threshold `max_aggregated_block_size`. Additionally, a gap
+ * isn't merged if the block would then be larger than `max_buffer_size`, or
+ * more than `max_over_read_ratio` times the number of selected elements in it.
+ *
+ * For chunked datasets that must be decompressed, pass the number of elements
+ * per chunk as `chunk_size`. Then ranges that touch the same chunk are always
+ * merged, even past the other limits, such that every chunk is part of at
+ * most one block; hence, it's decompressed at most once. Blocks aren't
+ * aligned to chunks: they start and end with the selected ranges, and may
+ * cover only part of their first and last chunk. A `chunk_size` of `0` means
+ * the dataset isn't chunked.
  *
  * Note, that the returned selection is canonical (sorted and non-overlapping)
  * and may have a larger `flatSize` than `ranges`. Additionally any empty
  * ranges are removed.
  */
 template <class Range>
-std::vector<Range> sortAndMerge(const std::vector<Range>& ranges,
-                                size_t min_gap_size = 1,
-                                size_t max_aggregated_block_size = size_t(-1)) {
+std::vector<Range> sortAndMerge(const std::vector<Range>& ranges, const MergeLimits& limits) {
     if (ranges.empty()) {
         return std::vector<Range>{};
     }
@@ -87,18 +134,42 @@ std::vector<Range> sortAndMerge(const std::vector<Range>& ranges,
 
     auto it = sorted.cbegin();
     ret.push_back(*(it++));
+    // Number of selected elements in the current range.
+    size_t selected_size = std::get<1>(ret.back()) - std::get<0>(ret.back());
 
     for (; it != sorted.cend(); ++it) {
         auto& current_range = ret.back();
         auto& last = std::get<1>(current_range);
+        const size_t begin = std::get<0>(*it);
+        const size_t end = std::get<1>(*it);
 
         size_t current_range_size = last - std::get<0>(current_range);
-        if (last + min_gap_size <= std::get<0>(*it) ||
-            current_range_size >= max_aggregated_block_size) {
-            // Start a new range.
+        bool same_chunk = limits.chunk_size != 0 &&
+                          (last - 1) / limits.chunk_size == begin / limits.chunk_size;
+
+        bool start_new_range = false;
+        if (same_chunk) {
+            start_new_range = false;
+        } else if (last + limits.min_gap_size <= begin ||
+                   current_range_size >= limits.max_aggregated_block_size) {
+            start_new_range = true;
+        } else if (last < begin) {
+            // Merging would read the gap.
+            size_t merged_size = end - std::get<0>(current_range);
+            start_new_range = merged_size > limits.max_buffer_size ||
+                              static_cast<double>(merged_size) >
+                                  limits.max_over_read_ratio *
+                                      static_cast<double>(selected_size + end - begin);
+        }
+
+        if (start_new_range) {
             ret.push_back(*it);
+            selected_size = end - begin;
         } else {
             // Extend the current range.
+            if (end > last) {
+                selected_size += end - std::max<size_t>(last, begin);
+            }
             last = std::max(last, std::get<1>(*it));
         }
     }
@@ -106,6 +177,18 @@ std::vector<Range> sortAndMerge(const std::vector<Range>& ranges,
     return ret;
 }
 
+template <class Range>
+std::vector<Range> sortAndMerge(const std::vector<Range>& ranges,
+                                size_t min_gap_size = 1,
+                                size_t max_aggregated_block_size = size_t(-1),
+                                size_t chunk_size = 0) {
+    MergeLimits limits;
+    limits.min_gap_size = min_gap_size;
+    limits.max_aggregated_block_size = max_aggregated_block_size;
+    limits.chunk_size = chunk_size;
+    return sortAndMerge(ranges, limits);
+}
+
 inline Selection sortAndMerge(const Selection& selection, size_t min_gap_size = 0) {
     return Selection(sortAndMerge(selection.ranges(), min_gap_size));
 }
@@ -186,6 +269,213 @@ std::vector<T> bulkRead(F readBlock,
     return values;
 }
 
+/** Where `bulkRead` reads blocks ahead.
+ *
+ *  By default, i.e. without an `io_thread`, blocks are read on the calling
+ *  thread, one after the other.
+ */
+struct Prefetch {
+    /// The thread that reads blocks; it should have a single worker.
+    ::bbp::sonata::detail::ThreadPool* io_thread = nullptr;
+    /// Number of blocks read ahead of the block being extracted.
+    size_t depth = 1;
+};
+
+/** Read `n_blocks` blocks one after the other, and extract each of them.
+ *
+ *  Block `k` is read by calling `read(buffer, k)` and then extracted by
+ *  calling `extract(buffer, k)`, in order of `k`.
+ *
+ *  With `prefetch.io_thread`, block `k + prefetch.depth` is read while block
+ *  `k` is extracted, using `prefetch.depth + 1` buffers. Hence, the latency of
+ *  reading is hidden behind extracting and the previous reads. `read` is then
+ *  called on the I/O thread. It may call HDF5, since the calling thread
+ *  doesn't until all blocks are read.
+ */
+template <class Buffer, class Read, class Extract>
+void readBlocks(size_t n_blocks, Read read, Extract extract, const Prefetch& prefetch) {
+    if (prefetch.io_thread == nullptr) {
+        Buffer buffer;
+        for (size_t k = 0; k < n_blocks; ++k) {
+            read(buffer, k);
+            extract(buffer, k);
+        }
+        return;
+    }
+
+    const size_t depth = std::max<size_t>(1, prefetch.depth);
+    std::vector<Buffer> buffers(std::min(depth + 1, n_blocks));
+    std::vector<std::future<void>> futures(n_blocks);
+
+    // Block `k` goes to buffer `k % buffers.size()`, after block `k - depth - 1`
+    // has been extracted.
+    auto submit = [&](size_t k) {
+        futures[k] = prefetch.io_thread->submit(
+            [&read, &buffers, k]() { read(buffers[k % buffers.size()], k); });
+    };
+
+    size_t n_submitted = 0;
+    try {
+        for (; n_submitted < std::min(depth, n_blocks); ++n_submitted) {
+            submit(n_submitted);
+        }
+
+        for (size_t k = 0; k < n_blocks; ++k) {
+            if (n_submitted < n_blocks) {
+                submit(n_submitted++);
+            }
+            futures[k].get();
+            extract(buffers[k % buffers.size()], k);
+        }
+    } catch (...) {
+        // The reads still in flight refer to `buffers`.
+        for (size_t k = 0; k < n_submitted; ++k) {
+            if (futures[k].valid()) {
+                futures[k].wait();
+            }
+        }
+        throw;
+    }
+}
+
+/** Read larger blocks on `prefetch.io_thread`, while extracting values.
+ *
+ *  Like `bulkRead`, but the blocks are read ahead as described in `readBlocks`.
+ */
+template <class T, class F, class Range>
+std::vector<T> bulkRead(F readBlock,
+                        const std::vector<Range>& ranges,
+                        const std::vector<Range>& subranges,
+                        const Prefetch& prefetch) {
+    if (prefetch.io_thread == nullptr) {
+        return bulkRead<T>(readBlock, ranges, subranges);
+    }
+
+    std::vector<T> values(detail::flatSize(subranges));
+    T* values_ptr = values.data();
+
+    size_t k_sub = 0;
+    const size_t n_sub = subranges.size();
+    readBlocks<std::vector<T>>(
+        ranges.size(),
+        [&readBlock, &ranges](std::vector<T>& buffer, size_t k) { readBlock(buffer, ranges[k]); },
+        [&](const std::vector<T>& buffer, size_t k) {
+            const auto& range = ranges[k];
+            for (; k_sub < n_sub; ++k_sub) {
+                const auto& subrange = subranges[k_sub];
+                if (std::get<1>(subrange) > std::get<1>(range)) {
+                    break;
+                }
+
+                extractBlock(values_ptr, buffer.data(), range, subrange);
+                values_ptr += std::get<1>(subrange) - std::get<0>(subrange);
+            }
+        },
+        prefetch);
+
+    return values;
+}
+
+namespace detail {
+
+/** The index of the first range of `subranges` in each range of `ranges`.
+ *
+ * The subranges of `ranges[k]` are `subranges[first[k]]` up to, but excluding,
+ * `subranges[first[k + 1]]`.
+ */
+template <class Range>
+std::vector<size_t> firstSubranges(const std::vector<Range>& ranges,
+                                   const std::vector<Range>& subranges) {
+    std::vector<size_t> first(ranges.size() + 1);
+    size_t k_sub = 0;
+    for (size_t k = 0; k < ranges.size(); ++k) {
+        first[k] = k_sub;
+        while (k_sub < subranges.size() &&
+               std::get<1>(subranges[k_sub]) <= std::get<1>(ranges[k])) {
+            ++k_sub;
+        }
+    }
+    first[ranges.size()] = k_sub;
+
+    return first;
+}
+
+/// Where each range starts, if the ranges are put back to back.
+template <class Range>
+std::vector<size_t> flatOffsets(const std::vector<Range>& ranges) {
+    std::vector<size_t> offsets(ranges.size());
+    size_t offset = 0;
+    for (size_t k = 0; k < ranges.size(); ++k) {
+        offsets[k] = offset;
+        offset += std::get<1>(ranges[k]) - std::get<0>(ranges[k]);
+    }
+
+    return offsets;
+}
+
+}  // namespace detail
+
+/** Read the Cartesian product of two selections using merge-read-extract.
+ *
+ *  This is `bulkRead` for two-dimensional arrays. Each block is the product of
+ *  one range of `xranges` (rows) and one range of `yranges` (columns). Blocks
+ *  are read one row of blocks after the other, by calling
+ *
+ *      readBlock(buffer, xrange, yrange);
+ *
+ *  the function object `readBlock` must fill `buffer` (an `std::vector<T>`)
+ *  with the values of the block, in row-major order. The values of the product
+ *  of `xsubranges` and `ysubranges` are copied to `out`, in row-major order;
+ *  it must have room for all of them.
+ *
+ *  For each dimension, the same requirements as for `bulkRead` apply.
+ */
+template <class T, class F, class Range>
+void bulkRead2D(F readBlock,
+                const std::vector<Range>& xranges,
+                const std::vector<Range>& xsubranges,
+                const std::vector<Range>& yranges,
+                const std::vector<Range>& ysubranges,
+                T* const out,
+                const Prefetch& prefetch = Prefetch()) {
+    const size_t n_columns = detail::flatSize(ysubranges);
+    const auto x_first = detail::firstSubranges(xranges, xsubranges);
+    const auto y_first = detail::firstSubranges(yranges, ysubranges);
+    const auto x_offsets = detail::flatOffsets(xsubranges);
+    const auto y_offsets = detail::flatOffsets(ysubranges);
+
+    const size_t n_yblocks = yranges.size();
+    readBlocks<std::vector<T>>(
+        xranges.size() * n_yblocks,
+        [&](std::vector<T>& buffer, size_t k) {
+            readBlock(buffer, xranges[k / n_yblocks], yranges[k % n_yblocks]);
+        },
+        [&](const std::vector<T>& buffer, size_t k) {
+            const size_t kx = k / n_yblocks;
+            const size_t ky = k % n_yblocks;
+            const size_t i_block = std::get<0>(xranges[kx]);
+            const size_t j_block = std::get<0>(yranges[ky]);
+            const size_t block_columns = std::get<1>(yranges[ky]) - j_block;
+
+            for (size_t s = x_first[kx]; s < x_first[kx + 1]; ++s) {
+                const size_t i_begin = std::get<0>(xsubranges[s]);
+                const size_t i_end = std::get<1>(xsubranges[s]);
+                for (size_t i = i_begin; i < i_end; ++i) {
+                    const T* buffer_row = buffer.data() + (i - i_block) * block_columns;
+                    T* out_row = out + (x_offsets[s] + i - i_begin) * n_columns;
+                    for (size_t t = y_first[ky]; t < y_first[ky + 1]; ++t) {
+                        const size_t j_begin = std::get<0>(ysubranges[t]);
+                        const size_t j_end = std::get<1>(ysubranges[t]);
+                        std::copy(buffer_row + (j_begin - j_block),
+                                  buffer_row + (j_end - j_block),
+                                  out_row + y_offsets[t]);
+                    }
+                }
+            }
+        },
+        prefetch);
+}
+
 /** Read `ranges` using merge-read-extract.
  *
  *  @sa `sortAndMerge` and `bulkRead`.
@@ -193,10 +483,10 @@ std::vector<T> bulkRead(F readBlock,
 template <class T, class F, class Ranges>
 std::vector<T> bulkRead(F readBlock,
                         const std::vector<Ranges>& ranges,
-                        size_t min_gap_size,
-                        size_t max_aggregated_block_size) {
-    auto super_ranges = sortAndMerge(ranges, min_gap_size, max_aggregated_block_size);
-    return bulkRead<T>(readBlock, super_ranges, ranges);
+                        const MergeLimits& limits,
+                        const Prefetch& prefetch = Prefetch()) {
+    auto super_ranges = sortAndMerge(ranges, limits);
+    return bulkRead<T>(readBlock, super_ranges, ranges, prefetch);
 }
 
 /** Read `ranges` using merge-read-extract.
@@ -204,11 +494,8 @@ std::vector<T> bulkRead(F readBlock,
  *  @sa `sortAndMerge` and `bulkRead`.
  */
 template <class T, class F>
-std::vector<T> bulkRead(F readBlock,
-                        const Selection& selection,
-                        size_t min_gap_size,
-                        size_t max_aggregated_block_size) {
-    return bulkRead<T>(readBlock, selection.ranges(), min_gap_size, max_aggregated_block_size);
+std::vector<T> bulkRead(F readBlock, const Selection& selection, const MergeLimits& limits) {
+    return bulkRead<T>(readBlock, selection.ranges(), limits);
 }
 
 }  // namespace bulk_read
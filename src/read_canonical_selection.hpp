@@ -1,63 +1,240 @@
 #pragma once
 
+#include <H5Dpublic.h>
+#include <H5Ppublic.h>
+#include <H5Spublic.h>  // H5S_MAX_RANK
 #include <highfive/H5File.hpp>
+#include <array>
+#include <type_traits>
 #include <vector>
 
+#include "io_statistics.hpp"
 #include "read_bulk.hpp"
 
 namespace bbp {
 namespace sonata {
 namespace detail {
 
+/** The HDF5 element type of `T`, and how many of them there are per row.
+ *
+ * Only arithmetic types, and arrays of them, can be copied from raw chunks or
+ * files as bytes.
+ */
 template <class T>
-std::vector<T> readCanonicalSelection(const HighFive::DataSet& dset, const Selection& selection) {
+struct _RawElementTraits {
+    using value_type = T;
+    static constexpr size_t width = 1;
+    static constexpr bool supported = std::is_arithmetic<T>::value;
+};
+
+template <class T, size_t N>
+struct _RawElementTraits<std::array<T, N>> {
+    using value_type = T;
+    static constexpr size_t width = N;
+    static constexpr bool supported = std::is_arithmetic<T>::value;
+};
+
+template <class Range>
+HighFive::HyperSlab _makeHyperslab(const std::vector<Range>& ranges) {
+    HighFive::HyperSlab slab;
+    for (const auto& range : ranges) {
+        size_t i_begin = std::get<0>(range);
+        size_t i_end = std::get<1>(range);
+        slab |= HighFive::RegularHyperSlab({i_begin}, {i_end - i_begin});
+    }
+
+    return slab;
+}
+
+template <class Range>
+HighFive::HyperSlab _makeHyperslab(const std::vector<Range>& xranges,
+                                   const std::vector<Range>& yranges) {
+    HighFive::HyperSlab slab;
+    for (const auto& xrange : xranges) {
+        size_t i_begin = std::get<0>(xrange);
+        size_t i_end = std::get<1>(xrange);
+        for (const auto& yrange : yranges) {
+            size_t j_begin = std::get<0>(yrange);
+            size_t j_end = std::get<1>(yrange);
+            slab |= HighFive::RegularHyperSlab({i_begin, j_begin},
+                                               {i_end - i_begin, j_end - j_begin});
+        }
+    }
+
+    return slab;
+}
+
+/** Number of `T` per row, if the columns `ysel` are read into `std::vector<T>`.
+ *
+ * Arithmetic types hold one column each, arrays hold `N` consecutive columns;
+ * hence, the number of selected columns must be a multiple of `N`.
+ */
+template <class T>
+size_t _rowWidth(const Selection& ysel) {
+    const size_t width = _RawElementTraits<T>::width;
+    const size_t n_columns = ysel.flatSize();
+    if (n_columns % width != 0) {
+        throw SonataError(
+            fmt::format("Can't read {} columns into elements of {} columns.", n_columns, width));
+    }
+
+    return n_columns / width;
+}
+
+/** Size of the chunks along `dim`, if `dset` is chunked and filtered; `0` otherwise.
+ *
+ * HDF5 decompresses filtered chunks as a whole, even if only a few of their
+ * elements are read. For contiguous or unfiltered chunked datasets, reads of
+ * parts of a chunk are cheap and only the page heuristic matters.
+ */
+inline size_t _compressedChunkSize(const HighFive::DataSet& dset, int dim = 0) {
+    const hid_t dcpl = H5Dget_create_plist(dset.getId());
+    if (dcpl < 0) {
+        return 0;
+    }
+
+    size_t chunk_size = 0;
+    if (H5Pget_layout(dcpl) == H5D_CHUNKED && H5Pget_nfilters(dcpl) > 0) {
+        std::array<hsize_t, H5S_MAX_RANK> chunk_dims{};
+        if (H5Pget_chunk(dcpl, H5S_MAX_RANK, chunk_dims.data()) > dim) {
+            chunk_size = chunk_dims[static_cast<size_t>(dim)];
+        }
+    }
+    H5Pclose(dcpl);
+
+    return chunk_size;
+}
+
+template <class T>
+std::vector<T> readCanonicalSelection(const HighFive::DataSet& dset,
+                                      const Selection& selection,
+                                      const ReadPolicy& read_policy = ReadPolicy(),
+                                      const bulk_read::Prefetch& prefetch = bulk_read::Prefetch()) {
     if (selection.empty()) {
         return {};
     }
 
-    constexpr size_t min_gap_size = SONATA_PAGESIZE / sizeof(T);
-    constexpr size_t max_aggregated_block_size = 1 * min_gap_size;
-
+    // Blocks may be read on the I/O thread, which doesn't count into any statistics.
+    auto* statistics = currentIoStatistics();
     auto readBlock = [&](auto& buffer, const auto& range) {
         size_t i_begin = std::get<0>(range);
         size_t i_end = std::get<1>(range);
         dset.select({i_begin}, {i_end - i_begin}).read(buffer);
+        if (statistics != nullptr) {
+            statistics->recordBlocks(1, _byteSize(buffer));
+        }
     };
 
     return bulk_read::bulkRead<T>([&readBlock](auto& buffer,
                                                const auto& range) { readBlock(buffer, range); },
                                   selection.ranges(),
-                                  min_gap_size,
-                                  max_aggregated_block_size);
+                                  bulk_read::MergeLimits::fromPolicy(read_policy,
+                                                                     sizeof(T),
+                                                                     _compressedChunkSize(dset)),
+                                  prefetch);
 }
 
+/** Read the Cartesian product of two canonical selections.
+ *
+ * The result is row-major; with `_rowWidth<T>(ysel)` elements per row. Rows
+ * and columns are both merged into blocks, according to `read_policy`. A gap
+ * between columns is read once per row; while a gap between rows is read for
+ * all columns of the block.
+ */
 template <class T>
 std::vector<T> readCanonicalSelection(const HighFive::DataSet& dset,
                                       const Selection& xsel,
-                                      const Selection& ysel) {
+                                      const Selection& ysel,
+                                      const ReadPolicy& read_policy = ReadPolicy(),
+                                      const bulk_read::Prefetch& prefetch = bulk_read::Prefetch()) {
+    using Value = typename _RawElementTraits<T>::value_type;
+
+    const size_t row_width = _rowWidth<T>(ysel);
+    if (xsel.empty() || row_width == 0) {
+        return {};
+    }
+
     const auto& xranges = xsel.ranges();
     const auto& yranges = ysel.ranges();
-    if (yranges.size() != 1) {
-        throw SonataError("Only yranges.size() == 1 has been implemented.");
+    const auto yblocks = bulk_read::sortAndMerge(
+        yranges,
+        bulk_read::MergeLimits::fromPolicy2D(read_policy,
+                                             sizeof(Value),
+                                             _compressedChunkSize(dset, 1)));
+    // Every block of rows is read across all columns of `yblocks`, gaps included.
+    const auto xblocks = bulk_read::sortAndMerge(
+        xranges,
+        bulk_read::MergeLimits::fromPolicy2D(read_policy,
+                                             sizeof(Value) * bulk_read::detail::flatSize(yblocks),
+                                             _compressedChunkSize(dset, 0)));
+
+    auto* statistics = currentIoStatistics();
+    auto readBlock = [&dset, statistics](std::vector<Value>& buffer,
+                                         const Selection::Range& xrange,
+                                         const Selection::Range& yrange) {
+        const size_t n_rows = xrange[1] - xrange[0];
+        const size_t n_columns = yrange[1] - yrange[0];
+        buffer.resize(n_rows * n_columns);
+        dset.select({xrange[0], yrange[0]}, {n_rows, n_columns}).read_raw(buffer.data());
+        if (statistics != nullptr) {
+            statistics->recordBlocks(1, _byteSize(buffer));
+        }
+    };
+
+    std::vector<T> result(xsel.flatSize() * row_width);
+    bulk_read::bulkRead2D(readBlock,
+                          xblocks,
+                          xranges,
+                          yblocks,
+                          yranges,
+                          reinterpret_cast<Value*>(result.data()),
+                          prefetch);
+    return result;
+}
+
+/** Read a canonical selection with a single H5Dread.
+ *
+ * The ranges are combined into one union hyperslab, which HDF5 reads straight
+ * into the result; since the selection is sorted, HDF5's order of the selected
+ * elements is the order of the result. Unlike `readCanonicalSelection`, no
+ * more than the selected elements are read, and there's no intermediate buffer.
+ */
+template <class T>
+std::vector<T> readCanonicalSelectionUnion(const HighFive::DataSet& dset,
+                                           const Selection& selection) {
+    if (selection.empty()) {
+        return {};
     }
 
-    size_t j_begin = std::get<0>(yranges[0]);
-    size_t j_end = std::get<1>(yranges[0]);
+    std::vector<T> result;
+    dset.select(_makeHyperslab(selection.ranges())).read(result);
+    if (auto* statistics = currentIoStatistics()) {
+        statistics->recordBlocks(1, _byteSize(result));
+    }
+    return result;
+}
 
-    constexpr size_t min_gap_size = SONATA_PAGESIZE / (2 * sizeof(uint64_t));
-    constexpr size_t max_aggregated_block_size = 128 * min_gap_size;
+template <class T>
+std::vector<T> readCanonicalSelectionUnion(const HighFive::DataSet& dset,
+                                           const Selection& xsel,
+                                           const Selection& ysel) {
+    using Value = typename _RawElementTraits<T>::value_type;
 
-    auto readBlock = [&](auto& buffer, const auto& xrange) {
-        size_t i_begin = std::get<0>(xrange);
-        size_t i_end = std::get<1>(xrange);
-        dset.select({i_begin, j_begin}, {i_end - i_begin, j_end - j_begin}).read(buffer);
-    };
+    const size_t row_width = _rowWidth<T>(ysel);
+    if (xsel.empty() || row_width == 0) {
+        return {};
+    }
 
-    return bulk_read::bulkRead<T>([&readBlock](auto& buffer,
-                                               const auto& range) { readBlock(buffer, range); },
-                                  xranges,
-                                  min_gap_size,
-                                  max_aggregated_block_size);
+    const size_t n_values = xsel.flatSize() * ysel.flatSize();
+    const HighFive::DataSpace memspace{n_values};
+
+    std::vector<T> result(xsel.flatSize() * row_width);
+    dset.select(_makeHyperslab(xsel.ranges(), ysel.ranges()), memspace)
+        .read_raw(reinterpret_cast<Value*>(result.data()));
+    if (auto* statistics = currentIoStatistics()) {
+        statistics->recordBlocks(1, _byteSize(result));
+    }
+    return result;
 }
 
 }  // namespace detail
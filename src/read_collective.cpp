@@ -0,0 +1,279 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "read_collective.hpp"
+
+#include <algorithm>
+#include <climits>  // INT_MAX
+#include <fmt/format.h>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+namespace {
+
+void _check(int status, const char* what) {
+    if (status != MPI_SUCCESS) {
+        throw SonataError(fmt::format("Collective read: {} failed with error {}", what, status));
+    }
+}
+
+int _toInt(size_t count) {
+    if (count > static_cast<size_t>(INT_MAX)) {
+        throw SonataError(fmt::format("Collective read: {} elements are too many for MPI", count));
+    }
+    return static_cast<int>(count);
+}
+
+std::vector<int> _displacements(const std::vector<int>& counts) {
+    std::vector<int> displacements(counts.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        displacements[i] = _toInt(offset);
+        offset += static_cast<size_t>(counts[i]);
+    }
+    return displacements;
+}
+
+/// The index of the range of `canonical` containing the row `row`.
+size_t _findRange(const Selection::Ranges& canonical, uint64_t row) {
+    const auto it = std::upper_bound(canonical.begin(),
+                                     canonical.end(),
+                                     row,
+                                     [](uint64_t r, const Selection::Range& range) {
+                                         return r < range[0];
+                                     });
+    return static_cast<size_t>(it - canonical.begin()) - 1;
+}
+
+/// The index of the aggregator that reads `plan.selected[i]`.
+size_t _findAggregator(const CollectivePlan& plan, size_t i) {
+    const auto it = std::upper_bound(plan.selected_begin.begin(), plan.selected_begin.end(), i);
+    return static_cast<size_t>(it - plan.selected_begin.begin()) - 1;
+}
+
+/// Index of `rank` among the aggregators, or `-1`.
+int _aggregatorIndex(const CollectiveComm& comm) {
+    const auto& aggregators = comm.aggregators();
+    const auto it = std::find(aggregators.begin(), aggregators.end(), comm.rank());
+    return it == aggregators.end() ? -1 : static_cast<int>(it - aggregators.begin());
+}
+
+}  // unnamed namespace
+
+
+CollectiveComm::CollectiveComm(MPI_Comm comm, int n_aggregators) {
+    _check(MPI_Comm_dup(comm, &comm_), "MPI_Comm_dup");
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &size_);
+
+    if (n_aggregators > 0) {
+        // Spread evenly over the ranks, which tend to be numbered node by node.
+        n_aggregators = std::min(n_aggregators, size_);
+        for (int i = 0; i < n_aggregators; ++i) {
+            aggregators_.push_back(static_cast<int>(static_cast<int64_t>(i) * size_ /
+                                                    n_aggregators));
+        }
+        return;
+    }
+
+    MPI_Comm node;
+    _check(MPI_Comm_split_type(comm_, MPI_COMM_TYPE_SHARED, rank_, MPI_INFO_NULL, &node),
+           "MPI_Comm_split_type");
+    int node_rank = 0;
+    MPI_Comm_rank(node, &node_rank);
+    MPI_Comm_free(&node);
+
+    const int is_aggregator = node_rank == 0 ? 1 : 0;
+    std::vector<int> flags(static_cast<size_t>(size_));
+    _check(MPI_Allgather(&is_aggregator, 1, MPI_INT, flags.data(), 1, MPI_INT, comm_),
+           "MPI_Allgather");
+    for (int i = 0; i < size_; ++i) {
+        if (flags[static_cast<size_t>(i)] != 0) {
+            aggregators_.push_back(i);
+        }
+    }
+}
+
+CollectiveComm::~CollectiveComm() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (!finalized) {
+        MPI_Comm_free(&comm_);
+    }
+}
+
+CollectivePlan _planCollectiveRead(const CollectiveComm& comm,
+                                   const Selection::Ranges& ranges,
+                                   const bulk_read::MergeLimits& limits) {
+    const auto n_ranks = static_cast<size_t>(comm.size());
+
+    // Ranges are sent as pairs of `uint64_t`.
+    const int count = _toInt(2 * ranges.size());
+    std::vector<int> counts(n_ranks);
+    _check(MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm.get()),
+           "MPI_Allgather");
+    const auto displacements = _displacements(counts);
+
+    const auto n_values = static_cast<size_t>(displacements.back()) +
+                          static_cast<size_t>(counts.back());
+    Selection::Ranges all_ranges(n_values / 2);
+    _check(MPI_Allgatherv(ranges.data(),
+                          count,
+                          MPI_UINT64_T,
+                          all_ranges.data(),
+                          counts.data(),
+                          displacements.data(),
+                          MPI_UINT64_T,
+                          comm.get()),
+           "MPI_Allgatherv");
+
+    CollectivePlan plan;
+    plan.ranges.resize(n_ranks);
+    for (size_t r = 0; r < n_ranks; ++r) {
+        const auto begin = all_ranges.begin() + displacements[r] / 2;
+        plan.ranges[r].assign(begin, begin + counts[r] / 2);
+    }
+
+    // Each range of a rank is within one range of the union, and one block.
+    plan.selected = bulk_read::sortAndMerge(all_ranges);
+    const auto blocks = bulk_read::sortAndMerge(plan.selected, limits);
+
+    // Split the blocks into runs of about the same number of rows.
+    const size_t n_aggregators = comm.aggregators().size();
+    const size_t n_rows = bulk_read::detail::flatSize(blocks);
+    plan.selected_begin.assign(n_aggregators + 1, plan.selected.size());
+    plan.selected_begin[0] = 0;
+    size_t rows = 0;
+    size_t a = 0;
+    for (const auto& block : blocks) {
+        for (const size_t owner = rows * n_aggregators / n_rows; a < owner;) {
+            plan.selected_begin[++a] = _findRange(plan.selected, block[0]);
+        }
+        rows += block[1] - block[0];
+    }
+
+    return plan;
+}
+
+Selection::Ranges _aggregatorRanges(const CollectiveComm& comm, const CollectivePlan& plan) {
+    const int a = _aggregatorIndex(comm);
+    if (a < 0) {
+        return {};
+    }
+
+    const auto first = plan.selected.begin();
+    return Selection::Ranges(first + static_cast<std::ptrdiff_t>(plan.selected_begin[a]),
+                             first + static_cast<std::ptrdiff_t>(plan.selected_begin[a + 1]));
+}
+
+void _scatterSelected(const CollectiveComm& comm,
+                      const CollectivePlan& plan,
+                      const char* values,
+                      size_t element_size,
+                      char* out) {
+    const auto n_ranks = static_cast<size_t>(comm.size());
+    const auto& aggregators = comm.aggregators();
+
+    // This rank receives its rows from the aggregators that read them.
+    std::vector<int> recv_counts(n_ranks, 0);
+    for (const auto& range : plan.ranges[static_cast<size_t>(comm.rank())]) {
+        const size_t a = _findAggregator(plan, _findRange(plan.selected, range[0]));
+        recv_counts[static_cast<size_t>(aggregators[a])] += _toInt(range[1] - range[0]);
+    }
+
+    // An aggregator sends each rank the rows it selected among those it read.
+    std::vector<int> send_counts(n_ranks, 0);
+    std::vector<char> send_buffer;
+    const int a = _aggregatorIndex(comm);
+    if (a >= 0) {
+        const size_t first = plan.selected_begin[static_cast<size_t>(a)];
+        const size_t last = plan.selected_begin[static_cast<size_t>(a) + 1];
+
+        // Offset of each range read by this aggregator in `values`, in rows.
+        std::vector<size_t> offsets(last - first);
+        size_t offset = 0;
+        for (size_t i = first; i < last; ++i) {
+            offsets[i - first] = offset;
+            offset += plan.selected[i][1] - plan.selected[i][0];
+        }
+
+        for (size_t r = 0; r < n_ranks; ++r) {
+            for (const auto& range : plan.ranges[r]) {
+                const size_t i = _findRange(plan.selected, range[0]);
+                if (i < first || i >= last) {
+                    continue;
+                }
+
+                const size_t row = offsets[i - first] + range[0] - plan.selected[i][0];
+                const char* begin = values + row * element_size;
+                send_buffer.insert(send_buffer.end(),
+                                   begin,
+                                   begin + (range[1] - range[0]) * element_size);
+                send_counts[r] += _toInt(range[1] - range[0]);
+            }
+        }
+    }
+
+    const auto send_displacements = _displacements(send_counts);
+    const auto recv_displacements = _displacements(recv_counts);
+
+    MPI_Datatype element;
+    _check(MPI_Type_contiguous(_toInt(element_size), MPI_BYTE, &element), "MPI_Type_contiguous");
+    MPI_Type_commit(&element);
+    const int status = MPI_Alltoallv(send_buffer.data(),
+                                     send_counts.data(),
+                                     send_displacements.data(),
+                                     element,
+                                     out,
+                                     recv_counts.data(),
+                                     recv_displacements.data(),
+                                     element,
+                                     comm.get());
+    MPI_Type_free(&element);
+    _check(status, "MPI_Alltoallv");
+}
+
+void _checkCollectiveError(const CollectiveComm& comm, const std::exception_ptr& error) {
+    const int failed = error ? 1 : 0;
+    int any_failed = 0;
+    _check(MPI_Allreduce(&failed, &any_failed, 1, MPI_INT, MPI_MAX, comm.get()),
+           "MPI_Allreduce");
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (any_failed != 0) {
+        throw SonataError("Collective read failed on another rank");
+    }
+}
+
+void _checkSameColumns(const CollectiveComm& comm, const Selection& ysel) {
+    // FNV-1a of the ranges; the minimum of the hash and of its complement
+    // tell whether all ranks have the same one.
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto& range : ysel.ranges()) {
+        for (const uint64_t bound : range) {
+            hash = (hash ^ bound) * 1099511628211ull;
+        }
+    }
+
+    const uint64_t local[2] = {hash, ~hash};
+    uint64_t minimum[2] = {0, 0};
+    _check(MPI_Allreduce(local, minimum, 2, MPI_UINT64_T, MPI_MIN, comm.get()), "MPI_Allreduce");
+
+    if (minimum[0] != ~minimum[1]) {
+        throw SonataError("Collective read: all ranks must select the same columns");
+    }
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <exception>
+#include <type_traits>
+#include <vector>
+
+#include <bbp/sonata/hdf5_reader.h>
+#include <highfive/H5File.hpp>
+
+#include "read_canonical_selection.hpp"
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/** A duplicate of the communicator of a collective reader, and its aggregators.
+ *
+ * Constructing it is collective.
+ */
+class CollectiveComm
+{
+  public:
+    /// `0` aggregators means the first rank of each shared memory domain.
+    CollectiveComm(MPI_Comm comm, int n_aggregators);
+
+    CollectiveComm(const CollectiveComm&) = delete;
+    CollectiveComm& operator=(const CollectiveComm&) = delete;
+
+    ~CollectiveComm();
+
+    MPI_Comm get() const noexcept {
+        return comm_;
+    }
+
+    int rank() const noexcept {
+        return rank_;
+    }
+
+    int size() const noexcept {
+        return size_;
+    }
+
+    /// The ranks that read, in ascending order.
+    const std::vector<int>& aggregators() const noexcept {
+        return aggregators_;
+    }
+
+  private:
+    MPI_Comm comm_ = MPI_COMM_NULL;
+    int rank_ = 0;
+    int size_ = 1;
+    std::vector<int> aggregators_;
+};
+
+/// The rows selected by any rank, and which aggregator reads them.
+struct CollectivePlan {
+    /// The selected rows of each rank, canonical.
+    std::vector<Selection::Ranges> ranges;
+    /// The union of all `ranges`, canonical.
+    Selection::Ranges selected;
+    /// Aggregator `a` reads `selected[selected_begin[a]]` to `selected[selected_begin[a + 1] - 1]`.
+    std::vector<size_t> selected_begin;
+};
+
+/** Share the `ranges` of every rank, and split their union among the aggregators.
+ *
+ * The union is merged into blocks according to `limits`, and each aggregator
+ * gets the selected rows of a run of whole blocks. Collective; every rank
+ * computes the same plan.
+ */
+CollectivePlan _planCollectiveRead(const CollectiveComm& comm,
+                                   const Selection::Ranges& ranges,
+                                   const bulk_read::MergeLimits& limits);
+
+/// The rows this rank reads; empty unless it's an aggregator.
+Selection::Ranges _aggregatorRanges(const CollectiveComm& comm, const CollectivePlan& plan);
+
+/** Send every rank the elements it selected.
+ *
+ * `values` are the elements of `_aggregatorRanges`, back to back, and `out`
+ * receives the elements of `plan.ranges[comm.rank()]`. Collective.
+ */
+void _scatterSelected(const CollectiveComm& comm,
+                      const CollectivePlan& plan,
+                      const char* values,
+                      size_t element_size,
+                      char* out);
+
+/// Rethrow `error`, or throw on all other ranks if any rank has one. Collective.
+void _checkCollectiveError(const CollectiveComm& comm, const std::exception_ptr& error);
+
+/** Throw on all ranks unless every rank selected the same columns `ysel`.
+ *
+ * Aggregators read the columns they selected themselves for every rank.
+ * Collective.
+ */
+void _checkSameColumns(const CollectiveComm& comm, const Selection& ysel);
+
+/** Read a canonical selection of rows with two-phase collective I/O.
+ *
+ * The aggregators read the rows selected by any rank by calling
+ *
+ *     read(selection)  // -> std::vector<T>, `row_width` elements per row
+ *
+ * which must merge the ranges with the same `read_policy`.
+ *
+ * All ranks must call this collectively, with the same `dset`.
+ */
+template <class T, class Read>
+std::vector<T> _readCollective(const CollectiveComm& comm,
+                               const HighFive::DataSet& dset,
+                               const Selection& xsel,
+                               const ReadPolicy& read_policy,
+                               Read read,
+                               size_t row_width = 1) {
+    static_assert(std::is_trivially_copyable<T>::value, "Elements are sent as bytes.");
+
+    const size_t row_size = sizeof(T) * row_width;
+    const auto limits = bulk_read::MergeLimits::fromPolicy(read_policy,
+                                                           std::max<size_t>(1, row_size),
+                                                           _compressedChunkSize(dset));
+    const auto plan = _planCollectiveRead(comm, xsel.ranges(), limits);
+    const auto ranges = _aggregatorRanges(comm, plan);
+
+    std::vector<T> values;
+    std::exception_ptr error;
+    if (!ranges.empty()) {
+        try {
+            values = read(Selection(ranges));
+            if (values.size() != bulk_read::detail::flatSize(ranges) * row_width) {
+                throw SonataError("Collective read: aggregator read the wrong number of rows");
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    _checkCollectiveError(comm, error);
+
+    std::vector<T> result(xsel.flatSize() * row_width);
+    _scatterSelected(comm,
+                     plan,
+                     reinterpret_cast<const char*>(values.data()),
+                     row_size,
+                     reinterpret_cast<char*>(result.data()));
+    return result;
+}
+
+template <class T>
+std::vector<T> _readCollectiveSelection(const CollectiveComm& comm,
+                                        const HighFive::DataSet& dset,
+                                        const Selection& selection,
+                                        const ReadPolicy& read_policy,
+                                        std::true_type /* supported */) {
+    return _readCollective<T>(comm, dset, selection, read_policy, [&](const Selection& rows) {
+        return readCanonicalSelection<T>(dset, rows, read_policy);
+    });
+}
+
+template <class T>
+std::vector<T> _readCollectiveSelection(const CollectiveComm& /* comm */,
+                                        const HighFive::DataSet& dset,
+                                        const Selection& selection,
+                                        const ReadPolicy& read_policy,
+                                        std::false_type /* supported */) {
+    return readCanonicalSelection<T>(dset, selection, read_policy);
+}
+
+template <class T>
+std::vector<T> _readCollectiveSelection(const CollectiveComm& comm,
+                                        const HighFive::DataSet& dset,
+                                        const Selection& xsel,
+                                        const Selection& ysel,
+                                        const ReadPolicy& read_policy,
+                                        std::true_type /* supported */) {
+    _checkSameColumns(comm, ysel);
+    // The rows are merged as `readCanonicalSelection` merges them.
+    ReadPolicy rows_policy = read_policy;
+    rows_policy.max_block_bytes = read_policy.max_block_bytes_2d;
+    return _readCollective<T>(
+        comm,
+        dset,
+        xsel,
+        rows_policy,
+        [&](const Selection& rows) {
+            return readCanonicalSelection<T>(dset, rows, ysel, read_policy);
+        },
+        _rowWidth<T>(ysel));
+}
+
+template <class T>
+std::vector<T> _readCollectiveSelection(const CollectiveComm& /* comm */,
+                                        const HighFive::DataSet& dset,
+                                        const Selection& xsel,
+                                        const Selection& ysel,
+                                        const ReadPolicy& read_policy,
+                                        std::false_type /* supported */) {
+    return readCanonicalSelection<T>(dset, xsel, ysel, read_policy);
+}
+
+/** Read a canonical selection with two-phase collective I/O.
+ *
+ * Elements that can't be sent as bytes, i.e. strings, are read by each rank
+ * independently.
+ *
+ * @sa `_readCollective`
+ */
+template <class T>
+std::vector<T> readCollectiveSelection(const CollectiveComm& comm,
+                                       const HighFive::DataSet& dset,
+                                       const Selection& selection,
+                                       const ReadPolicy& read_policy) {
+    return _readCollectiveSelection<T>(
+        comm,
+        dset,
+        selection,
+        read_policy,
+        std::integral_constant<bool, _RawElementTraits<T>::supported>());
+}
+
+template <class T>
+std::vector<T> readCollectiveSelection(const CollectiveComm& comm,
+                                       const HighFive::DataSet& dset,
+                                       const Selection& xsel,
+                                       const Selection& ysel,
+                                       const ReadPolicy& read_policy) {
+    return _readCollectiveSelection<T>(
+        comm,
+        dset,
+        xsel,
+        ysel,
+        read_policy,
+        std::integral_constant<bool, _RawElementTraits<T>::supported>());
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,174 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "read_contiguous.hpp"
+
+#include <fcntl.h>     // open, fcntl
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close
+
+#include <H5Dpublic.h>
+#include <H5FDsec2.h>
+#include <H5Fpublic.h>
+#include <H5Ipublic.h>
+#include <H5Opublic.h>
+#include <H5Ppublic.h>
+#include <H5public.h>  // H5_VERSION_GE
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+namespace {
+
+/// The name of an HDF5 object, from a `get_name(id, buffer, size)` function.
+template <class GetName>
+std::string _getName(hid_t id, GetName get_name) {
+    const auto size = get_name(id, nullptr, 0);
+    if (size <= 0) {
+        return {};
+    }
+
+    std::string name(static_cast<size_t>(size) + 1, '\0');
+    get_name(id, &name[0], name.size());
+    name.resize(static_cast<size_t>(size));
+    return name;
+}
+
+/// Are the elements of `dset` stored contiguously in the file, as they are in memory?
+bool _isContiguous(const HighFive::DataSet& dset) {
+    const hid_t dcpl = H5Dget_create_plist(dset.getId());
+    if (dcpl < 0) {
+        return false;
+    }
+
+    const bool contiguous = H5Pget_layout(dcpl) == H5D_CONTIGUOUS && H5Pget_nfilters(dcpl) == 0 &&
+                            H5Pget_external_count(dcpl) == 0;
+    H5Pclose(dcpl);
+
+    return contiguous;
+}
+
+}  // unnamed namespace
+
+
+FileVersion _fileVersion(const struct stat& info) {
+#ifdef __APPLE__
+    const auto& mtime = info.st_mtimespec;
+#else
+    const auto& mtime = info.st_mtim;
+#endif
+    return {static_cast<int64_t>(info.st_dev),
+            static_cast<int64_t>(info.st_ino),
+            static_cast<int64_t>(info.st_size),
+            static_cast<int64_t>(mtime.tv_sec),
+            static_cast<int64_t>(mtime.tv_nsec)};
+}
+
+bool _openFile(const HighFive::DataSet& dset, OpenFile& file) {
+    const hid_t file_id = H5Iget_file_id(dset.getId());
+    if (file_id < 0) {
+        return false;
+    }
+
+    int fd = -1;
+    const hid_t fapl = H5Fget_access_plist(file_id);
+    if (fapl >= 0) {
+        void* handle = nullptr;
+        if (H5Pget_driver(fapl) == H5FD_SEC2 && H5Fget_vfd_handle(file_id, fapl, &handle) >= 0 &&
+            handle != nullptr) {
+            fd = *static_cast<int*>(handle);
+        }
+        H5Pclose(fapl);
+    }
+    // Only drops the reference of `H5Iget_file_id`.
+    H5Fclose(file_id);
+
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+        return false;
+    }
+
+    file.fd = fd;
+    file.version = _fileVersion(info);
+    file.id = {file.version[0], file.version[1]};
+    file.size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+int _reopenFile(const OpenFile& file) {
+#ifdef __linux__
+    const auto path = "/proc/self/fd/" + std::to_string(file.fd);
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        if (_isDescriptorOf(fd, file.id)) {
+            return fd;
+        }
+        ::close(fd);
+    }
+#endif
+    return ::fcntl(file.fd, F_DUPFD_CLOEXEC, 0);
+}
+
+bool _isDescriptorOf(int fd, const FileId& id) {
+    struct stat info;
+    return ::fstat(fd, &info) == 0 && static_cast<int64_t>(info.st_dev) == id[0] &&
+           static_cast<int64_t>(info.st_ino) == id[1];
+}
+
+FileVersion _fileVersion(const HighFive::DataSet& dset) {
+    OpenFile file;
+    if (_openFile(dset, file)) {
+        return file.version;
+    }
+
+    // HDF5 numbers the files it opens, and doesn't reuse the numbers.
+    unsigned long fileno = 0;
+#if H5_VERSION_GE(1, 12, 0)
+    const hid_t file_id = H5Iget_file_id(dset.getId());
+    if (file_id >= 0) {
+        H5Fget_fileno(file_id, &fileno);
+        H5Fclose(file_id);
+    }
+#else
+    H5O_info_t info;
+    if (H5Oget_info2(dset.getId(), &info, H5O_INFO_BASIC) >= 0) {
+        fileno = info.fileno;
+    }
+#endif
+    return {-1, static_cast<int64_t>(fileno), 0, 0, 0};
+}
+
+std::string _datasetName(const HighFive::DataSet& dset) {
+    return _getName(dset.getId(), H5Iget_name);
+}
+
+bool _contiguousLayout(const HighFive::DataSet& dset,
+                       const HighFive::DataType& type,
+                       ContiguousLayout& layout) {
+    const auto dims = dset.getSpace().getDimensions();
+    if (dims.size() != 1 && dims.size() != 2) {
+        return false;
+    }
+
+    const haddr_t offset = H5Dget_offset(dset.getId());
+    if (offset == HADDR_UNDEF || !_isContiguous(dset) || !(dset.getDataType() == type)) {
+        return false;
+    }
+
+    layout.offset = offset;
+    layout.size = dset.getElementCount() * type.getSize();
+    layout.rank = dims.size();
+    layout.dims = {dims[0], dims.size() == 2 ? dims[1] : 1};
+    return true;
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <vector>
+
+#include <bbp/sonata/hdf5_reader.h>
+#include <highfive/H5File.hpp>
+
+#include "read_canonical_selection.hpp"
+
+struct stat;
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/// Identifies a version of a file: device, inode, size and modification time.
+using FileVersion = std::array<int64_t, 5>;
+
+/// The version of the file with status `info`.
+FileVersion _fileVersion(const struct stat& info);
+
+/// Identifies a file: device and inode.
+using FileId = std::array<int64_t, 2>;
+
+/// A file as opened by HDF5.
+struct OpenFile {
+    /// Owned by HDF5; valid as long as the file is open.
+    int fd = -1;
+    FileId id{};
+    size_t size = 0;
+    FileVersion version{};
+};
+
+/** The file of `dset`, as opened by HDF5.
+ *
+ * Returns `false` unless HDF5 reads it through a POSIX descriptor, i.e. with
+ * the default `sec2` driver.
+ */
+bool _openFile(const HighFive::DataSet& dset, OpenFile& file);
+
+/** A new descriptor of `file`, or `-1` with `errno` set.
+ *
+ * On Linux, the file is opened again through `/proc/self/fd`. Unlike a
+ * duplicate of the descriptor of HDF5, the new one doesn't share HDF5's lock on
+ * the file; which would keep the file locked after HDF5 closes it. Elsewhere,
+ * the descriptor is duplicated.
+ */
+int _reopenFile(const OpenFile& file);
+
+/// Is `fd` an open descriptor of the file `id`?
+bool _isDescriptorOf(int fd, const FileId& id);
+
+/** The version of the file of `dset`, as opened by HDF5.
+ *
+ * For files that HDF5 doesn't read through a POSIX descriptor, the device is
+ * `-1` and the inode is HDF5's number of the open file; the same file opened
+ * again gets another number.
+ */
+FileVersion _fileVersion(const HighFive::DataSet& dset);
+
+/** Where the elements of a dataset are in its file, if they're stored as is.
+ *
+ * One-dimensional datasets are treated as a single column.
+ */
+struct ContiguousLayout {
+    uint64_t offset = 0;
+    size_t size = 0;
+    size_t rank = 0;
+    std::array<size_t, 2> dims{};
+};
+
+/// The path of `dset` in its file.
+std::string _datasetName(const HighFive::DataSet& dset);
+
+/** The layout of `dset`, if its elements are stored contiguously in its file,
+ *  as elements of `type`.
+ *
+ * Returns `false` if `dset` is chunked, external, filtered, not allocated, has
+ * more than two dimensions or its elements aren't of type `type`.
+ */
+bool _contiguousLayout(const HighFive::DataSet& dset,
+                       const HighFive::DataType& type,
+                       ContiguousLayout& layout);
+
+/** Opens the files HDF5 has open, and remembers where the contiguous datasets
+ *  are in them.
+ *
+ * Files are opened through the descriptor of HDF5, and identified by its device
+ * and inode; never by their path, which may be relative, or name another file
+ * by now. Each dataset is looked up once per element type. Then reading it only
+ * needs the descriptor and the name of the dataset from HDF5. If the file
+ * changes, i.e. its size or modification time, it's opened and looked up again.
+ * Files that HDF5 doesn't read through a POSIX descriptor are left to HDF5.
+ *
+ * Once HDF5 has closed a file, i.e. its descriptor is closed or refers to
+ * another file, the next lookup drops the file and its datasets. Hence, the
+ * cache holds no more files than HDF5 has open, plus at most the ones closed
+ * since the last lookup.
+ *
+ * `File` is constructed from an `OpenFile`, and has `size()` and `version()`.
+ */
+template <class File>
+class ContiguousCache
+{
+  public:
+    /// A contiguous dataset in `file`; `file` is null if it's not contiguous.
+    struct Entry {
+        std::shared_ptr<const File> file;
+        ContiguousLayout layout;
+    };
+
+    /** The file and layout of `dset`, whose elements are of type `type`.
+     *
+     * Calls HDF5, like every plugin method. `key` identifies `type`.
+     */
+    Entry find(const HighFive::DataSet& dset,
+               const HighFive::DataType& type,
+               std::type_index key) {
+        OpenFile open_file;
+        if (!_openFile(dset, open_file)) {
+            return {};
+        }
+
+        auto dataset_key = std::make_tuple(open_file.id, _datasetName(dset), key);
+        std::lock_guard<std::mutex> lock(mutex_);
+        _evictClosed(open_file);
+
+        // Datasets that aren't contiguous stay so, even if the file changes.
+        const auto it = datasets_.find(dataset_key);
+        if (it != datasets_.end()) {
+            if (!it->second.file || it->second.file->version() == open_file.version) {
+                return it->second;
+            }
+            datasets_.erase(it);
+        }
+
+        Entry entry;
+        if (_contiguousLayout(dset, type, entry.layout)) {
+            entry.file = _getFile(open_file);
+            if (entry.layout.offset + entry.layout.size > entry.file->size()) {
+                entry.file.reset();
+            }
+        }
+
+        datasets_.emplace(std::move(dataset_key), entry);
+        return entry;
+    }
+
+  private:
+    /// Drop the files, and their datasets, that HDF5 has closed; except `open_file`.
+    void _evictClosed(const OpenFile& open_file) {
+        bool evicted = false;
+        for (auto it = descriptors_.begin(); it != descriptors_.end();) {
+            if (it->first == open_file.id || _isDescriptorOf(it->second, it->first)) {
+                ++it;
+            } else {
+                files_.erase(it->first);
+                it = descriptors_.erase(it);
+                evicted = true;
+            }
+        }
+        descriptors_[open_file.id] = open_file.fd;
+
+        if (evicted) {
+            for (auto it = datasets_.begin(); it != datasets_.end();) {
+                if (descriptors_.count(std::get<0>(it->first)) == 0) {
+                    it = datasets_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    std::shared_ptr<const File> _getFile(const OpenFile& open_file) {
+        auto& file = files_[open_file.id];
+        if (!file || file->version() != open_file.version) {
+            file = std::make_shared<const File>(open_file);
+        }
+
+        return file;
+    }
+
+    std::mutex mutex_;
+    /// The descriptor of HDF5 of every file with datasets in `datasets_`.
+    std::map<FileId, int> descriptors_;
+    std::map<FileId, std::shared_ptr<const File>> files_;
+    std::map<std::tuple<FileId, std::string, std::type_index>, Entry> datasets_;
+};
+
+/** Read the rows `xranges` and columns `yrange` of a contiguous dataset into
+ *  `result`, if `dset` has rank `rank` and is contiguous.
+ *
+ * The elements are copied by calling
+ *
+ *     gather(entry, element_size, xranges, yrange, out);
+ *
+ * where `out` is row-major, with `yrange[1] - yrange[0]` elements per row.
+ */
+template <class T, class File, class Gather>
+bool _tryReadContiguous(ContiguousCache<File>& cache,
+                        const HighFive::DataSet& dset,
+                        size_t rank,
+                        const Selection::Ranges& xranges,
+                        const Selection::Range& yrange,
+                        std::vector<T>& result,
+                        Gather gather,
+                        std::true_type /* supported */) {
+    using Value = typename _RawElementTraits<T>::value_type;
+    const auto entry = cache.find(dset,
+                                  HighFive::AtomicType<Value>(),
+                                  std::type_index(typeid(Value)));
+    const auto& layout = entry.layout;
+    if (!entry.file || layout.rank != rank ||
+        (yrange[1] - yrange[0]) % _RawElementTraits<T>::width != 0 ||
+        yrange[1] > layout.dims[1] || std::get<1>(xranges.back()) > layout.dims[0]) {
+        return false;
+    }
+
+    const size_t row_width = (yrange[1] - yrange[0]) / _RawElementTraits<T>::width;
+    result.resize(bulk_read::detail::flatSize(xranges) * row_width);
+    gather(entry, sizeof(Value), xranges, yrange, reinterpret_cast<char*>(result.data()));
+    if (auto* statistics = currentIoStatistics()) {
+        statistics->recordBlocks(xranges.size(), _byteSize(result));
+    }
+    return true;
+}
+
+template <class T, class File, class Gather>
+bool _tryReadContiguous(ContiguousCache<File>& /* cache */,
+                        const HighFive::DataSet& /* dset */,
+                        size_t /* rank */,
+                        const Selection::Ranges& /* xranges */,
+                        const Selection::Range& /* yrange */,
+                        std::vector<T>& /* result */,
+                        Gather /* gather */,
+                        std::false_type /* supported */) {
+    return false;
+}
+
+/** Read a canonical selection of a contiguous dataset with `gather`.
+ *
+ * Datasets that aren't contiguous are read with `readCanonicalSelection`.
+ *
+ * @sa `_tryReadContiguous`
+ */
+template <class T, class File, class Gather>
+std::vector<T> readContiguousSelection(const HighFive::DataSet& dset,
+                                       const Selection& selection,
+                                       ContiguousCache<File>& cache,
+                                       Gather gather,
+                                       const ReadPolicy& read_policy) {
+    if (selection.empty()) {
+        return {};
+    }
+
+    std::vector<T> result;
+    if (_tryReadContiguous(cache,
+                           dset,
+                           1,
+                           selection.ranges(),
+                           {0, 1},
+                           result,
+                           gather,
+                           std::integral_constant<bool, _RawElementTraits<T>::supported>())) {
+        return result;
+    }
+    return readCanonicalSelection<T>(dset, selection, read_policy);
+}
+
+template <class T, class File, class Gather>
+std::vector<T> readContiguousSelection(const HighFive::DataSet& dset,
+                                       const Selection& xsel,
+                                       const Selection& ysel,
+                                       ContiguousCache<File>& cache,
+                                       Gather gather,
+                                       const ReadPolicy& read_policy) {
+    const auto& yranges = ysel.ranges();
+    if (xsel.empty() || yranges.empty()) {
+        return {};
+    }
+
+    // Several ranges of columns are read with `readCanonicalSelection`.
+    std::vector<T> result;
+    if (yranges.size() == 1 &&
+        _tryReadContiguous(cache,
+                           dset,
+                           2,
+                           xsel.ranges(),
+                           yranges[0],
+                           result,
+                           gather,
+                           std::integral_constant<bool, _RawElementTraits<T>::supported>())) {
+        return result;
+    }
+    return readCanonicalSelection<T>(dset, xsel, ysel, read_policy);
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,338 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "read_direct_chunk.hpp"
+
+#include <H5Dpublic.h>
+#include <H5Ppublic.h>
+#include <H5Zpublic.h>
+#include <H5public.h>  // H5_VERSION_GE
+
+#include <algorithm>
+#include <cstring>  // std::memcpy
+#include <fmt/format.h>
+
+#ifdef SONATA_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+// `H5Dread_chunk` was added in 1.10.3.
+#if H5_VERSION_GE(1, 10, 3)
+#define SONATA_HAS_H5DREAD_CHUNK
+#endif
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+namespace {
+
+bool _isSupportedFilter(int filter) {
+    switch (filter) {
+    case H5Z_FILTER_SHUFFLE:
+        return true;
+    case H5Z_FILTER_DEFLATE:
+#ifdef SONATA_HAS_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+std::vector<char> _inflate(const std::vector<char>& compressed, size_t size) {
+#ifdef SONATA_HAS_ZLIB
+    std::vector<char> decompressed(size);
+    auto decompressed_size = static_cast<uLongf>(size);
+    const int status = uncompress(reinterpret_cast<Bytef*>(decompressed.data()),
+                                  &decompressed_size,
+                                  reinterpret_cast<const Bytef*>(compressed.data()),
+                                  static_cast<uLong>(compressed.size()));
+    if (status != Z_OK) {
+        throw SonataError(fmt::format("Failed to inflate chunk: zlib error {}", status));
+    }
+    decompressed.resize(decompressed_size);
+
+    return decompressed;
+#else
+    (void) compressed;
+    (void) size;
+    throw SonataError("Can't inflate chunk: libsonata was built without zlib");
+#endif
+}
+
+/// Undo HDF5's shuffle filter, which stores byte `b` of element `i` at `b * n + i`.
+std::vector<char> _unshuffle(const std::vector<char>& shuffled, size_t element_size) {
+    const size_t n = shuffled.size() / element_size;
+
+    std::vector<char> unshuffled(shuffled.size());
+    for (size_t b = 0; b < element_size; ++b) {
+        const char* src = shuffled.data() + b * n;
+        char* dst = unshuffled.data() + b;
+        for (size_t i = 0; i < n; ++i) {
+            dst[i * element_size] = src[i];
+        }
+    }
+
+    // Trailing bytes that don't form an element aren't shuffled.
+    const size_t tail = n * element_size;
+    std::copy(shuffled.begin() + static_cast<std::ptrdiff_t>(tail),
+              shuffled.end(),
+              unshuffled.begin() + static_cast<std::ptrdiff_t>(tail));
+
+    return unshuffled;
+}
+
+/// Undo the filters that weren't skipped according to `filter_mask`, last to first.
+std::vector<char> _decodeChunk(std::vector<char> data,
+                               const DirectChunkLayout& layout,
+                               uint32_t filter_mask,
+                               size_t chunk_bytes) {
+    for (size_t i = layout.filters.size(); i-- > 0;) {
+        if ((filter_mask & (1u << i)) != 0) {
+            continue;
+        }
+
+        switch (layout.filters[i]) {
+        case H5Z_FILTER_DEFLATE:
+            data = _inflate(data, chunk_bytes);
+            break;
+        case H5Z_FILTER_SHUFFLE:
+            data = _unshuffle(data, layout.element_size);
+            break;
+        default:
+            LIBSONATA_THROW_IF_REACHED
+        }
+    }
+
+    if (data.size() != chunk_bytes) {
+        throw SonataError(fmt::format("Decoded chunk has {} bytes, expected {}",
+                                      data.size(),
+                                      chunk_bytes));
+    }
+
+    return data;
+}
+
+/// The rows `[begin, end)` of one chunk; the row `begin` goes to `out_row`.
+struct Piece {
+    size_t begin;
+    size_t end;
+    size_t out_row;
+};
+
+/// The pieces of the selection that fall into the chunks of the same rows.
+struct ChunkRow {
+    size_t index;
+    std::vector<Piece> pieces;
+};
+
+/// One chunk to read, and where to copy its elements.
+struct Chunk {
+    const ChunkRow* row;
+    std::array<hsize_t, 2> offset;
+    hsize_t storage_size;
+};
+
+std::vector<ChunkRow> _splitByChunkRow(const Selection::Ranges& xranges, size_t chunk_rows) {
+    std::vector<ChunkRow> rows;
+    size_t out_row = 0;
+    for (const auto& range : xranges) {
+        for (size_t begin = range[0]; begin < range[1];) {
+            const size_t index = begin / chunk_rows;
+            const size_t end = std::min<size_t>(range[1], (index + 1) * chunk_rows);
+            if (rows.empty() || rows.back().index != index) {
+                rows.push_back({index, {}});
+            }
+            rows.back().pieces.push_back({begin, end, out_row});
+
+            out_row += end - begin;
+            begin = end;
+        }
+    }
+
+    return rows;
+}
+
+/// Copy the selected elements of the decoded chunk `data` to `out`.
+void _extractChunk(const std::vector<char>& data,
+                   const DirectChunkLayout& layout,
+                   const Chunk& chunk,
+                   const Selection::Range& yrange,
+                   char* out) {
+    const size_t element_size = layout.element_size;
+    const size_t chunk_columns = layout.chunk_dims[1];
+    const size_t out_columns = yrange[1] - yrange[0];
+
+    // The selected columns of this chunk.
+    const size_t j_first = chunk.offset[1];
+    const size_t j_begin = std::max<size_t>(yrange[0], j_first);
+    const size_t j_end = std::min<size_t>(yrange[1], j_first + chunk_columns);
+    const size_t row_bytes = (j_end - j_begin) * element_size;
+
+    for (const auto& piece : chunk.row->pieces) {
+        const char* src = data.data() +
+                          ((piece.begin - chunk.offset[0]) * chunk_columns + j_begin - j_first) *
+                              element_size;
+        char* dst = out + (piece.out_row * out_columns + j_begin - yrange[0]) * element_size;
+
+        if (chunk_columns == out_columns && j_end - j_begin == out_columns) {
+            // The rows are contiguous in both.
+            std::memcpy(dst, src, (piece.end - piece.begin) * row_bytes);
+        } else {
+            for (size_t i = piece.begin; i < piece.end; ++i) {
+                std::memcpy(dst, src, row_bytes);
+                src += chunk_columns * element_size;
+                dst += out_columns * element_size;
+            }
+        }
+    }
+}
+
+}  // unnamed namespace
+
+
+bool _directChunkLayout(const HighFive::DataSet& dset, DirectChunkLayout& layout) {
+#ifdef SONATA_HAS_H5DREAD_CHUNK
+    const hid_t dcpl = H5Dget_create_plist(dset.getId());
+    if (dcpl < 0) {
+        return false;
+    }
+
+    bool supported = H5Pget_layout(dcpl) == H5D_CHUNKED;
+
+    std::array<hsize_t, H5S_MAX_RANK> chunk_dims{};
+    const int rank = supported ? H5Pget_chunk(dcpl, H5S_MAX_RANK, chunk_dims.data()) : 0;
+    supported = supported && (rank == 1 || rank == 2);
+
+    const int n_filters = supported ? H5Pget_nfilters(dcpl) : 0;
+    layout.filters.clear();
+    for (int i = 0; supported && i < n_filters; ++i) {
+        unsigned flags = 0;
+        size_t n_values = 0;
+        const int filter = H5Pget_filter2(
+            dcpl, static_cast<unsigned>(i), &flags, &n_values, nullptr, 0, nullptr, nullptr);
+        supported = _isSupportedFilter(filter);
+        layout.filters.push_back(filter);
+    }
+    H5Pclose(dcpl);
+
+    if (!supported) {
+        return false;
+    }
+
+    const auto dims = dset.getSpace().getDimensions();
+    layout.rank = static_cast<size_t>(rank);
+    layout.dims = {dims[0], rank == 2 ? dims[1] : 1};
+    layout.chunk_dims = {chunk_dims[0], rank == 2 ? chunk_dims[1] : 1};
+    layout.element_size = dset.getDataType().getSize();
+
+    return true;
+#else
+    (void) dset;
+    (void) layout;
+    return false;
+#endif
+}
+
+bool _readDirectChunks(const HighFive::DataSet& dset,
+                       const DirectChunkLayout& layout,
+                       const Selection::Ranges& xranges,
+                       const Selection::Range& yrange,
+                       char* out,
+                       ThreadPool& pool) {
+#ifdef SONATA_HAS_H5DREAD_CHUNK
+    const auto rows = _splitByChunkRow(xranges, layout.chunk_dims[0]);
+
+    // Every row of chunks, times the columns of chunks that overlap `yrange`.
+    std::vector<Chunk> chunks;
+    const size_t chunk_columns = layout.chunk_dims[1];
+    for (const auto& row : rows) {
+        for (size_t j = yrange[0] / chunk_columns * chunk_columns; j < yrange[1];
+             j += chunk_columns) {
+            Chunk chunk{&row, {row.index * layout.chunk_dims[0], j}, 0};
+            if (H5Dget_chunk_storage_size(dset.getId(),
+                                          chunk.offset.data(),
+                                          &chunk.storage_size) < 0 ||
+                chunk.storage_size == 0) {
+                return false;
+            }
+            chunks.push_back(chunk);
+        }
+    }
+
+    const size_t chunk_bytes = layout.chunk_dims[0] * chunk_columns * layout.element_size;
+
+    // Reading raw chunks is faster than decoding them: bound the chunks in
+    // flight, else all of them are held in memory at once.
+    const size_t max_in_flight = 2 * std::max<size_t>(pool.size(), 1);
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(chunks.size());
+    try {
+        for (const auto& chunk : chunks) {
+            if (futures.size() >= max_in_flight) {
+                // Wait for the oldest task of the window; errors are rethrown
+                // by `_waitAll`.
+                futures[futures.size() - max_in_flight].wait();
+            }
+
+            std::vector<char> raw(chunk.storage_size);
+            uint32_t filter_mask = 0;
+            if (H5Dread_chunk(dset.getId(),
+                              H5P_DEFAULT,
+                              chunk.offset.data(),
+                              &filter_mask,
+                              raw.data()) < 0) {
+                throw SonataError(fmt::format("Failed to read the chunk at row {}, column {}",
+                                              chunk.offset[0],
+                                              chunk.offset[1]));
+            }
+
+            auto decode = [&layout, &chunk, &yrange, out, chunk_bytes, filter_mask](
+                              std::vector<char>& raw) {
+                const auto data = _decodeChunk(std::move(raw), layout, filter_mask, chunk_bytes);
+                _extractChunk(data, layout, chunk, yrange, out);
+            };
+            futures.push_back(pool.submit(
+                [decode, raw = std::move(raw)]() mutable { decode(raw); }));
+        }
+    } catch (...) {
+        // The tasks refer to `chunks`.
+        for (auto& future : futures) {
+            future.wait();
+        }
+        throw;
+    }
+
+    _waitAll(futures);
+    if (auto* statistics = currentIoStatistics()) {
+        uint64_t bytes = 0;
+        for (const auto& chunk : chunks) {
+            bytes += chunk.storage_size;
+        }
+        statistics->recordBlocks(chunks.size(), bytes);
+    }
+    return true;
+#else
+    (void) dset;
+    (void) layout;
+    (void) xranges;
+    (void) yrange;
+    (void) out;
+    (void) pool;
+    return false;
+#endif
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <bbp/sonata/hdf5_reader.h>
+#include <highfive/H5File.hpp>
+
+#include "read_canonical_selection.hpp"
+#include "thread_pool.h"
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/** Where the chunks of a dataset are and how to decode them.
+ *
+ * One-dimensional datasets are treated as a single column.
+ */
+struct DirectChunkLayout {
+    size_t rank = 0;
+    std::array<size_t, 2> dims{};
+    std::array<size_t, 2> chunk_dims{};
+    size_t element_size = 0;
+    /// H5Z filter IDs, in the order they're applied when writing.
+    std::vector<int> filters;
+};
+
+/** The layout of `dset`, if libsonata can decode its chunks itself.
+ *
+ * Returns `false` if `dset` isn't chunked, has more than two dimensions or
+ * uses a filter other than deflate and shuffle; deflate requires zlib.
+ */
+bool _directChunkLayout(const HighFive::DataSet& dset, DirectChunkLayout& layout);
+
+/** Read the rows `xranges` and the columns `yrange` into `out`.
+ *
+ * The raw chunks are read by the calling thread, with `H5Dread_chunk`; they're
+ * decoded and copied to `out` by the tasks on `pool`. `out` is row-major, with
+ * `yrange[1] - yrange[0]` elements per row.
+ *
+ * Returns `false`, without reading anything, if one of the chunks hasn't been
+ * allocated.
+ */
+bool _readDirectChunks(const HighFive::DataSet& dset,
+                       const DirectChunkLayout& layout,
+                       const Selection::Ranges& xranges,
+                       const Selection::Range& yrange,
+                       char* out,
+                       ThreadPool& pool);
+
+template <class T>
+bool _canReadDirectChunks(const HighFive::DataSet& dset,
+                          size_t rank,
+                          DirectChunkLayout& layout,
+                          std::true_type /* supported */) {
+    using Value = typename _RawElementTraits<T>::value_type;
+    return dset.getDataType() == HighFive::AtomicType<Value>() &&
+           _directChunkLayout(dset, layout) && layout.rank == rank;
+}
+
+template <class T>
+bool _canReadDirectChunks(const HighFive::DataSet& /* dset */,
+                          size_t /* rank */,
+                          DirectChunkLayout& /* layout */,
+                          std::false_type /* supported */) {
+    return false;
+}
+
+/// Read into `result`, if `dset` has rank `rank` and can be read directly.
+template <class T>
+bool _tryReadDirectChunks(const HighFive::DataSet& dset,
+                          size_t rank,
+                          const Selection::Ranges& xranges,
+                          const Selection::Range& yrange,
+                          std::vector<T>& result,
+                          ThreadPool& pool) {
+    using Traits = _RawElementTraits<T>;
+    DirectChunkLayout layout;
+    if (!_canReadDirectChunks<T>(dset,
+                                 rank,
+                                 layout,
+                                 std::integral_constant<bool, Traits::supported>()) ||
+        (yrange[1] - yrange[0]) % Traits::width != 0 || yrange[1] > layout.dims[1]) {
+        return false;
+    }
+
+    const size_t row_width = (yrange[1] - yrange[0]) / Traits::width;
+    result.resize(bulk_read::detail::flatSize(xranges) * row_width);
+    return _readDirectChunks(
+        dset, layout, xranges, yrange, reinterpret_cast<char*>(result.data()), pool);
+}
+
+/** Read a canonical selection by decoding the chunks of `dset` on `pool`.
+ *
+ * Datasets that can't be read like this are read with `readCanonicalSelection`.
+ */
+template <class T>
+std::vector<T> readDirectChunkSelection(const HighFive::DataSet& dset,
+                                        const Selection& selection,
+                                        ThreadPool& pool,
+                                        const ReadPolicy& read_policy) {
+    if (selection.empty()) {
+        return {};
+    }
+
+    std::vector<T> result;
+    if (_tryReadDirectChunks(dset, 1, selection.ranges(), {0, 1}, result, pool)) {
+        return result;
+    }
+    return readCanonicalSelection<T>(dset, selection, read_policy);
+}
+
+template <class T>
+std::vector<T> readDirectChunkSelection(const HighFive::DataSet& dset,
+                                        const Selection& xsel,
+                                        const Selection& ysel,
+                                        ThreadPool& pool,
+                                        const ReadPolicy& read_policy) {
+    const auto& yranges = ysel.ranges();
+    if (xsel.empty() || yranges.empty()) {
+        return {};
+    }
+
+    // Several ranges of columns are read with `readCanonicalSelection`.
+    std::vector<T> result;
+    if (yranges.size() == 1 &&
+        _tryReadDirectChunks(dset, 2, xsel.ranges(), yranges[0], result, pool)) {
+        return result;
+    }
+    return readCanonicalSelection<T>(dset, xsel, ysel, read_policy);
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,359 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "read_io_uring.hpp"
+
+#include <unistd.h>  // pread, close
+
+#ifdef SONATA_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>     // mmap, munmap
+#include <sys/syscall.h>  // __NR_io_uring_*
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>  // std::memset, std::strerror
+#include <fmt/format.h>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+namespace {
+
+// Larger requests are split, `io_uring_sqe::len` is 32 bits.
+constexpr size_t MAX_REQUEST_SIZE = size_t(1) << 30;
+
+// An error of a read that isn't an `errno`.
+constexpr int END_OF_FILE = -1;
+
+SonataError _readError(int error) {
+    if (error == END_OF_FILE) {
+        return SonataError("Failed to read: unexpected end of file");
+    }
+    return SonataError(fmt::format("Failed to read: {}", std::strerror(error)));
+}
+
+/// Read `request` with `pread`; returns `0`, or the error, see `_readError`.
+int _pread(int fd, const ReadRequest& request) {
+    size_t done = 0;
+    while (done < request.size) {
+        const ssize_t n = ::pread(fd,
+                                  request.out + done,
+                                  request.size - done,
+                                  static_cast<off_t>(request.offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return errno;
+        }
+        if (n == 0) {
+            return END_OF_FILE;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return 0;
+}
+
+}  // unnamed namespace
+
+
+DescriptorFile::DescriptorFile(const OpenFile& file)
+    : fd_(_reopenFile(file))
+    , size_(file.size)
+    , version_(file.version) {
+    // The descriptor stays open after HDF5 closes its own.
+    if (fd_ < 0) {
+        throw SonataError(fmt::format("Can't open a file again: {}", std::strerror(errno)));
+    }
+}
+
+DescriptorFile::~DescriptorFile() {
+    ::close(fd_);
+}
+
+
+#ifdef SONATA_HAS_IO_URING
+
+/// The memory shared with the kernel, see `io_uring_setup(2)`.
+struct BatchReader::Ring {
+    int fd = -1;
+    unsigned entries = 0;
+
+    void* sq_ptr = MAP_FAILED;
+    size_t sq_size = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned sq_mask = 0;
+    unsigned* sq_array = nullptr;
+
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+
+    void* cq_ptr = MAP_FAILED;
+    size_t cq_size = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    ~Ring() {
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+            ::munmap(cq_ptr, cq_size);
+        }
+        if (sq_ptr != MAP_FAILED) {
+            ::munmap(sq_ptr, sq_size);
+        }
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqes_size);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    /// The ring, or null if io_uring isn't available.
+    static std::unique_ptr<Ring> create(unsigned queue_depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        std::unique_ptr<Ring> ring(new Ring());
+        ring->fd = static_cast<int>(::syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (ring->fd < 0) {
+            return nullptr;
+        }
+        ring->entries = params.sq_entries;
+
+        ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+        }
+
+        ring->sq_ptr = ::mmap(nullptr,
+                              ring->sq_size,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE,
+                              ring->fd,
+                              IORING_OFF_SQ_RING);
+        if (ring->sq_ptr == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->cq_ptr = single_mmap ? ring->sq_ptr
+                                   : ::mmap(nullptr,
+                                            ring->cq_size,
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE,
+                                            ring->fd,
+                                            IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            return nullptr;
+        }
+
+        ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        ring->sqes = static_cast<io_uring_sqe*>(::mmap(nullptr,
+                                                       ring->sqes_size,
+                                                       PROT_READ | PROT_WRITE,
+                                                       MAP_SHARED | MAP_POPULATE,
+                                                       ring->fd,
+                                                       IORING_OFF_SQES));
+        if (ring->sqes == MAP_FAILED) {
+            return nullptr;
+        }
+
+        auto* sq = static_cast<char*>(ring->sq_ptr);
+        ring->sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring->sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        auto* cq = static_cast<char*>(ring->cq_ptr);
+        ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring->cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return ring;
+    }
+};
+
+#else
+
+struct BatchReader::Ring {
+    static std::unique_ptr<Ring> create(unsigned /* queue_depth */) {
+        return nullptr;
+    }
+};
+
+#endif
+
+
+BatchReader::BatchReader(unsigned queue_depth)
+    : ring_(queue_depth > 0 ? Ring::create(queue_depth) : nullptr) { }
+
+BatchReader::~BatchReader() = default;
+
+bool BatchReader::usesIoUring() const noexcept {
+    return ring_ != nullptr;
+}
+
+void BatchReader::read(int fd, std::vector<ReadRequest> requests) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (ring_) {
+        _readIoUring(fd, requests);
+    } else {
+        for (const auto& request : requests) {
+            const int error = _pread(fd, request);
+            if (error != 0) {
+                throw _readError(error);
+            }
+        }
+    }
+}
+
+#ifdef SONATA_HAS_IO_URING
+
+void BatchReader::_readIoUring(int fd, std::vector<ReadRequest>& requests) {
+    Ring& ring = *ring_;
+
+    // Requests that still need to be submitted, as indices into `requests`.
+    std::vector<size_t> queued(requests.size());
+    for (size_t i = 0; i < queued.size(); ++i) {
+        queued[i] = queued.size() - 1 - i;
+    }
+
+    size_t in_flight = 0;
+    int error = 0;
+    while ((!queued.empty() && error == 0) || in_flight > 0) {
+        // Fill the submission queue.
+        unsigned tail = *ring.sq_tail;
+        const unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        while (!queued.empty() && error == 0 && in_flight < ring.entries &&
+               tail - head < ring.entries) {
+            const size_t i = queued.back();
+            queued.pop_back();
+
+            const unsigned index = tail & ring.sq_mask;
+            io_uring_sqe& sqe = ring.sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = fd;
+            sqe.off = requests[i].offset;
+            sqe.addr = reinterpret_cast<uint64_t>(requests[i].out);
+            sqe.len = static_cast<uint32_t>(requests[i].size);
+            sqe.user_data = i;
+            ring.sq_array[index] = index;
+
+            ++tail;
+            ++in_flight;
+        }
+        __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+        const unsigned to_submit = tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        const long status = ::syscall(
+            __NR_io_uring_enter, ring.fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (status < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            if (error == 0) {
+                error = errno;
+            }
+
+            // Take back what the kernel didn't consume, and reap the rest.
+            const unsigned consumed = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+            __atomic_store_n(ring.sq_tail, consumed, __ATOMIC_RELEASE);
+            in_flight -= tail - consumed;
+        }
+
+        // Reap the completions.
+        unsigned cq_head = *ring.cq_head;
+        const unsigned cq_tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; cq_head != cq_tail; ++cq_head) {
+            const io_uring_cqe& cqe = ring.cqes[cq_head & ring.cq_mask];
+            const auto i = static_cast<size_t>(cqe.user_data);
+            ReadRequest& request = requests[i];
+            --in_flight;
+
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                queued.push_back(i);
+            } else if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+                // Kernels before 5.6 don't know `IORING_OP_READ`.
+                const int pread_error = _pread(fd, request);
+                if (pread_error != 0) {
+                    error = pread_error;
+                }
+            } else if (cqe.res < 0) {
+                error = -cqe.res;
+            } else if (cqe.res == 0) {
+                error = END_OF_FILE;
+            } else if (static_cast<size_t>(cqe.res) < request.size) {
+                // Short read, queue the rest.
+                request.offset += static_cast<uint64_t>(cqe.res);
+                request.out += cqe.res;
+                request.size -= static_cast<size_t>(cqe.res);
+                queued.push_back(i);
+            }
+        }
+        __atomic_store_n(ring.cq_head, cq_head, __ATOMIC_RELEASE);
+    }
+
+    // Only thrown once nothing is in flight, since the kernel writes to `out`.
+    if (error != 0) {
+        throw _readError(error);
+    }
+}
+
+#else
+
+void BatchReader::_readIoUring(int /* fd */, std::vector<ReadRequest>& /* requests */) {
+    LIBSONATA_THROW_IF_REACHED
+}
+
+#endif
+
+
+void _gatherIoUring(BatchReader& reader,
+                    const IoUringCache::Entry& entry,
+                    size_t element_size,
+                    const Selection::Ranges& xranges,
+                    const Selection::Range& yrange,
+                    char* out) {
+    const uint64_t offset = entry.layout.offset;
+    const size_t columns = entry.layout.dims[1];
+    const size_t out_columns = yrange[1] - yrange[0];
+    const size_t row_bytes = out_columns * element_size;
+
+    std::vector<ReadRequest> requests;
+    const auto add_request = [&](uint64_t row, size_t size) {
+        const uint64_t begin = offset + (row * columns + yrange[0]) * element_size;
+        for (size_t done = 0; done < size; done += MAX_REQUEST_SIZE) {
+            requests.push_back({begin + done, std::min(size - done, MAX_REQUEST_SIZE), out + done});
+        }
+        out += size;
+    };
+
+    for (const auto& range : xranges) {
+        if (out_columns == columns) {
+            // The rows are contiguous in both.
+            add_request(range[0], (range[1] - range[0]) * row_bytes);
+        } else {
+            for (uint64_t i = range[0]; i < range[1]; ++i) {
+                add_request(i, row_bytes);
+            }
+        }
+    }
+
+    reader.read(entry.file->fd(), std::move(requests));
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <bbp/sonata/selection.h>
+
+#include "read_contiguous.hpp"
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/// A file opened for reading.
+class DescriptorFile
+{
+  public:
+    /// Open `file` again, through the descriptor of HDF5.
+    ///
+    /// @throw SonataError if the file can't be opened
+    explicit DescriptorFile(const OpenFile& file);
+
+    DescriptorFile(const DescriptorFile&) = delete;
+    DescriptorFile& operator=(const DescriptorFile&) = delete;
+
+    ~DescriptorFile();
+
+    int fd() const noexcept {
+        return fd_;
+    }
+
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    /// The version of the file that was opened.
+    const FileVersion& version() const noexcept {
+        return version_;
+    }
+
+  private:
+    int fd_ = -1;
+    size_t size_ = 0;
+    FileVersion version_{};
+};
+
+/// Read `size` bytes at `offset` to `out`.
+struct ReadRequest {
+    uint64_t offset;
+    size_t size;
+    char* out;
+};
+
+/** Reads batches of requests with io_uring, or `pread` if it's unavailable.
+ *
+ * Up to `queue_depth` requests of a batch are in flight at the same time.
+ * Batches from different threads are read one after the other.
+ */
+class BatchReader
+{
+  public:
+    /// A `queue_depth` of `0` means always use `pread`.
+    explicit BatchReader(unsigned queue_depth);
+
+    BatchReader(const BatchReader&) = delete;
+    BatchReader& operator=(const BatchReader&) = delete;
+
+    ~BatchReader();
+
+    /// Was an io_uring set up?
+    bool usesIoUring() const noexcept;
+
+    /// Read all of `requests` from `fd`.
+    ///
+    /// @throw SonataError if a read fails, or the file ends early
+    void read(int fd, std::vector<ReadRequest> requests);
+
+  private:
+    struct Ring;
+
+    void _readIoUring(int fd, std::vector<ReadRequest>& requests);
+
+    std::unique_ptr<Ring> ring_;
+    std::mutex mutex_;
+};
+
+using IoUringCache = ContiguousCache<DescriptorFile>;
+
+/// Read the rows `xranges` and columns `yrange` with one batch of `reader`.
+void _gatherIoUring(BatchReader& reader,
+                    const IoUringCache::Entry& entry,
+                    size_t element_size,
+                    const Selection::Ranges& xranges,
+                    const Selection::Range& yrange,
+                    char* out);
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,78 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "read_mmap.hpp"
+
+#include <sys/mman.h>  // mmap, munmap
+#include <unistd.h>    // close
+
+#include <cerrno>
+#include <cstring>  // std::memcpy, std::strerror
+#include <fmt/format.h>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+MappedFile::MappedFile(const OpenFile& file)
+    : size_(file.size)
+    , version_(file.version) {
+    // The mapping stays valid after its descriptor is closed.
+    if (size_ > 0) {
+        const int fd = _reopenFile(file);
+        if (fd < 0) {
+            throw SonataError(fmt::format("Can't open a file to map: {}", std::strerror(errno)));
+        }
+        void* data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw SonataError(fmt::format("Can't map a file of {} bytes", size_));
+        }
+        data_ = static_cast<const char*>(data);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+
+void _gatherMapped(const MmapCache::Entry& entry,
+                   size_t element_size,
+                   const Selection::Ranges& xranges,
+                   const Selection::Range& yrange,
+                   char* out) {
+    const char* data = entry.file->data() + entry.layout.offset;
+    const size_t columns = entry.layout.dims[1];
+    const size_t out_columns = yrange[1] - yrange[0];
+    const size_t row_bytes = out_columns * element_size;
+
+    for (const auto& range : xranges) {
+        const char* src = data + (range[0] * columns + yrange[0]) * element_size;
+        const size_t n_rows = range[1] - range[0];
+
+        if (out_columns == columns) {
+            // The rows are contiguous in both.
+            std::memcpy(out, src, n_rows * row_bytes);
+            out += n_rows * row_bytes;
+        } else {
+            for (size_t i = 0; i < n_rows; ++i) {
+                std::memcpy(out, src, row_bytes);
+                src += columns * element_size;
+                out += row_bytes;
+            }
+        }
+    }
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <bbp/sonata/selection.h>
+
+#include "read_contiguous.hpp"
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/// A read-only memory mapping of a whole file.
+class MappedFile
+{
+  public:
+    /// Map `file`, opened again through the descriptor of HDF5.
+    ///
+    /// @throw SonataError if the file can't be mapped
+    explicit MappedFile(const OpenFile& file);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* data() const noexcept {
+        return data_;
+    }
+
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    /// The version of the file that was mapped.
+    const FileVersion& version() const noexcept {
+        return version_;
+    }
+
+  private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    FileVersion version_{};
+};
+
+using MmapCache = ContiguousCache<MappedFile>;
+
+/// Copy the rows `xranges` and columns `yrange` out of the mapping to `out`.
+void _gatherMapped(const MmapCache::Entry& entry,
+                   size_t element_size,
+                   const Selection::Ranges& xranges,
+                   const Selection::Range& yrange,
+                   char* out);
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -1,12 +1,19 @@
 #include <bbp/sonata/report_reader.h>
 #include <fmt/format.h>
 
-#include <algorithm>      // std::copy, std::find, std::lower_bound, std::upper_bound
-#include <iterator>       // std::advance, std::next
-#include <unordered_set>  // std::unordered_set
+#include <algorithm>  // std::copy, std::find_if, std::lower_bound, std::upper_bound
+#include <iterator>   // std::advance, std::next
+#include <limits>     // std::numeric_limits
+
+#include "tracing.hpp"
 
 constexpr double EPSILON = 1e-6;
 
+// Gap between IO blocks while fetching report data, in number of values
+// (Default: 64MB / 4 x GPFS blocks, at least 16MB / 1 x GPFS block)
+constexpr size_t DEFAULT_BLOCK_GAP_LIMIT = 16777216;
+constexpr size_t MIN_BLOCK_GAP_LIMIT = 4194304;
+
 HighFive::EnumType<bbp::sonata::SpikeReader::Population::Sorting> create_enum_sorting() {
     using bbp::sonata::SpikeReader;
     return HighFive::EnumType<SpikeReader::Population::Sorting>(
@@ -26,12 +33,20 @@ using bbp::sonata::Selection;
 using bbp::sonata::Spike;
 using bbp::sonata::Spikes;
 
+// `DEFAULT_BLOCK_GAP_LIMIT` scaled by `read_policy.min_gap_bytes` relative to its default,
+// and at least `MIN_BLOCK_GAP_LIMIT`.
+size_t blockGapLimit(const bbp::sonata::ReadPolicy& read_policy) {
+    const double scale = static_cast<double>(read_policy.min_gap_bytes) /
+                         static_cast<double>(bbp::sonata::ReadPolicy().min_gap_bytes);
+    const double limit = std::min(scale * static_cast<double>(DEFAULT_BLOCK_GAP_LIMIT),
+                                  static_cast<double>(std::numeric_limits<size_t>::max() / 2));
+    return std::max(MIN_BLOCK_GAP_LIMIT, static_cast<size_t>(limit));
+}
+
 void filterNodeIDUnsorted(Spikes& spikes, const Selection& node_ids) {
-    const auto values = node_ids.flatten();
-    const auto selected_values = std::unordered_set<Selection::Value>(values.begin(), values.end());
     const auto new_end =
-        std::remove_if(spikes.begin(), spikes.end(), [&selected_values](const Spike& spike) {
-            return selected_values.find(spike.first) == selected_values.end();
+        std::remove_if(spikes.begin(), spikes.end(), [&node_ids](const Spike& spike) {
+            return !node_ids.contains(spike.first);
         });
     spikes.erase(new_end, spikes.end());
 }
@@ -165,19 +180,13 @@ SpikeTimes SpikeReader::Population::getArrays(const nonstd::optional<Selection>&
                                               const nonstd::optional<double>& tstart,
                                               const nonstd::optional<double>& tstop) const {
     SpikeTimes filtered_spikes;
-    const auto& node_ids_selection = node_ids ? node_ids.value().flatten() : std::vector<NodeID>{};
     // Create arrays directly for required data based on conditions
     for (size_t i = 0; i < spike_times_.node_ids.size(); ++i) {
         const auto& node_id = spike_times_.node_ids[i];
         const auto& timestamp = spike_times_.timestamps[i];
 
-        // Check if node_id is found in node_ids_selection
-        bool node_ids_found = true;
-        if (node_ids) {
-            node_ids_found = std::find(node_ids_selection.begin(),
-                                       node_ids_selection.end(),
-                                       node_id) != node_ids_selection.end();
-        }
+        // Check if node_id is found in node_ids
+        bool node_ids_found = !node_ids || node_ids->contains(node_id);
 
         // Check if timestamp is within valid range
         bool valid_timestamp = (!tstart || timestamp >= tstart.value()) &&
@@ -248,7 +257,12 @@ void SpikeReader::Population::filterTimestamp(Spikes& spikes, double tstart, dou
 
 template <typename T>
 ReportReader<T>::ReportReader(const std::string& filename)
-    : file_(filename, HighFive::File::ReadOnly) { }
+    : ReportReader(filename, ReadPolicy()) { }
+
+template <typename T>
+ReportReader<T>::ReportReader(const std::string& filename, const ReadPolicy& read_policy)
+    : file_(filename, HighFive::File::ReadOnly)
+    , default_block_gap_limit_(blockGapLimit(read_policy)) { }
 
 template <typename T>
 std::vector<std::string> ReportReader<T>::getPopulationNames() const {
@@ -258,7 +272,8 @@ std::vector<std::string> ReportReader<T>::getPopulationNames() const {
 template <typename T>
 auto ReportReader<T>::openPopulation(const std::string& populationName) const -> const Population& {
     if (populations_.find(populationName) == populations_.end()) {
-        populations_.emplace(populationName, Population{file_, populationName});
+        populations_.emplace(populationName,
+                             Population{file_, populationName, default_block_gap_limit_});
     }
 
     return populations_.at(populationName);
@@ -266,9 +281,11 @@ auto ReportReader<T>::openPopulation(const std::string& populationName) const ->
 
 template <typename T>
 ReportReader<T>::Population::Population(const HighFive::File& file,
-                                        const std::string& populationName)
+                                        const std::string& populationName,
+                                        size_t default_block_gap_limit)
     : pop_group_(file.getGroup(std::string("/report/") + populationName))
-    , is_node_ids_sorted_(false) {
+    , is_node_ids_sorted_(false)
+    , default_block_gap_limit_(default_block_gap_limit) {
     const auto mapping_group = pop_group_.getGroup("mapping");
     mapping_group.getDataSet("node_ids").read(node_ids_);
 
@@ -356,12 +373,12 @@ ReportReader<T>::Population::getNodeIdElementLayout(
     std::vector<NodeID> concrete_node_ids;
     size_t element_ids_count = 0;
 
-    // Set the gap between IO blocks while fetching data (Default: 64MB / 4 x GPFS blocks)
-    const size_t block_gap_limit = _block_gap_limit.value_or(16777216);
-
-    if (block_gap_limit < 4194304) {
-        throw SonataError("block_gap_limit must be at least 4194304 (16MB / 1 x GPFS block)");
+    // Set the gap between IO blocks while fetching data
+    if (_block_gap_limit && *_block_gap_limit < MIN_BLOCK_GAP_LIMIT) {
+        throw SonataError(fmt::format("block_gap_limit must be at least {} (16MB / 1 x GPFS block)",
+                                      MIN_BLOCK_GAP_LIMIT));
     }
+    const size_t block_gap_limit = _block_gap_limit.value_or(default_block_gap_limit_);
 
     // Take all nodes if no selection is provided
     if (!node_ids) {
@@ -371,9 +388,7 @@ ReportReader<T>::Population::getNodeIdElementLayout(
         result.node_index = node_index_;
         element_ids_count = node_offsets_.back();
     } else if (!node_ids->empty()) {
-        const auto selected_node_ids = node_ids->flatten();
-
-        for (const auto node_id : selected_node_ids) {
+        for (const auto node_id : *node_ids) {
             const auto it = std::lower_bound(node_index_.begin(),
                                              node_index_.end(),
                                              node_id,
@@ -565,7 +580,9 @@ DataFrame<T> ReportReader<T>::Population::get(
             const auto min = std::get<0>(node_ranges[first_index]);
             const auto max = std::get<1>(node_ranges[last_index]);
 
+            detail::TraceScope trace("ReportReader::Population::get");
             dataset.select({timer_index, min}, {1, max - min}).read(buffer);
+            trace.setBytes(buffer.size() * sizeof(float));
 
             // Copy the values for each of the GIDs assigned into this block
             const auto buffer_start = buffer.begin();
@@ -2,7 +2,18 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>  // std::equal
+#include <cstring>    // std::memset
+#include <iterator>   // std::begin, std::end
+#include <mutex>      // std::call_once
+#include <numeric>    // std::iota
+#include <queue>      // std::priority_queue
+#include <random>
+#include <unordered_set>
+
+#include "compressed_selection.h"
 #include "read_bulk.hpp"
+#include "selection_kernels.h"
 
 namespace bbp {
 namespace sonata {
@@ -11,6 +22,20 @@ namespace detail {
 using Range = Selection::Range;
 using Ranges = Selection::Ranges;
 
+struct CanonicalRanges {
+    std::once_flag once;
+    Ranges ranges;
+};
+
+struct RangeIndex {
+    // `offsets[i]` is the position of the first id of `ranges()[i]`; one more
+    // entry for the total size.
+    std::vector<size_t> offsets;
+    // Indices of `ranges()` sorted by begin; empty if `ranges()` is canonical.
+    std::vector<size_t> by_begin;
+    bool overlapping = false;
+};
+
 void _checkRanges(const Ranges& ranges) {
     for (const auto& range : ranges) {
         if (std::get<0>(range) >= std::get<1>(range)) {
@@ -20,16 +45,89 @@ void _checkRanges(const Ranges& ranges) {
     }
 }
 
+/** Are the ranges sorted, non-overlapping and non-adjacent?
+ *
+ * Assumes that `_checkRanges` passed, i.e. that there are no empty ranges.
+ */
+bool _isCanonical(const Ranges& ranges) {
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        if (std::get<1>(ranges[i - 1]) >= std::get<0>(ranges[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Is it worth keeping `compressed` rather than its `n_ranges` ranges?
+ */
+bool _isWorthKeeping(const CompressedSelection& compressed, size_t n_ranges) {
+    return !compressed.empty() && 2 * compressed.sizeInBytes() <= n_ranges * sizeof(Range);
+}
+
 Ranges _sortAndMerge(const Ranges& ranges) {
     return bulk_read::sortAndMerge(ranges);
 }
 
-Selection intersection_(const Ranges& lhs, const Ranges& rhs) {
-    if (lhs.empty() || rhs.empty()) {
-        return Selection({});
+bool _contains(const Ranges& canonical, Selection::Value node_id) {
+    auto it = std::lower_bound(canonical.begin(),
+                               canonical.end(),
+                               node_id,
+                               [](const Range& range, Selection::Value v) {
+                                   return range[1] <= v;  // Keep searching if node_id >= end
+                               });
+
+    return it != canonical.end() && (*it)[0] <= node_id && node_id < (*it)[1];
+}
+
+// Serialized format, all integers are LEB128 varints unless noted otherwise:
+//
+//   magic "SEL" (3 bytes) | version (1 byte) | flags (1 byte) | number of ranges
+//   then per range: gap to the end of the previous range | size of the range - 1
+//
+// The gap of the first range is relative to 0. If `SERIALIZED_CANONICAL` is
+// set the gaps are unsigned, otherwise they're zigzag encoded.
+constexpr char SERIALIZED_MAGIC[] = {'S', 'E', 'L'};
+constexpr uint8_t SERIALIZED_VERSION = 1;
+constexpr uint8_t SERIALIZED_CANONICAL = 1;
+constexpr size_t SERIALIZED_HEADER_SIZE = sizeof(SERIALIZED_MAGIC) + 2;
+
+void _writeVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t _readVarint(const char*& it, const char* end) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (it == end) {
+            throw SonataError("Serialized Selection is truncated");
+        }
+        const auto byte = static_cast<uint8_t>(*(it++));
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw SonataError("Serialized Selection contains an invalid varint");
+}
+
+// Map signed deltas to unsigned values, small in magnitude to small.
+uint64_t _zigzag(uint64_t delta) {
+    return (delta << 1) ^ (0 - (delta >> 63));
+}
+
+uint64_t _unzigzag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+// Both `r0` and `r1` must be canonical.
+Ranges intersection_(const Ranges& r0, const Ranges& r1) {
+    if (r0.empty() || r1.empty()) {
+        return {};
     }
-    Ranges r0 = detail::_sortAndMerge(lhs);
-    Ranges r1 = detail::_sortAndMerge(rhs);
 
     auto it0 = r0.cbegin();
     auto it1 = r1.cbegin();
@@ -49,53 +147,636 @@ Selection intersection_(const Ranges& lhs, const Ranges& rhs) {
         }
     }
 
-    return Selection(std::move(ret));
+    return ret;
 }
 
-Selection union_(const Ranges& lhs, const Ranges& rhs) {
+/** The ids contained in at least `threshold` of the canonical `lists`.
+ *
+ * A k-way merge of the boundaries of all ranges, keeping count of how many
+ * lists contain the current id.
+ */
+Ranges _combineAll(const std::vector<const Ranges*>& lists, size_t threshold) {
+    using Boundary = std::pair<Selection::Value, size_t>;  // value, index into `lists`
+    std::priority_queue<Boundary, std::vector<Boundary>, std::greater<Boundary>> heap;
+
+    // `cursors[i]` is the next boundary of `lists[i]`, see `_combineRanges`.
+    std::vector<size_t> cursors(lists.size(), 0);
+    const auto boundary = [&lists](size_t i, size_t k) {
+        return (*lists[i])[k / 2][k % 2];
+    };
+
+    for (size_t i = 0; i < lists.size(); ++i) {
+        if (!lists[i]->empty()) {
+            heap.emplace(boundary(i, 0), i);
+        }
+    }
+
     Ranges ret;
-    std::copy(lhs.begin(), lhs.end(), std::back_inserter(ret));
-    std::copy(rhs.begin(), rhs.end(), std::back_inserter(ret));
-    ret = detail::_sortAndMerge(ret);
-    return Selection(std::move(ret));
+    size_t count = 0;
+    bool inside = false;
+    Selection::Value begin = 0;
+    while (!heap.empty()) {
+        const auto x = heap.top().first;
+        while (!heap.empty() && heap.top().first == x) {
+            const auto i = heap.top().second;
+            heap.pop();
+
+            const auto k = cursors[i]++;
+            if (k % 2 == 0) {
+                ++count;
+            } else {
+                --count;
+            }
+            if (cursors[i] < 2 * lists[i]->size()) {
+                heap.emplace(boundary(i, cursors[i]), i);
+            }
+        }
+
+        const bool keep = count >= threshold;
+        if (keep && !inside) {
+            begin = x;
+        } else if (!keep && inside) {
+            ret.push_back({begin, x});
+        }
+        inside = keep;
+    }
+
+    return ret;
+}
+
+// Both `lhs` and `rhs` must be canonical.
+Ranges union_(const Ranges& lhs, const Ranges& rhs) {
+    return _combineRanges(lhs, rhs, [](bool a, bool b) { return a || b; });
+}
+
+// Both `lhs` and `rhs` must be canonical.
+Ranges difference_(const Ranges& lhs, const Ranges& rhs) {
+    return _combineRanges(lhs, rhs, [](bool a, bool b) { return a && !b; });
+}
+
+// Both `lhs` and `rhs` must be canonical.
+Ranges symmetricDifference_(const Ranges& lhs, const Ranges& rhs) {
+    return _combineRanges(lhs, rhs, [](bool a, bool b) { return a != b; });
+}
+
+// A uniform integer in `[0, n)`, `n > 0`, with Lemire's bounded rejection: the high half of
+// the 128-bit product `x * n` of a 64-bit `x`, rejecting the `2^64 % n` lowest low halves.
+// Unlike `std::uniform_int_distribution`, the result is the same with every standard library.
+uint64_t _boundedRandom(std::mt19937_64& rng, uint64_t n) {
+    const auto multiply = [n](uint64_t x, uint64_t& low) {
+        const uint64_t x_lo = x & 0xffffffffu, x_hi = x >> 32;
+        const uint64_t n_lo = n & 0xffffffffu, n_hi = n >> 32;
+        const uint64_t lo_lo = x_lo * n_lo;
+        const uint64_t mid = (lo_lo >> 32) + (x_hi * n_lo & 0xffffffffu) + x_lo * n_hi;
+        low = (mid << 32) | (lo_lo & 0xffffffffu);
+        return x_hi * n_hi + (x_hi * n_lo >> 32) + (mid >> 32);
+    };
+
+    uint64_t low;
+    uint64_t high = multiply(rng(), low);
+    if (low < n) {
+        const uint64_t threshold = (0 - n) % n;
+        while (low < threshold) {
+            high = multiply(rng(), low);
+        }
+    }
+    return high;
 }
 }  // namespace detail
 
 Selection::Selection(Selection::Ranges ranges)
     : ranges_(std::move(ranges)) {
     detail::_checkRanges(ranges_);
+    if (!detail::_isCanonical(ranges_)) {
+        canonical_ = std::make_shared<detail::CanonicalRanges>();
+    }
+}
+
+Selection Selection::compacted(Ranges ranges) {
+    Selection ret(std::move(ranges));
+    if (ret.canonical_ || !detail::CompressedSelection::isWorthCompressing(ret.ranges_)) {
+        return ret;
+    }
+
+    auto compressed = std::make_shared<const detail::CompressedSelection>(
+        detail::CompressedSelection::fromRanges(ret.ranges_));
+    if (detail::_isWorthKeeping(*compressed, ret.ranges_.size())) {
+        ret.compressed_ = std::move(compressed);
+        ret.canonical_ = std::make_shared<detail::CanonicalRanges>();
+        Ranges().swap(ret.ranges_);
+    }
+    return ret;
+}
+
+Selection Selection::fromCompressed(
+    std::shared_ptr<const detail::CompressedSelection> compressed) {
+    Selection ret({});
+    if (detail::_isWorthKeeping(*compressed, compressed->rangeCount())) {
+        ret.compressed_ = std::move(compressed);
+        ret.canonical_ = std::make_shared<detail::CanonicalRanges>();
+    } else {
+        ret.ranges_ = compressed->toRanges();
+    }
+    return ret;
+}
+
+Selection::Selection(const Selection& other)
+    : ranges_(other.ranges_)
+    , canonical_(other.canonical_)
+    , compressed_(other.compressed_)
+    , index_(std::atomic_load(&other.index_)) { }
+
+Selection& Selection::operator=(const Selection& other) {
+    if (this != &other) {
+        ranges_ = other.ranges_;
+        canonical_ = other.canonical_;
+        compressed_ = other.compressed_;
+        std::atomic_store(&index_, std::atomic_load(&other.index_));
+    }
+    return *this;
+}
+
+std::shared_ptr<const detail::CompressedSelection> Selection::asCompressed() const {
+    if (compressed_) {
+        return compressed_;
+    }
+
+    const auto& ranges = canonicalRanges();
+    if (!detail::CompressedSelection::isWorthCompressing(ranges)) {
+        return nullptr;
+    }
+    return std::make_shared<const detail::CompressedSelection>(
+        detail::CompressedSelection::fromRanges(ranges));
+}
+
+
+const detail::RangeIndex& Selection::rangeIndex() const {
+    if (const auto index = std::atomic_load(&index_)) {
+        return *index;
+    }
+
+    const auto& ranges = this->ranges();
+    auto index = std::make_shared<detail::RangeIndex>();
+
+    auto& offsets = index->offsets;
+    offsets.resize(ranges.size() + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        offsets[i + 1] = offsets[i] + std::get<1>(ranges[i]) - std::get<0>(ranges[i]);
+    }
+
+    if (canonical_ && !compressed_) {
+        auto& by_begin = index->by_begin;
+        by_begin.resize(ranges.size());
+        std::iota(by_begin.begin(), by_begin.end(), size_t(0));
+        std::stable_sort(by_begin.begin(), by_begin.end(), [&ranges](size_t i, size_t j) {
+            return std::get<0>(ranges[i]) < std::get<0>(ranges[j]);
+        });
+        for (size_t i = 1; i < by_begin.size(); ++i) {
+            if (std::get<1>(ranges[by_begin[i - 1]]) > std::get<0>(ranges[by_begin[i]])) {
+                index->overlapping = true;
+                break;
+            }
+        }
+    }
+
+    // If another thread built the index meanwhile, use theirs; it's the same.
+    std::shared_ptr<const detail::RangeIndex> expected;
+    std::shared_ptr<const detail::RangeIndex> desired = std::move(index);
+    if (std::atomic_compare_exchange_strong(&index_, &expected, desired)) {
+        return *desired;
+    }
+    return *expected;
+}
+
+
+Selection::Value Selection::select(size_t k) const {
+    if (k >= flatSize()) {
+        throw SonataError(fmt::format("Position {} out of range, Selection has {} IDs",
+                                      k,
+                                      flatSize()));
+    }
+
+    const auto& offsets = rangeIndex().offsets;
+    const auto i = static_cast<size_t>(
+        std::distance(offsets.begin(), std::upper_bound(offsets.begin(), offsets.end(), k)) - 1);
+    return std::get<0>(ranges()[i]) + (k - offsets[i]);
+}
+
+
+size_t Selection::rank(Value node_id) const {
+    if (!empty()) {
+        const auto& index = rangeIndex();
+        const auto& ranges = this->ranges();
+        const auto inside = [&ranges, node_id](size_t i) {
+            return std::get<0>(ranges[i]) <= node_id && node_id < std::get<1>(ranges[i]);
+        };
+
+        if (index.overlapping) {
+            // The first range containing `node_id`, in order.
+            for (size_t i = 0; i < ranges.size(); ++i) {
+                if (inside(i)) {
+                    return index.offsets[i] + (node_id - std::get<0>(ranges[i]));
+                }
+            }
+        } else {
+            // The only range which could contain `node_id` is the last one
+            // starting at or before it.
+            const auto& by_begin = index.by_begin;
+            const auto n = ranges.size();
+            const auto begin_of = [&](size_t pos) {
+                return std::get<0>(ranges[by_begin.empty() ? pos : by_begin[pos]]);
+            };
+
+            size_t lo = 0;
+            size_t hi = n;
+            while (lo < hi) {
+                const size_t mid = lo + (hi - lo) / 2;
+                if (begin_of(mid) <= node_id) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            if (lo > 0) {
+                const auto i = by_begin.empty() ? lo - 1 : by_begin[lo - 1];
+                if (inside(i)) {
+                    return index.offsets[i] + (node_id - std::get<0>(ranges[i]));
+                }
+            }
+        }
+    }
+
+    throw SonataError(fmt::format("Node ID {} is not part of the Selection", node_id));
+}
+
+
+Selection Selection::slice(size_t begin, size_t end) const {
+    end = std::min(end, flatSize());
+    if (begin >= end) {
+        return Selection({});
+    }
+
+    const auto& offsets = rangeIndex().offsets;
+    const auto& ranges = this->ranges();
+    const auto first = static_cast<size_t>(
+        std::distance(offsets.begin(), std::upper_bound(offsets.begin(), offsets.end(), begin)) -
+        1);
+
+    Ranges ret;
+    for (size_t i = first; i < ranges.size() && offsets[i] < end; ++i) {
+        const auto b = std::max(begin, offsets[i]) - offsets[i];
+        const auto e = std::min(end, offsets[i + 1]) - offsets[i];
+        ret.push_back({std::get<0>(ranges[i]) + b, std::get<0>(ranges[i]) + e});
+    }
+    return Selection(std::move(ret));
+}
+
+
+Selection Selection::sample(size_t k, uint64_t seed) const {
+    const size_t size = flatSize();
+    if (k >= size) {
+        return *this;
+    }
+
+    // Robert Floyd's algorithm: `k` distinct positions in `[0, size)`.
+    std::mt19937_64 rng(seed);
+    std::unordered_set<size_t> chosen;
+    chosen.reserve(k);
+    for (size_t j = size - k; j < size; ++j) {
+        const auto t = static_cast<size_t>(detail::_boundedRandom(rng, j + 1));
+        if (!chosen.insert(t).second) {
+            chosen.insert(j);
+        }
+    }
+
+    std::vector<size_t> positions(chosen.begin(), chosen.end());
+    std::sort(positions.begin(), positions.end());
+
+    // Walk the ranges and the sorted positions together.
+    const auto& offsets = rangeIndex().offsets;
+    const auto& ranges = this->ranges();
+    Values values;
+    values.reserve(k);
+    size_t i = 0;
+    for (const auto position : positions) {
+        while (offsets[i + 1] <= position) {
+            ++i;
+        }
+        values.push_back(std::get<0>(ranges[i]) + (position - offsets[i]));
+    }
+    return fromValues(values);
+}
+
+
+std::vector<Selection> Selection::splitBySizes(const std::vector<size_t>& sizes) const {
+    std::vector<Selection> ret;
+    ret.reserve(sizes.size());
+
+    Ranges current;
+    size_t remaining = sizes.empty() ? 0 : sizes[0];
+    forEachRange([&](const Range& range) {
+        Value begin = std::get<0>(range);
+        while (begin < std::get<1>(range)) {
+            while (remaining == 0) {
+                ret.emplace_back(std::move(current));
+                current = Ranges();
+                remaining = sizes[ret.size()];
+            }
+
+            const Value end = std::min<Value>(std::get<1>(range), begin + remaining);
+            current.push_back({begin, end});
+            remaining -= end - begin;
+            begin = end;
+        }
+    });
+
+    while (ret.size() < sizes.size()) {
+        ret.emplace_back(std::move(current));
+        current = Ranges();
+    }
+    return ret;
+}
+
+
+std::vector<Selection> Selection::partition(size_t n) const {
+    if (n == 0) {
+        throw SonataError("Can't partition a Selection into 0 parts");
+    }
+
+    const size_t size = flatSize();
+    std::vector<size_t> sizes(n, size / n);
+    std::fill(sizes.begin(), sizes.begin() + static_cast<std::ptrdiff_t>(size % n), size / n + 1);
+    return splitBySizes(sizes);
+}
+
+
+std::vector<Selection> Selection::partition(size_t n, const std::vector<double>& costs) const {
+    if (n == 0) {
+        throw SonataError("Can't partition a Selection into 0 parts");
+    }
+    if (costs.size() != flatSize()) {
+        throw SonataError(
+            fmt::format("Expected {} costs, one per ID, got {}", flatSize(), costs.size()));
+    }
+
+    double total = 0.;
+    for (const auto cost : costs) {
+        if (!(cost >= 0.)) {
+            throw SonataError(fmt::format("Costs must be non-negative, got {}", cost));
+        }
+        total += cost;
+    }
+
+    if (total == 0.) {
+        return partition(n);
+    }
+
+    // An ID goes to the part which contains the midpoint of its cost; since
+    // the midpoints are increasing, the parts are consecutive.
+    std::vector<size_t> sizes(n, 0);
+    double before = 0.;
+    for (const auto cost : costs) {
+        const auto part = static_cast<size_t>(static_cast<double>(n) * (before + cost / 2) / total);
+        ++sizes[std::min(part, n - 1)];
+        before += cost;
+    }
+    return splitBySizes(sizes);
+}
+
+
+std::vector<Selection> Selection::split(size_t chunk_size) const {
+    if (chunk_size == 0) {
+        throw SonataError("Can't split a Selection into chunks of size 0");
+    }
+
+    const size_t size = flatSize();
+    std::vector<size_t> sizes(size / chunk_size, chunk_size);
+    if (size % chunk_size != 0) {
+        sizes.push_back(size % chunk_size);
+    }
+    return splitBySizes(sizes);
+}
+
+
+std::string Selection::serialize() const {
+    const bool canonical = !canonical_ || compressed_;
+
+    std::string body;
+    size_t n_ranges = 0;
+    Value previous_end = 0;
+    forEachRange([&](const Range& range) {
+        const Value gap = std::get<0>(range) - previous_end;
+        detail::_writeVarint(body, canonical ? gap : detail::_zigzag(gap));
+        detail::_writeVarint(body, std::get<1>(range) - std::get<0>(range) - 1);
+        previous_end = std::get<1>(range);
+        ++n_ranges;
+    });
+
+    std::string ret(detail::SERIALIZED_MAGIC, sizeof(detail::SERIALIZED_MAGIC));
+    ret.reserve(detail::SERIALIZED_HEADER_SIZE + 10 + body.size());
+    ret.push_back(static_cast<char>(detail::SERIALIZED_VERSION));
+    ret.push_back(static_cast<char>(canonical ? detail::SERIALIZED_CANONICAL : 0));
+    detail::_writeVarint(ret, n_ranges);
+    ret += body;
+    return ret;
+}
+
+
+Selection Selection::deserialize(const char* data, size_t size) {
+    if (size < detail::SERIALIZED_HEADER_SIZE ||
+        !std::equal(std::begin(detail::SERIALIZED_MAGIC), std::end(detail::SERIALIZED_MAGIC), data)) {
+        throw SonataError("Not a serialized Selection");
+    }
+
+    const auto version = static_cast<uint8_t>(data[sizeof(detail::SERIALIZED_MAGIC)]);
+    if (version != detail::SERIALIZED_VERSION) {
+        throw SonataError(fmt::format("Unsupported serialized Selection version: {}", version));
+    }
+    const auto flags = static_cast<uint8_t>(data[sizeof(detail::SERIALIZED_MAGIC) + 1]);
+    const bool canonical = (flags & detail::SERIALIZED_CANONICAL) != 0;
+
+    const char* it = data + detail::SERIALIZED_HEADER_SIZE;
+    const char* const end = data + size;
+    const auto n_ranges = detail::_readVarint(it, end);
+
+    Ranges ranges;
+    // Every range takes at least two bytes, don't trust `n_ranges` blindly.
+    ranges.reserve(std::min<uint64_t>(n_ranges, static_cast<uint64_t>(end - it) / 2));
+
+    Value previous_end = 0;
+    for (uint64_t i = 0; i < n_ranges; ++i) {
+        const auto gap = detail::_readVarint(it, end);
+        const auto size_minus_one = detail::_readVarint(it, end);
+
+        const Value begin = previous_end + (canonical ? gap : detail::_unzigzag(gap));
+        const Value range_end = begin + size_minus_one + 1;
+        if (range_end <= begin || (canonical && begin < previous_end)) {
+            throw SonataError("Serialized Selection contains an invalid range");
+        }
+        ranges.push_back({begin, range_end});
+        previous_end = range_end;
+    }
+
+    if (it != end) {
+        throw SonataError("Serialized Selection has trailing data");
+    }
+
+    return Selection(std::move(ranges));
+}
+
+
+Selection Selection::deserialize(const std::string& data) {
+    return deserialize(data.data(), data.size());
+}
+
+
+Selection Selection::unionAll(const std::vector<Selection>& selections) {
+    std::vector<const Ranges*> lists;
+    lists.reserve(selections.size());
+    for (const auto& selection : selections) {
+        if (!selection.empty()) {
+            lists.push_back(&selection.canonicalRanges());
+        }
+    }
+
+    if (lists.size() == 1) {
+        return compacted(*lists[0]);
+    }
+    return compacted(detail::_combineAll(lists, 1));
+}
+
+
+Selection Selection::intersectAll(const std::vector<Selection>& selections) {
+    std::vector<const Ranges*> lists;
+    lists.reserve(selections.size());
+    for (const auto& selection : selections) {
+        if (selection.empty()) {
+            return Selection({});
+        }
+        lists.push_back(&selection.canonicalRanges());
+    }
+
+    if (lists.empty()) {
+        return Selection({});
+    }
+    if (lists.size() == 1) {
+        return compacted(*lists[0]);
+    }
+    return compacted(detail::_combineAll(lists, lists.size()));
 }
 
 
 Selection Selection::fromValues(const Selection::Values& values) {
-    return fromValues(values.begin(), values.end());
+    return fromValues(values.data(), values.data() + values.size());
+}
+
+
+Selection Selection::fromValues(const Value* first, const Value* last) {
+    return compacted(detail::_rangesFromValues(first, last));
+}
+
+
+Selection Selection::fromMask(const uint8_t* mask, size_t size) {
+    return compacted(detail::_rangesFromMask(mask, size));
 }
 
 
 const Selection::Ranges& Selection::ranges() const {
+    if (compressed_) {
+        return canonicalRanges();
+    }
     return ranges_;
 }
 
 
+const Selection::Ranges& Selection::canonicalRanges() const {
+    if (!canonical_) {
+        return ranges_;
+    }
+
+    // Copies share `canonical_`, and have the same `ranges_` and `compressed_`,
+    // hence it doesn't matter which one computes it.
+    std::call_once(canonical_->once, [this]() {
+        canonical_->ranges = compressed_ ? compressed_->toRanges()
+                                         : detail::_sortAndMerge(ranges_);
+    });
+    return canonical_->ranges;
+}
+
+
+void Selection::forEachCompressedRange(const std::function<void(const Range&)>& f) const {
+    compressed_->forEachRange(f);
+}
+
+
+bool Selection::nextCompressedRange(const detail::CompressedSelection& compressed,
+                                    size_t& block,
+                                    uint32_t& position,
+                                    Range& range) {
+    return compressed.nextRange(block, position, range);
+}
+
+
+namespace {
+// Grow `values` in pieces which stay in cache between being zeroed by
+// `resize` and overwritten by the kernel, rather than in one go.
+void _appendLongRange(Selection::Values& values, const Selection::Range& range) {
+    constexpr Selection::Value piece_size = 4096;
+    for (auto begin = std::get<0>(range); begin < std::get<1>(range);) {
+        const Selection::Range piece{begin, std::min(std::get<1>(range), begin + piece_size)};
+        const size_t offset = values.size();
+        values.resize(offset + (std::get<1>(piece) - begin));
+        detail::_flattenRanges(&piece, &piece + 1, values.data() + offset);
+        begin = std::get<1>(piece);
+    }
+}
+}  // unnamed namespace
+
+
 Selection::Values Selection::flatten() const {
     Selection::Values result;
     result.reserve(flatSize());
-    for (const auto& range : ranges_) {
-        for (auto v = std::get<0>(range); v < std::get<1>(range); ++v) {
-            result.emplace_back(v);
+    forEachRange([&result](const Range& range) {
+        if (std::get<1>(range) - std::get<0>(range) < 16) {
+            for (auto v = std::get<0>(range); v < std::get<1>(range); ++v) {
+                result.emplace_back(v);
+            }
+        } else {
+            _appendLongRange(result, range);
         }
-    }
+    });
     return result;
 }
 
 
+void Selection::toMask(uint8_t* mask, size_t size) const {
+    std::memset(mask, 0, size);
+    forEachRange([mask, size](const Range& range) {
+        if (std::get<1>(range) > size) {
+            throw SonataError(fmt::format("Selection has ID {}, mask has size {}",
+                                          std::get<1>(range) - 1,
+                                          size));
+        }
+        std::memset(mask + std::get<0>(range), 1, std::get<1>(range) - std::get<0>(range));
+    });
+}
+
+
 size_t Selection::flatSize() const {
+    if (compressed_) {
+        return compressed_->flatSize();
+    }
     return bulk_read::detail::flatSize(ranges_);
 }
 
 
 bool Selection::empty() const {
-    return ranges().empty();
+    if (compressed_) {
+        return compressed_->empty();
+    }
+    return ranges_.empty();
 }
 
 
@@ -110,23 +791,100 @@ bool operator!=(const Selection& lhs, const Selection& rhs) {
 
 
 Selection operator&(const Selection& lhs, const Selection& rhs) {
-    return detail::intersection_(lhs.ranges(), rhs.ranges());
+    const auto c0 = lhs.asCompressed();
+    const auto c1 = c0 ? rhs.asCompressed() : nullptr;
+    if (c0 && c1) {
+        return Selection::fromCompressed(
+            std::make_shared<const detail::CompressedSelection>(*c0 & *c1));
+    }
+    return Selection::compacted(
+        detail::intersection_(lhs.canonicalRanges(), rhs.canonicalRanges()));
 }
 
 
 Selection operator|(const Selection& lhs, const Selection& rhs) {
-    return detail::union_(lhs.ranges(), rhs.ranges());
+    const auto c0 = lhs.asCompressed();
+    const auto c1 = c0 ? rhs.asCompressed() : nullptr;
+    if (c0 && c1) {
+        return Selection::fromCompressed(
+            std::make_shared<const detail::CompressedSelection>(*c0 | *c1));
+    }
+    return Selection::compacted(
+        detail::union_(lhs.canonicalRanges(), rhs.canonicalRanges()));
+}
+
+
+Selection operator-(const Selection& lhs, const Selection& rhs) {
+    const auto c0 = lhs.asCompressed();
+    const auto c1 = c0 ? rhs.asCompressed() : nullptr;
+    if (c0 && c1) {
+        return Selection::fromCompressed(
+            std::make_shared<const detail::CompressedSelection>(*c0 - *c1));
+    }
+    return Selection::compacted(
+        detail::difference_(lhs.canonicalRanges(), rhs.canonicalRanges()));
+}
+
+
+Selection operator^(const Selection& lhs, const Selection& rhs) {
+    const auto c0 = lhs.asCompressed();
+    const auto c1 = c0 ? rhs.asCompressed() : nullptr;
+    if (c0 && c1) {
+        return Selection::fromCompressed(
+            std::make_shared<const detail::CompressedSelection>(*c0 ^ *c1));
+    }
+    return Selection::compacted(
+        detail::symmetricDifference_(lhs.canonicalRanges(), rhs.canonicalRanges()));
+}
+
+
+Selection Selection::complement(Value universe_size) const {
+    const Ranges universe = universe_size > 0 ? Ranges{{0, universe_size}} : Ranges{};
+
+    if (const auto compressed = asCompressed()) {
+        return fromCompressed(std::make_shared<const detail::CompressedSelection>(
+            detail::CompressedSelection::fromRanges(universe) - *compressed));
+    }
+    return compacted(detail::difference_(universe, canonicalRanges()));
 }
 
 bool Selection::contains(Value node_id) const {
-    Ranges ret;
-    std::copy(ranges_.begin(), ranges_.end(), std::back_inserter(ret));
-    ret = detail::_sortAndMerge(ret);
-    auto it = std::lower_bound(ret.begin(), ret.end(), node_id, [](const Range& range, Value v) {
-        return range[1] <= v;  // Keep searching if node_id >= end
-    });
+    if (compressed_) {
+        return compressed_->contains(node_id);
+    }
+    return detail::_contains(canonicalRanges(), node_id);
+}
+
+std::vector<bool> Selection::containsMany(const Values& node_ids) const {
+    std::vector<bool> mask(node_ids.size(), false);
+
+    if (compressed_) {
+        for (size_t i = 0; i < node_ids.size(); ++i) {
+            mask[i] = compressed_->contains(node_ids[i]);
+        }
+        return mask;
+    }
+
+    const auto& ranges = canonicalRanges();
+    if (!std::is_sorted(node_ids.begin(), node_ids.end())) {
+        for (size_t i = 0; i < node_ids.size(); ++i) {
+            mask[i] = detail::_contains(ranges, node_ids[i]);
+        }
+        return mask;
+    }
 
-    return it != ret.end() && (*it)[0] <= node_id && node_id < (*it)[1];
+    auto it = ranges.cbegin();
+    for (size_t i = 0; i < node_ids.size(); ++i) {
+        const auto node_id = node_ids[i];
+        while (it != ranges.cend() && std::get<1>(*it) <= node_id) {
+            ++it;
+        }
+        if (it == ranges.cend()) {
+            break;
+        }
+        mask[i] = std::get<0>(*it) <= node_id;
+    }
+    return mask;
 }
 
 }  // namespace sonata
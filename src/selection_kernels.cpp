@@ -0,0 +1,307 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "selection_kernels.h"
+
+#include <cstring>  // memcpy
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SONATA_SIMD_DISPATCH 1
+#include <immintrin.h>
+#else
+#define SONATA_SIMD_DISPATCH 0
+#endif
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+namespace {
+
+using Value = Selection::Value;
+using Range = Selection::Range;
+using Ranges = Selection::Ranges;
+
+// Append the runs of `[it, last)`, the current run starts at `begin`.
+inline void _appendTail(Ranges& ranges, Value begin, const Value* it, const Value* last) {
+    for (; last - it > 1; ++it) {
+        if (it[1] != it[0] + 1) {
+            ranges.push_back({begin, it[0] + 1});
+            begin = it[1];
+        }
+    }
+    ranges.push_back({begin, *it + 1});
+}
+
+Ranges _rangesFromValuesScalar(const Value* first, const Value* last) {
+    Ranges ranges;
+    if (first == last) {
+        return ranges;
+    }
+
+    _appendTail(ranges, *first, first, last);
+    return ranges;
+}
+
+void _flattenRangesScalar(const Range* first, const Range* last, Value* out) {
+    for (; first != last; ++first) {
+        const Value begin = std::get<0>(*first);
+        const size_t size = std::get<1>(*first) - begin;
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = begin + i;
+        }
+        out += size;
+    }
+}
+
+// The first byte of `[it, last)` which is non-zero if `set`, zero otherwise.
+const uint8_t* _findByteScalar(const uint8_t* it, const uint8_t* last, bool set) {
+    // Skip whole words while there's nothing to find.
+    constexpr uint64_t ones = 0x0101010101010101;
+    constexpr uint64_t highs = 0x8080808080808080;
+    for (; last - it >= 8; it += 8) {
+        uint64_t word;
+        std::memcpy(&word, it, sizeof(word));
+        const bool has_zero = ((word - ones) & ~word & highs) != 0;
+        if (set ? word != 0 : has_zero) {
+            break;
+        }
+    }
+    for (; it != last; ++it) {
+        if ((*it != 0) == set) {
+            return it;
+        }
+    }
+    return last;
+}
+
+template <class FindByte>
+Ranges _rangesFromMask(const uint8_t* mask, size_t size, FindByte find_byte) {
+    Ranges ranges;
+    const uint8_t* const last = mask + size;
+    const uint8_t* it = find_byte(mask, last, true);
+    while (it != last) {
+        const uint8_t* const end = find_byte(it, last, false);
+        ranges.push_back({static_cast<Value>(it - mask), static_cast<Value>(end - mask)});
+        it = find_byte(end, last, true);
+    }
+    return ranges;
+}
+
+#if SONATA_SIMD_DISPATCH
+
+// Run boundaries are found a block at a time: `mask` has a bit set for every
+// `i` such that `v[i + 1] != v[i] + 1`, i.e. where a run ends.
+
+// Append the runs ending in a block starting at `it`, given by `mask`.
+inline void _appendRunEnds(Ranges& ranges, Value& begin, const Value* it, uint32_t mask) {
+    while (mask != 0) {
+        const int i = __builtin_ctz(mask);
+        ranges.push_back({begin, it[i] + 1});
+        begin = it[i + 1];
+        mask &= mask - 1;
+    }
+}
+
+__attribute__((target("avx2"))) Ranges _rangesFromValuesAvx2(const Value* first,
+                                                             const Value* last) {
+    Ranges ranges;
+    if (first == last) {
+        return ranges;
+    }
+
+    Value begin = *first;
+    const Value* it = first;
+
+    const __m256i one = _mm256_set1_epi64x(1);
+    // Needs `it[4]`, the first value of the next block.
+    for (; last - it > 4; it += 4) {
+        const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+        const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it + 1));
+        const __m256i consecutive = _mm256_cmpeq_epi64(next, _mm256_add_epi64(values, one));
+        const int equal = _mm256_movemask_pd(_mm256_castsi256_pd(consecutive));
+        const auto mask = static_cast<uint32_t>(~equal & 0xf);
+        _appendRunEnds(ranges, begin, it, mask);
+    }
+
+    _appendTail(ranges, begin, it, last);
+    return ranges;
+}
+
+__attribute__((target("avx2"))) void _flattenRangesAvx2(const Range* first,
+                                                        const Range* last,
+                                                        Value* out) {
+    const __m256i iota = _mm256_set_epi64x(3, 2, 1, 0);
+    const __m256i step = _mm256_set1_epi64x(4);
+    for (; first != last; ++first) {
+        Value value = std::get<0>(*first);
+        const Value end = std::get<1>(*first);
+
+        __m256i ids = _mm256_add_epi64(_mm256_set1_epi64x(static_cast<long long>(value)), iota);
+        for (; end - value >= 4; value += 4, out += 4) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), ids);
+            ids = _mm256_add_epi64(ids, step);
+        }
+        for (; value < end; ++value) {
+            *(out++) = value;
+        }
+    }
+}
+
+__attribute__((target("avx512f"))) Ranges _rangesFromValuesAvx512(const Value* first,
+                                                                  const Value* last) {
+    Ranges ranges;
+    if (first == last) {
+        return ranges;
+    }
+
+    Value begin = *first;
+    const Value* it = first;
+
+    const __m512i one = _mm512_set1_epi64(1);
+    // Needs `it[8]`, the first value of the next block.
+    for (; last - it > 8; it += 8) {
+        const __m512i values = _mm512_loadu_si512(it);
+        const __m512i next = _mm512_loadu_si512(it + 1);
+        const auto mask = static_cast<uint32_t>(
+            _mm512_cmpneq_epi64_mask(next, _mm512_add_epi64(values, one)));
+        _appendRunEnds(ranges, begin, it, mask);
+    }
+
+    _appendTail(ranges, begin, it, last);
+    return ranges;
+}
+
+__attribute__((target("avx512f"))) void _flattenRangesAvx512(const Range* first,
+                                                             const Range* last,
+                                                             Value* out) {
+    const __m512i iota = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m512i step = _mm512_set1_epi64(8);
+    for (; first != last; ++first) {
+        Value value = std::get<0>(*first);
+        const Value end = std::get<1>(*first);
+
+        __m512i ids = _mm512_add_epi64(_mm512_set1_epi64(static_cast<long long>(value)), iota);
+        for (; end - value >= 8; value += 8, out += 8) {
+            _mm512_storeu_si512(out, ids);
+            ids = _mm512_add_epi64(ids, step);
+        }
+        for (; value < end; ++value) {
+            *(out++) = value;
+        }
+    }
+}
+
+// Looks at 32 bytes at a time; there is no AVX-512 version, since byte
+// comparisons need AVX-512BW, and any CPU with AVX-512 has AVX2.
+__attribute__((target("avx2"))) const uint8_t* _findByteAvx2(const uint8_t* it,
+                                                            const uint8_t* last,
+                                                            bool set) {
+    const __m256i zero = _mm256_setzero_si256();
+    for (; last - it >= 32; it += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+        const auto is_zero = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero)));
+        const uint32_t found = set ? ~is_zero : is_zero;
+        if (found != 0) {
+            return it + __builtin_ctz(found);
+        }
+    }
+    return _findByteScalar(it, last, set);
+}
+
+SimdLevel _detectSimdLevel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SimdLevel::avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::avx2;
+    }
+    return SimdLevel::scalar;
+}
+
+#else
+
+SimdLevel _detectSimdLevel() {
+    return SimdLevel::scalar;
+}
+
+#endif  // SONATA_SIMD_DISPATCH
+
+}  // unnamed namespace
+
+
+SimdLevel _simdLevel() {
+    static const SimdLevel level = _detectSimdLevel();
+    return level;
+}
+
+
+Ranges _rangesFromValues(SimdLevel level, const Value* first, const Value* last) {
+    switch (level) {
+#if SONATA_SIMD_DISPATCH
+    case SimdLevel::avx512:
+        return _rangesFromValuesAvx512(first, last);
+    case SimdLevel::avx2:
+        return _rangesFromValuesAvx2(first, last);
+#endif
+    default:
+        return _rangesFromValuesScalar(first, last);
+    }
+}
+
+
+void _flattenRanges(SimdLevel level, const Range* first, const Range* last, Value* out) {
+    switch (level) {
+#if SONATA_SIMD_DISPATCH
+    case SimdLevel::avx512:
+        _flattenRangesAvx512(first, last, out);
+        return;
+    case SimdLevel::avx2:
+        _flattenRangesAvx2(first, last, out);
+        return;
+#endif
+    default:
+        _flattenRangesScalar(first, last, out);
+        return;
+    }
+}
+
+
+Ranges _rangesFromMask(SimdLevel level, const uint8_t* mask, size_t size) {
+    switch (level) {
+#if SONATA_SIMD_DISPATCH
+    case SimdLevel::avx512:
+    case SimdLevel::avx2:
+        return _rangesFromMask(mask, size, _findByteAvx2);
+#endif
+    default:
+        return _rangesFromMask(mask, size, _findByteScalar);
+    }
+}
+
+
+Ranges _rangesFromValues(const Value* first, const Value* last) {
+    return _rangesFromValues(_simdLevel(), first, last);
+}
+
+
+void _flattenRanges(const Range* first, const Range* last, Value* out) {
+    _flattenRanges(_simdLevel(), first, last, out);
+}
+
+
+Ranges _rangesFromMask(const uint8_t* mask, size_t size) {
+    return _rangesFromMask(_simdLevel(), mask, size);
+}
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,58 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#pragma once
+
+#include <bbp/sonata/selection.h>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/** Kernels for converting between IDs and ranges.
+ *
+ * On x86 with GCC or Clang, there are AVX2 and AVX-512 versions next to the
+ * scalar ones; the best one supported by the CPU is picked at runtime.
+ */
+
+/** The ranges of consecutive values of `[first, last)`, in order.
+ *
+ * Same as `Selection::fromValues(first, last).ranges()`.
+ */
+Selection::Ranges _rangesFromValues(const Selection::Value* first, const Selection::Value* last);
+
+/** Write the IDs of the ranges `[first, last)` to `out`.
+ *
+ * `out` must have room for all of them.
+ */
+void _flattenRanges(const Selection::Range* first,
+                    const Selection::Range* last,
+                    Selection::Value* out);
+
+/// The ranges of indices of the non-zero bytes of `mask`, in order.
+Selection::Ranges _rangesFromMask(const uint8_t* mask, size_t size);
+
+enum class SimdLevel { scalar, avx2, avx512 };
+
+/// The instruction set used by the kernels.
+SimdLevel _simdLevel();
+
+/// The kernels for a given level; only valid if the CPU supports it.
+Selection::Ranges _rangesFromValues(SimdLevel level,
+                                    const Selection::Value* first,
+                                    const Selection::Value* last);
+void _flattenRanges(SimdLevel level,
+                    const Selection::Range* first,
+                    const Selection::Range* last,
+                    Selection::Value* out);
+Selection::Ranges _rangesFromMask(SimdLevel level, const uint8_t* mask, size_t size);
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
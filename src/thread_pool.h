@@ -0,0 +1,71 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/** A fixed number of worker threads, running tasks in submission order.
+ *
+ * Tasks must not call HDF5; they run concurrently with the thread that
+ * submitted them, which might hold `hdf5Mutex`. Unless, like the I/O thread of
+ * a pipelined `bulkRead`, the submitting thread doesn't call HDF5 until they're
+ * done.
+ */
+class ThreadPool
+{
+  public:
+    /// Start `n_threads` workers; `0` means one per hardware thread.
+    explicit ThreadPool(size_t n_threads = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Finishes the queued tasks, then joins the workers.
+    ~ThreadPool();
+
+    /// Number of worker threads.
+    size_t size() const noexcept {
+        return workers_.size();
+    }
+
+    /// Queue `task`; the future rethrows any exception it throws.
+    std::future<void> submit(std::function<void()> task);
+
+  private:
+    void _work();
+
+    std::vector<std::thread> workers_;
+    std::queue<std::packaged_task<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
+
+/** Wait for all `futures`, then rethrow the first exception, if any.
+ *
+ * Unlike calling `get` in a loop, this never returns while a task is still
+ * running, so tasks may refer to the caller's locals.
+ */
+void _waitAll(std::vector<std::future<void>>& futures);
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
@@ -0,0 +1,191 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "tracing.hpp"
+
+#include <unistd.h>  // getpid
+
+#include <chrono>
+#include <cstdlib>  // std::getenv
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <bbp/sonata/common.h>  // SonataError
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+std::atomic<uint64_t> _traceSession{0};
+
+namespace {
+
+struct TraceEvent {
+    char phase;
+    const char* name;
+    std::string label;
+    uint64_t bytes;
+    uint64_t thread_id;
+    double timestamp_us;
+};
+
+/// Small, stable IDs for the threads, in the order they record their first event.
+uint64_t _threadId() {
+    static std::atomic<uint64_t> next_id{1};
+    thread_local const uint64_t id = next_id++;
+    return id;
+}
+
+class Tracer
+{
+  public:
+    ~Tracer() {
+        // The trace of a process that exits while recording is written now.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (_traceSession != 0) {
+            try {
+                _write();
+            } catch (...) {
+            }
+        }
+    }
+
+    void start(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (_traceSession != 0) {
+            _write();
+        }
+        path_ = path;
+        events_.clear();
+        start_ = std::chrono::steady_clock::now();
+        _traceSession = ++last_session_;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (_traceSession == 0) {
+            return;
+        }
+        _traceSession = 0;
+        _write();
+        events_.clear();
+    }
+
+    void record(uint64_t session,
+                char phase,
+                const char* name,
+                const std::string* label,
+                uint64_t bytes) {
+        const auto now = std::chrono::steady_clock::now();
+        const uint64_t thread_id = _threadId();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Events of operations that started in another trace are dropped.
+        if (_traceSession != session) {
+            return;
+        }
+        events_.push_back({phase,
+                           name,
+                           label != nullptr ? *label : std::string(),
+                           bytes,
+                           thread_id,
+                           std::chrono::duration<double, std::micro>(now - start_).count()});
+    }
+
+  private:
+    void _write() const {
+        std::ofstream file(path_);
+        if (!file) {
+            throw SonataError(fmt::format("Can't write the trace to '{}'", path_));
+        }
+
+        const auto pid = static_cast<int64_t>(::getpid());
+        file << "{\"traceEvents\":[";
+        for (size_t i = 0; i < events_.size(); ++i) {
+            const auto& event = events_[i];
+            file << (i == 0 ? "\n" : ",\n")
+                 << fmt::format(R"({{"name":"{}","cat":"sonata","ph":"{}","ts":{:.3f},)"
+                                R"("pid":{},"tid":{})",
+                                event.name,
+                                event.phase,
+                                event.timestamp_us,
+                                pid,
+                                event.thread_id);
+            if (event.phase == 'B' && !event.label.empty()) {
+                file << R"(,"args":{"label":)" << nlohmann::json(event.label).dump() << "}";
+            } else if (event.phase == 'E' && event.bytes != 0) {
+                file << R"(,"args":{"bytes":)" << event.bytes << "}";
+            }
+            file << "}";
+        }
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        if (!file) {
+            throw SonataError(fmt::format("Can't write the trace to '{}'", path_));
+        }
+    }
+
+    std::mutex mutex_;
+    std::string path_;
+    uint64_t last_session_ = 0;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<TraceEvent> events_;
+};
+
+Tracer& _tracer() {
+    static Tracer tracer;
+    return tracer;
+}
+
+/// Starts tracing when the library is loaded, if `SONATA_TRACE` is set.
+struct TracingFromEnvironment {
+    TracingFromEnvironment() {
+        const char* path = std::getenv(TRACE_ENVIRONMENT_VARIABLE);
+        if (path != nullptr && *path != '\0') {
+            _tracer().start(path);
+        }
+    }
+} _tracingFromEnvironment;
+
+}  // unnamed namespace
+
+
+void TraceScope::_begin(const std::string* label) {
+    _tracer().record(session_, 'B', name_, label, 0);
+}
+
+void TraceScope::_end() noexcept {
+    try {
+        _tracer().record(session_, 'E', name_, nullptr, bytes_);
+    } catch (...) {
+        // A missing end event isn't worth failing the operation.
+    }
+}
+
+}  // namespace detail
+
+
+void startTracing(const std::string& path) {
+    detail::_tracer().start(path);
+}
+
+void stopTracing() {
+    detail::_tracer().stop();
+}
+
+bool isTracing() {
+    return detail::_traceSession != 0;
+}
+
+}  // namespace sonata
+}  // namespace bbp
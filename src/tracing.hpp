@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <bbp/sonata/tracing.h>
+
+namespace bbp {
+namespace sonata {
+namespace detail {
+
+/// Non-zero while a trace is recorded; every trace has its own number.
+extern std::atomic<uint64_t> _traceSession;
+
+/** Record the begin and end events of an operation, if a trace is recorded.
+ *
+ * The begin event is recorded by the constructor, the end event by the
+ * destructor; together with the bytes set by `setBytes`. `name` must be a
+ * string literal, `label` tells operations of the same name apart, e.g. the
+ * name of an attribute. If no trace is recorded, nothing is copied.
+ */
+class TraceScope
+{
+  public:
+    explicit TraceScope(const char* name)
+        : session_(_traceSession.load(std::memory_order_relaxed))
+        , name_(name) {
+        if (session_ != 0) {
+            _begin(nullptr);
+        }
+    }
+
+    TraceScope(const char* name, const std::string& label)
+        : session_(_traceSession.load(std::memory_order_relaxed))
+        , name_(name) {
+        if (session_ != 0) {
+            _begin(&label);
+        }
+    }
+
+    ~TraceScope() {
+        if (session_ != 0) {
+            _end();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    void setBytes(uint64_t bytes) noexcept {
+        bytes_ = bytes;
+    }
+
+  private:
+    void _begin(const std::string* label);
+    void _end() noexcept;
+
+    uint64_t session_;
+    const char* name_;
+    uint64_t bytes_ = 0;
+};
+
+}  // namespace detail
+}  // namespace sonata
+}  // namespace bbp
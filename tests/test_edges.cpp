@@ -89,6 +89,28 @@ TEST_CASE("EdgePopulation", "[edges]") {
 }
 
 
+TEST_CASE("EdgePopulationUnionHyperslab", "[edges]") {
+    // the index datasets are two-dimensional, `@source_node` one-dimensional
+    const EdgePopulation merged("./data/edges1.h5",
+                                "",
+                                "edges-AB",
+                                Hdf5Reader(Hdf5ReadStrategy::mergedBlocks));
+    const EdgePopulation population("./data/edges1.h5",
+                                    "",
+                                    "edges-AB",
+                                    Hdf5Reader(Hdf5ReadStrategy::unionHyperslab));
+
+    const auto selection = Selection({{0, 3}, {4, 5}});
+    CHECK(population.sourceNodeIDs(selection) == std::vector<NodeID>{1, 1, 2, 3});
+    CHECK(population.sourceNodeIDs(selection) == merged.sourceNodeIDs(selection));
+    CHECK(population.sourceNodeIDs(Selection({})).empty());
+
+    CHECK(population.afferentEdges({1, 2}) == Selection({{0, 4}, {5, 6}}));
+    CHECK(population.efferentEdges({1, 3}) == Selection({{0, 2}, {4, 6}}));
+    CHECK(population.afferentEdges({}).empty());
+}
+
+
 TEST_CASE("EdgePopulationSelectAll", "[base]") {
     const EdgePopulation population("./data/edges1.h5", "", "edges-AB");
     CHECK(population.selectAll().flatSize() == 6);
@@ -0,0 +1,530 @@
+#include <catch2/catch.hpp>
+
+#include <bbp/sonata/hdf5_reader.h>
+#include <bbp/sonata/nodes.h>
+
+#include <sys/resource.h>  // setrlimit
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <numeric>  // std::accumulate
+#include <string>
+#include <vector>
+
+
+using namespace bbp::sonata;
+
+
+namespace {
+
+// Datasets of 100 rows, compressed in chunks of 7 rows, such that merged
+// blocks would straddle chunk boundaries; one that's shuffled too; one with a
+// chunk per column; tables of 6 columns; and contiguous ones.
+const char* const CHUNKED_FILE_PATH = "./data/chunked.h5.tmp";
+
+void writeChunkedFile(const std::string& path) {
+    HighFive::File file(path, HighFive::File::Truncate);
+
+    std::vector<uint64_t> values(100);
+    std::vector<std::array<uint64_t, 2>> pairs(100);
+    for (uint64_t i = 0; i < values.size(); ++i) {
+        values[i] = 3 * i;
+        pairs[i] = {i, i + 1};
+    }
+
+    HighFive::DataSetCreateProps props_1d;
+    props_1d.add(HighFive::Chunking({7}));
+    props_1d.add(HighFive::Deflate(4));
+    file.createDataSet<uint64_t>("values", HighFive::DataSpace::From(values), props_1d)
+        .write(values);
+
+    HighFive::DataSetCreateProps props_shuffled;
+    props_shuffled.add(HighFive::Chunking({9}));
+    props_shuffled.add(HighFive::Shuffle());
+    props_shuffled.add(HighFive::Deflate(4));
+    file.createDataSet<uint64_t>("shuffled", HighFive::DataSpace::From(values), props_shuffled)
+        .write(values);
+
+    file.createDataSet<uint64_t>("contiguous", HighFive::DataSpace::From(values)).write(values);
+    file.createDataSet<uint64_t>("contiguous_pairs", HighFive::DataSpace::From(pairs))
+        .write(pairs);
+
+    HighFive::DataSetCreateProps props_2d;
+    props_2d.add(HighFive::Chunking({7, 2}));
+    props_2d.add(HighFive::Deflate(4));
+    file.createDataSet<uint64_t>("pairs", HighFive::DataSpace::From(pairs), props_2d)
+        .write(pairs);
+
+    HighFive::DataSetCreateProps props_columns;
+    props_columns.add(HighFive::Chunking({5, 1}));
+    props_columns.add(HighFive::Deflate(4));
+    file.createDataSet<uint64_t>("columns", HighFive::DataSpace::From(pairs), props_columns)
+        .write(pairs);
+
+    std::vector<std::array<uint64_t, 6>> table(100);
+    for (uint64_t i = 0; i < table.size(); ++i) {
+        for (uint64_t j = 0; j < 6; ++j) {
+            table[i][j] = 10 * i + j;
+        }
+    }
+
+    HighFive::DataSetCreateProps props_table;
+    props_table.add(HighFive::Chunking({7, 4}));
+    props_table.add(HighFive::Deflate(4));
+    file.createDataSet<uint64_t>("table", HighFive::DataSpace::From(table), props_table)
+        .write(table);
+    file.createDataSet<uint64_t>("contiguous_table", HighFive::DataSpace::From(table))
+        .write(table);
+}
+
+// A plugin written against the interface that only read `std::array<uint64_t, 2>`
+// from two-dimensional datasets; it reads like the default plugin, and counts
+// the reads of pairs.
+template <class T>
+class LegacyRead1D: virtual public Hdf5PluginRead1DInterface<T>
+{
+  public:
+    std::vector<T> readSelection(const HighFive::DataSet& dset,
+                                 const Selection& selection) const override {
+        return Hdf5Reader().readSelection<T>(dset, selection);
+    }
+};
+
+using Pair = std::array<uint64_t, 2>;
+
+class LegacyRead2DPairs: virtual public Hdf5PluginRead2DInterface<Pair>
+{
+  public:
+    std::vector<Pair> readSelection(const HighFive::DataSet& dset,
+                                    const Selection& xsel,
+                                    const Selection& ysel) const override {
+        ++pair_reads;
+        return Hdf5Reader().readSelection<Pair>(dset, xsel, ysel);
+    }
+
+    mutable size_t pair_reads = 0;
+};
+
+template <class Types>
+class LegacyPlugin;
+
+template <class... Ts>
+class LegacyPlugin<std::tuple<Ts...>>
+    : public Hdf5PluginInterface<std::tuple<Ts...>, Hdf5Reader::supported_2D_types>,
+      public LegacyRead1D<Ts>...,
+      public LegacyRead2DPairs
+{
+  public:
+    HighFive::File openFile(const std::string& path) const override {
+        return Hdf5Reader().openFile(path);
+    }
+};
+
+}  // unnamed namespace
+
+
+TEST_CASE("Hdf5Reader", "[base]") {
+    writeChunkedFile(CHUNKED_FILE_PATH);
+
+    ReadPolicy small_blocks;
+    small_blocks.min_gap_bytes = 4 * sizeof(uint64_t);
+    small_blocks.max_block_bytes = 8 * sizeof(uint64_t);
+    small_blocks.max_block_bytes_2d = 8 * sizeof(uint64_t);
+    small_blocks.max_over_read_ratio = 1.5;
+    small_blocks.max_buffer_bytes = 3 * sizeof(uint64_t);
+
+    for (const auto& reader : {Hdf5Reader(Hdf5ReadStrategy::mergedBlocks),
+                               Hdf5Reader(Hdf5ReadStrategy::unionHyperslab),
+                               Hdf5Reader(small_blocks),
+                               makeDirectChunkReader(),
+                               makeDirectChunkReader(1, small_blocks),
+                               makeMmapReader(),
+                               makeIoUringReader(),
+                               makeIoUringReader(0),
+                               makePipelinedReader(),
+                               makePipelinedReader(1, small_blocks),
+                               makePipelinedReader(5, small_blocks),
+                               makeCachingReader(BlockCache(1 << 20, 5 * sizeof(uint64_t))),
+                               makeCachingReader(BlockCache(1 << 20), makeMmapReader())}) {
+        const auto file = reader.openFile(CHUNKED_FILE_PATH);
+        const auto values = file.getDataSet("values");
+        const auto shuffled = file.getDataSet("shuffled");
+        const auto contiguous = file.getDataSet("contiguous");
+        const auto pairs = file.getDataSet("pairs");
+        const auto columns = file.getDataSet("columns");
+        const auto contiguous_pairs = file.getDataSet("contiguous_pairs");
+        const auto table = file.getDataSet("table");
+        const auto contiguous_table = file.getDataSet("contiguous_table");
+
+        for (const auto& selection : {Selection({}),
+                                      Selection({{0, 1}}),
+                                      Selection({{2, 5}, {6, 9}, {13, 15}, {50, 51}, {99, 100}}),
+                                      Selection({{0, 100}})}) {
+            std::vector<uint64_t> expected_values;
+            std::vector<std::array<uint64_t, 2>> expected_pairs;
+            for (const auto id : selection) {
+                expected_values.push_back(3 * id);
+                expected_pairs.push_back({id, id + 1});
+            }
+
+            CHECK(reader.readSelection<uint64_t>(values, selection) == expected_values);
+            CHECK(reader.readSelection<uint64_t>(shuffled, selection) == expected_values);
+            CHECK(reader.readSelection<uint64_t>(contiguous, selection) == expected_values);
+            for (const auto& dset : {pairs, columns, contiguous_pairs}) {
+                CHECK(reader.readSelection<std::array<uint64_t, 2>>(dset,
+                                                                    selection,
+                                                                    Selection({{0, 2}})) ==
+                      expected_pairs);
+            }
+
+            std::vector<uint64_t> expected_ends;
+            for (const auto& pair : expected_pairs) {
+                expected_ends.push_back(pair[1]);
+            }
+            CHECK(reader.readSelection<uint64_t>(pairs, selection, Selection({{1, 2}})) ==
+                  expected_ends);
+
+            for (const auto& ysel : {Selection({{2, 3}}),
+                                     Selection({{0, 1}, {3, 5}}),
+                                     Selection({{0, 2}, {3, 4}, {5, 6}})}) {
+                std::vector<uint64_t> expected_table;
+                for (const auto i : selection) {
+                    for (const auto j : ysel) {
+                        expected_table.push_back(10 * i + j);
+                    }
+                }
+                const std::vector<double> expected_doubles(expected_table.begin(),
+                                                           expected_table.end());
+
+                for (const auto& dset : {table, contiguous_table}) {
+                    CHECK(reader.readSelection<uint64_t>(dset, selection, ysel) ==
+                          expected_table);
+                    CHECK(reader.readSelection<double>(dset, selection, ysel) ==
+                          expected_doubles);
+                }
+            }
+
+            const auto table_pairs = reader.readSelection<std::array<uint64_t, 2>>(
+                table, selection, Selection({{1, 2}, {4, 5}}));
+            REQUIRE(table_pairs.size() == selection.flatSize());
+            for (size_t k = 0; k < table_pairs.size(); ++k) {
+                const auto i = selection.select(k);
+                CHECK(table_pairs[k] == std::array<uint64_t, 2>{10 * i + 1, 10 * i + 4});
+            }
+        }
+
+        CHECK_THROWS_AS(reader.readSelection<Pair>(table, Selection({{0, 1}}), Selection({{0, 3}})),
+                        SonataError);
+    }
+
+    std::remove(CHUNKED_FILE_PATH);
+}
+
+
+TEST_CASE("Hdf5Reader with a legacy plugin", "[base]") {
+    writeChunkedFile(CHUNKED_FILE_PATH);
+
+    const auto plugin = std::make_shared<LegacyPlugin<Hdf5Reader::supported_1D_types>>();
+    const Hdf5Reader reader(plugin);
+    const auto file = reader.openFile(CHUNKED_FILE_PATH);
+    const auto table = file.getDataSet("table");
+    const auto selection = Selection({{2, 4}, {7, 8}});
+
+    CHECK(reader.readSelection<double>(table, selection, Selection({{1, 2}})) ==
+          std::vector<double>{21, 31, 71});
+    CHECK(plugin->pair_reads == 0);
+    CHECK(reader.readSelection<Pair>(table, selection, Selection({{0, 2}})) ==
+          std::vector<Pair>{{20, 21}, {30, 31}, {70, 71}});
+    CHECK(plugin->pair_reads == 1);
+
+    std::remove(CHUNKED_FILE_PATH);
+}
+
+TEST_CASE("Contiguous readers", "[base]") {
+    const Selection selection({{1, 3}, {7, 8}});
+
+    const auto write = [](const std::vector<uint64_t>& padding,
+                          const std::vector<uint64_t>& values) {
+        HighFive::File file(CHUNKED_FILE_PATH, HighFive::File::Truncate);
+        file.createDataSet<uint64_t>("padding", HighFive::DataSpace::From(padding))
+            .write(padding);
+        file.createDataSet<uint64_t>("values", HighFive::DataSpace::From(values)).write(values);
+    };
+
+    for (const auto& reader : {makeMmapReader(), makeIoUringReader(2), makeIoUringReader(0)}) {
+        const auto read = [&]() {
+            const auto file = reader.openFile(CHUNKED_FILE_PATH);
+            return reader.readSelection<uint64_t>(file.getDataSet("values"), selection);
+        };
+
+        write({0}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+        CHECK(read() == std::vector<uint64_t>{1, 2, 7});
+        CHECK(read() == std::vector<uint64_t>{1, 2, 7});
+
+        // The file is replaced, and the dataset moves.
+        write(std::vector<uint64_t>(1000), {0, 10, 20, 30, 40, 50, 60, 70, 80, 90});
+        CHECK(read() == std::vector<uint64_t>{10, 20, 70});
+    }
+
+    std::remove(CHUNKED_FILE_PATH);
+}
+
+
+TEST_CASE("Contiguous readers of replaced files", "[base]") {
+    const std::string path = "./data/replaced.h5.tmp";
+    const std::string new_path = path + ".new";
+    const Selection selection({{1, 3}, {7, 8}});
+
+    // A node population whose attribute `x` comes after `padding` elements.
+    const auto write = [](const std::string& p, size_t padding, double scale) {
+        HighFive::File file(p, HighFive::File::Truncate);
+        const std::vector<uint64_t> zeros(padding, 0);
+        file.createDataSet<uint64_t>("padding", HighFive::DataSpace::From(zeros)).write(zeros);
+
+        auto root = file.createGroup("/nodes/default");
+        const std::vector<uint64_t> type_ids(10, 0);
+        root.createDataSet<uint64_t>("node_type_id", HighFive::DataSpace::From(type_ids))
+            .write(type_ids);
+        std::vector<double> x(10);
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = scale * static_cast<double>(i);
+        }
+        root.createGroup("0").createDataSet<double>("x", HighFive::DataSpace::From(x)).write(x);
+    };
+
+    for (const auto& reader : {makeMmapReader(), makeIoUringReader(2), makeIoUringReader(0)}) {
+        write(path, 1, 1.0);
+        const NodePopulation population(path, "", "default", reader);
+        CHECK(population.getAttribute<double>("x", selection) == std::vector<double>{1, 2, 7});
+
+        // Another file is renamed over it; the population keeps reading the
+        // file it opened, and only populations opened after see the new one.
+        write(new_path, 1000, 10.0);
+        REQUIRE(std::rename(new_path.c_str(), path.c_str()) == 0);
+        CHECK(population.getAttribute<double>("x", selection) == std::vector<double>{1, 2, 7});
+
+        const NodePopulation replaced(path, "", "default", reader);
+        CHECK(replaced.getAttribute<double>("x", selection) == std::vector<double>{10, 20, 70});
+        CHECK(population.getAttribute<double>("x", selection) == std::vector<double>{1, 2, 7});
+    }
+
+    std::remove(path.c_str());
+}
+
+
+#ifdef __linux__
+TEST_CASE("Mmap reader releases closed files", "[base]") {
+    const std::string path = "./data/mapped.h5.tmp";
+    const std::string other_path = "./data/other.h5.tmp";
+    const auto write = [](const std::string& p) {
+        HighFive::File file(p, HighFive::File::Truncate);
+        const std::vector<uint64_t> values{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        file.createDataSet<uint64_t>("values", HighFive::DataSpace::From(values)).write(values);
+    };
+    // The number of mappings of `name` in this process.
+    const auto count_mappings = [](const std::string& name) {
+        std::ifstream maps("/proc/self/maps");
+        size_t count = 0;
+        for (std::string line; std::getline(maps, line);) {
+            count += line.find(name) != std::string::npos ? 1 : 0;
+        }
+        return count;
+    };
+
+    const auto reader = makeMmapReader();
+    const auto read = [&reader](const std::string& p) {
+        const auto file = reader.openFile(p);
+        return reader.readSelection<uint64_t>(file.getDataSet("values"), Selection({{1, 3}}));
+    };
+
+    write(path);
+    CHECK(read(path) == std::vector<uint64_t>{1, 2});
+    CHECK(count_mappings("mapped.h5.tmp") == 1);
+
+    // Once HDF5 has closed the file, the next read drops its mapping; even if
+    // the file was deleted meanwhile.
+    std::remove(path.c_str());
+    write(other_path);
+    CHECK(read(other_path) == std::vector<uint64_t>{1, 2});
+    CHECK(count_mappings("mapped.h5.tmp") == 0);
+
+    std::remove(other_path.c_str());
+}
+#endif
+
+
+TEST_CASE("Contiguous readers close files HDF5 has closed", "[base]") {
+    // Fewer descriptors than files are read, to fail if any are kept.
+    constexpr size_t n_files = 200;
+    struct rlimit limit;
+    REQUIRE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+    const struct rlimit original = limit;
+    limit.rlim_cur = std::min<rlim_t>(limit.rlim_cur, 64);
+    REQUIRE(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+    for (const auto& reader : {makeMmapReader(), makeIoUringReader(2), makeIoUringReader(0)}) {
+        for (size_t i = 0; i < n_files; ++i) {
+            const auto path = "./data/files-" + std::to_string(i) + ".h5.tmp";
+            {
+                HighFive::File file(path, HighFive::File::Truncate);
+                const std::vector<uint64_t> values(10, i);
+                file.createDataSet<uint64_t>("values", HighFive::DataSpace::From(values))
+                    .write(values);
+            }
+            {
+                const auto file = reader.openFile(path);
+                CHECK(reader.readSelection<uint64_t>(file.getDataSet("values"),
+                                                     Selection({{1, 3}})) ==
+                      std::vector<uint64_t>{i, i});
+            }
+            std::remove(path.c_str());
+        }
+    }
+
+    setrlimit(RLIMIT_NOFILE, &original);
+}
+
+
+TEST_CASE("Caching reader", "[base]") {
+    writeChunkedFile(CHUNKED_FILE_PATH);
+
+    // Blocks of 10 rows, and room for three of them.
+    BlockCache cache(3 * 10 * sizeof(uint64_t), 10 * sizeof(uint64_t));
+    const auto reader = makeCachingReader(cache);
+    const auto other_reader = makeCachingReader(cache, makeDirectChunkReader(1));
+
+    const auto file = reader.openFile(CHUNKED_FILE_PATH);
+    const auto values = file.getDataSet("values");
+    const auto statistics = [&cache]() {
+        const auto s = cache.statistics();
+        return std::vector<uint64_t>{s.hits, s.misses, s.evictions, s.size_bytes};
+    };
+
+    CHECK(reader.readSelection<uint64_t>(values, Selection({{3, 5}, {18, 21}})) ==
+          std::vector<uint64_t>{9, 12, 54, 57, 60});
+    CHECK(statistics() == std::vector<uint64_t>{0, 3, 0, 240});
+
+    // Readers of the same cache share its blocks.
+    CHECK(other_reader.readSelection<uint64_t>(values, Selection({{9, 11}})) ==
+          std::vector<uint64_t>{27, 30});
+    CHECK(statistics() == std::vector<uint64_t>{2, 3, 0, 240});
+
+    // The least recently used block, i.e. rows [20, 30), is evicted.
+    CHECK(reader.readSelection<uint64_t>(values, Selection({{1, 2}, {99, 100}})) ==
+          std::vector<uint64_t>{3, 297});
+    CHECK(statistics() == std::vector<uint64_t>{3, 4, 1, 240});
+
+    // Other types and columns are cached separately.
+    CHECK(reader.readSelection<std::array<uint64_t, 2>>(file.getDataSet("pairs"),
+                                                        Selection({{2, 3}}),
+                                                        Selection({{0, 2}})) ==
+          std::vector<std::array<uint64_t, 2>>{{2, 3}});
+    CHECK(statistics() == std::vector<uint64_t>{3, 5, 2, 240});
+
+    CHECK(reader.readSelection<uint64_t>(values, Selection({})).empty());
+    CHECK_THROWS(reader.readSelection<uint64_t>(values, Selection({{99, 101}})));
+
+    cache.clear();
+    CHECK(statistics() == std::vector<uint64_t>{3, 5, 2, 0});
+
+    std::remove(CHUNKED_FILE_PATH);
+}
+
+
+TEST_CASE("Caching reader of replaced files", "[base]") {
+    const std::string path = "./data/replaced.h5.tmp";
+    const std::string new_path = path + ".new";
+    const auto write = [](const std::string& p, uint64_t scale) {
+        std::vector<uint64_t> values(100);
+        for (uint64_t i = 0; i < values.size(); ++i) {
+            values[i] = scale * i;
+        }
+        HighFive::File file(p, HighFive::File::Truncate);
+        file.createDataSet<uint64_t>("values", HighFive::DataSpace::From(values)).write(values);
+    };
+
+    BlockCache cache(1 << 20, 10 * sizeof(uint64_t));
+    const auto reader = makeCachingReader(cache);
+    const Selection selection({{3, 5}});
+
+    write(path, 1);
+    const auto file = reader.openFile(path);
+    CHECK(reader.readSelection<uint64_t>(file.getDataSet("values"), selection) ==
+          std::vector<uint64_t>{3, 4});
+
+    // The blocks of the open file aren't those of the file now at its path.
+    write(new_path, 10);
+    REQUIRE(std::rename(new_path.c_str(), path.c_str()) == 0);
+    const auto replaced = reader.openFile(path);
+    CHECK(reader.readSelection<uint64_t>(replaced.getDataSet("values"), selection) ==
+          std::vector<uint64_t>{30, 40});
+    CHECK(reader.readSelection<uint64_t>(file.getDataSet("values"), selection) ==
+          std::vector<uint64_t>{3, 4});
+    CHECK(cache.statistics().misses == 2);
+
+    std::remove(path.c_str());
+}
+
+
+TEST_CASE("Instrumented reader", "[base]") {
+    writeChunkedFile(CHUNKED_FILE_PATH);
+
+    IoStatistics statistics;
+    const auto reader = makeInstrumentedReader(
+        statistics, Hdf5Reader(Hdf5ReadStrategy::unionHyperslab, ReadPolicy()));
+
+    const auto file = reader.openFile(CHUNKED_FILE_PATH);
+    const auto values = file.getDataSet("contiguous");
+    CHECK(reader.readSelection<uint64_t>(values, Selection({{3, 5}, {18, 21}})) ==
+          std::vector<uint64_t>{9, 12, 54, 57, 60});
+    CHECK(reader.readSelection<uint64_t>(file.getDataSet("table"),
+                                         Selection({{1, 2}}),
+                                         Selection({{0, 2}})) ==
+          std::vector<uint64_t>{10, 11});
+
+    auto counters = statistics.counters();
+    CHECK(counters.reads == 2);
+    CHECK(counters.bytes_requested == 7 * sizeof(uint64_t));
+    CHECK(counters.bytes_read == 7 * sizeof(uint64_t));
+    CHECK(counters.blocks == 2);
+
+    REQUIRE(counters.latencies.count("readSelection") == 1);
+    const auto& latency = counters.latencies.at("readSelection");
+    CHECK(latency.count == 2);
+    CHECK(latency.max_seconds <= latency.total_seconds);
+    REQUIRE(latency.buckets.size() == 32);
+    CHECK(std::accumulate(latency.buckets.begin(), latency.buckets.end(), uint64_t(0)) == 2);
+
+    // Merged blocks may read more than was selected.
+    const auto merged = makeInstrumentedReader(statistics);
+    statistics.reset();
+    CHECK(merged.readSelection<uint64_t>(values, Selection({{3, 5}, {18, 21}})).size() == 5);
+    counters = statistics.counters();
+    CHECK(counters.reads == 1);
+    CHECK(counters.bytes_requested == 5 * sizeof(uint64_t));
+    CHECK(counters.bytes_read >= counters.bytes_requested);
+    CHECK(counters.blocks >= 1);
+
+    statistics.reset();
+    counters = statistics.counters();
+    CHECK(counters.reads == 0);
+    CHECK(counters.bytes_read == 0);
+    CHECK(counters.latencies.empty());
+
+    std::remove(CHUNKED_FILE_PATH);
+}
+
+
+TEST_CASE("ReadPolicy", "[base]") {
+    const ReadPolicy defaults;
+    CHECK(defaults.min_gap_bytes == 4 << 20);
+    CHECK(defaults.max_block_bytes == 4 << 20);
+    CHECK(defaults.max_block_bytes_2d == 128 * defaults.min_gap_bytes);
+
+    const auto calibrated = ReadPolicy::calibrate("./data/nodes1.h5");
+    CHECK(calibrated.min_gap_bytes > 0);
+    CHECK(calibrated.max_block_bytes >= calibrated.min_gap_bytes);
+
+    CHECK_THROWS_AS(ReadPolicy::calibrate("./data/no-such-file.h5"), SonataError);
+}
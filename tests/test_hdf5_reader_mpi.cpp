@@ -0,0 +1,121 @@
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+#include <bbp/sonata/hdf5_reader_mpi.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+using namespace bbp::sonata;
+
+
+namespace {
+
+// Written by rank 0; the chunks of 7 rows don't line up with the blocks.
+const char* const FILE_PATH = "./data/collective.h5.tmp";
+
+void writeFile(const std::string& path) {
+    HighFive::File file(path, HighFive::File::Truncate);
+
+    std::vector<uint64_t> values(1000);
+    std::vector<std::array<uint64_t, 2>> pairs(1000);
+    std::vector<std::string> names(1000);
+    for (uint64_t i = 0; i < values.size(); ++i) {
+        values[i] = 3 * i;
+        pairs[i] = {i, i + 1};
+        names[i] = std::to_string(i);
+    }
+
+    file.createDataSet<uint64_t>("values", HighFive::DataSpace::From(values)).write(values);
+    file.createDataSet<std::string>("names", HighFive::DataSpace::From(names)).write(names);
+
+    HighFive::DataSetCreateProps props;
+    props.add(HighFive::Chunking({7, 2}));
+    props.add(HighFive::Deflate(4));
+    file.createDataSet<uint64_t>("pairs", HighFive::DataSpace::From(pairs), props).write(pairs);
+}
+
+// Overlapping, touching and disjoint ranges on different ranks; none on the last.
+Selection makeSelection(int rank, int size) {
+    if (rank == size - 1 && size > 1) {
+        return Selection({});
+    }
+
+    const uint64_t r = static_cast<uint64_t>(rank);
+    return Selection({{r, r + 3}, {10 * r + 5, 10 * r + 20}, {100 + 50 * r, 150 + 50 * r},
+                      {999 - r, 1000 - r}});
+}
+
+}  // unnamed namespace
+
+
+TEST_CASE("Collective reader", "[mpi]") {
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (rank == 0) {
+        writeFile(FILE_PATH);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    const auto selection = makeSelection(rank, size);
+    std::vector<uint64_t> expected_values;
+    std::vector<std::array<uint64_t, 2>> expected_pairs;
+    std::vector<std::string> expected_names;
+    for (const auto id : selection) {
+        expected_values.push_back(3 * id);
+        expected_pairs.push_back({id, id + 1});
+        expected_names.push_back(std::to_string(id));
+    }
+
+    ReadPolicy small_blocks;
+    small_blocks.max_block_bytes = 16 * sizeof(uint64_t);
+    small_blocks.max_block_bytes_2d = 16 * sizeof(uint64_t);
+
+    for (const auto& reader : {makeCollectiveReader(MPI_COMM_WORLD),
+                               makeCollectiveReader(MPI_COMM_WORLD, 1),
+                               makeCollectiveReader(MPI_COMM_WORLD, 2, small_blocks),
+                               makeCollectiveReader(MPI_COMM_WORLD, size + 1, small_blocks)}) {
+        const auto file = reader.openFile(FILE_PATH);
+
+        CHECK(reader.readSelection<uint64_t>(file.getDataSet("values"), selection) ==
+              expected_values);
+        CHECK(reader.readSelection<std::array<uint64_t, 2>>(file.getDataSet("pairs"),
+                                                            selection,
+                                                            Selection({{0, 2}})) ==
+              expected_pairs);
+        CHECK(reader.readSelection<std::string>(file.getDataSet("names"), selection) ==
+              expected_names);
+
+        // Out of bounds on one rank fails on all.
+        const auto out_of_bounds = rank == 0 ? Selection({{999, 1001}}) : selection;
+        CHECK_THROWS(reader.readSelection<uint64_t>(file.getDataSet("values"), out_of_bounds));
+
+        // So do different columns on different ranks.
+        if (size > 1) {
+            const auto columns = rank == 0 ? Selection({{0, 1}}) : Selection({{1, 2}});
+            CHECK_THROWS_AS(reader.readSelection<uint64_t>(file.getDataSet("pairs"),
+                                                           selection,
+                                                           columns),
+                            SonataError);
+        }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::remove(FILE_PATH);
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    const int result = Catch::Session().run(argc, argv);
+    MPI_Finalize();
+
+    return result;
+}
@@ -256,6 +256,53 @@ TEST_CASE("NodeSetCompound") {
         }
     }
 
+    SECTION("Exclude") {
+        const auto* const node_sets = R"({
+            "NodeSet0": { "attr-Y": {"$gt": 23} },
+            "NodeSet1": { "node_id": [0] },
+            "NodeSetCompound0": ["NodeSet0", "NodeSet1"],
+            "NotNodeSet0": { "$not": "NodeSet0" },
+            "NotNodeSets": { "$not": ["NodeSet0", "NodeSet1"] },
+            "NotNodeSetCompound0": { "$not": ["NodeSetCompound0"] },
+            "NotNotNodeSet0": { "$not": ["NotNodeSet0"] },
+            "NodeSetCompound1": ["NotNodeSets", "NodeSet1"]
+        })";
+        NodeSets ns(node_sets);
+        CHECK(ns.materialize("NotNodeSet0", population) == Selection({{0, 3}}));
+        CHECK(ns.materialize("NotNodeSets", population) == Selection({{1, 3}}));
+        CHECK(ns.materialize("NotNodeSetCompound0", population) == Selection({{1, 3}}));
+        CHECK(ns.materialize("NotNotNodeSet0", population) == Selection({{3, 6}}));
+        CHECK(ns.materialize("NodeSetCompound1", population) == Selection({{0, 3}}));
+
+        NodeSets roundtrip(ns.toJSON());
+        CHECK(roundtrip.toJSON() == ns.toJSON());
+        CHECK(roundtrip.materialize("NotNodeSets", population) == Selection({{1, 3}}));
+
+        CHECK_THROWS_AS(NodeSets(R"({"NotNodeSet0": { "$not": "NodeSet0" }})"), SonataError);
+        CHECK_THROWS_AS(NodeSets(R"({"NotNodeSet0": { "$not": 1 }})"), SonataError);
+        CHECK_THROWS_AS(NodeSets(R"({"NotNodeSet0": { "$not": [1] }})"), SonataError);
+        CHECK_THROWS_AS(NodeSets(R"({"NodeSet0": { "node_id": [0] },
+                                     "NotNodeSet0": { "$not": "NodeSet0", "attr-Y": 21 }})"),
+                        SonataError);
+        CHECK_THROWS_AS(NodeSets(R"({"A": { "$not": "B" }, "B": { "$not": "A" }})"), SonataError);
+    }
+
+    SECTION("NonBasicTargets") {
+        // every target is materialized once, not the whole compound rule once per target
+        NodePopulation counted("./data/nodes1.h5", "", "nodes-A");
+        IoStatistics statistics;
+        counted.setIoStatistics(statistics);
+
+        NodeSets ns(R"({
+            "Greater": { "attr-Y": {"$gt": 23} },
+            "Less": { "attr-Y": {"$lt": 22} },
+            "Both": ["Greater", "Less"]
+        })");
+        CHECK(ns.materialize("Both", counted) ==
+              (ns.materialize("Greater", population) | ns.materialize("Less", population)));
+        CHECK(statistics.counters().latencies.at("getAttribute").count == 2);
+    }
+
     SECTION("EmptyCompoundArray")
     {
         auto node_sets = R""({ "NodeSet0": {"node_id": [] },
@@ -265,6 +312,14 @@ TEST_CASE("NodeSetCompound") {
         NodeSets ns(node_sets);
         Selection sel = ns.materialize("NodeSetCompound0", population);
         CHECK(sel == Selection({}));
+
+        // an empty list, rather than a list of one empty name
+        CHECK(ns.toJSON() == "{\n  \"NodeSetCompound0\": []\n}");
+        CHECK(NodeSets(ns.toJSON()).materialize("NodeSetCompound0", population) == Selection({}));
+
+        NodeSets not_nothing(R"({ "NotNothing": { "$not": [] } })");
+        CHECK(not_nothing.materialize("NotNothing", population) == population.selectAll());
+        CHECK(NodeSets(not_nothing.toJSON()).toJSON() == not_nothing.toJSON());
     }
 }
 
@@ -2,8 +2,11 @@
 
 #include <bbp/sonata/nodes.h>
 
+#include <future>
+#include <hdf5.h>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 
@@ -155,6 +158,85 @@ TEST_CASE("NodePopulationMove", "[base]") {
     CHECK(pop2.name() == "nodes-A");
 }
 
+TEST_CASE("NodePopulationConcurrentReads", "[base]") {
+    NodePopulation population("./data/nodes1.h5", "", "nodes-A");
+
+    std::vector<std::vector<double>> results(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < results.size(); ++i) {
+        threads.emplace_back([&population, &results, i]() {
+            for (int k = 0; k < 10; ++k) {
+                results[i] = population.getAttribute<double>("attr-X",
+                                                             Selection({{0, 1}, {5, 6}}));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& result : results) {
+        CHECK(result == std::vector<double>{11.0, 16.0});
+    }
+    CHECK(population.size() == 6);
+}
+
+TEST_CASE("NodePopulationFileHandlePerThread", "[base]") {
+    const auto open_files = [] { return H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_FILE); };
+    const auto n_open = open_files();
+
+    SECTION("Closed when the threads exit") {
+        NodePopulation population("./data/nodes1.h5", "", "nodes-A");
+        CHECK(!population.fileHandlePerThread());
+        population.setFileHandlePerThread(true);
+        CHECK(population.fileHandlePerThread());
+
+        for (int round = 0; round < 3; ++round) {
+            std::vector<std::vector<double>> results(4);
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < results.size(); ++i) {
+                threads.emplace_back([&population, &results, i]() {
+                    results[i] = population.getAttribute<double>("attr-X",
+                                                                 Selection({{0, 1}, {5, 6}}));
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            for (const auto& result : results) {
+                CHECK(result == std::vector<double>{11.0, 16.0});
+            }
+            CHECK(open_files() == n_open + 1);
+        }
+    }
+
+    SECTION("Closed with the population") {
+        std::promise<void> destroyed;
+        std::thread thread;
+        uint64_t size = 0;
+        {
+            NodePopulation population("./data/nodes1.h5", "", "nodes-A");
+            population.setFileHandlePerThread(true);
+
+            std::promise<void> read;
+            thread = std::thread([&population, &size, &read, &destroyed]() {
+                size = population.size();
+                read.set_value();
+                destroyed.get_future().wait();
+            });
+            read.get_future().wait();
+            CHECK(open_files() == n_open + 2);
+        }
+        CHECK(open_files() == n_open);
+        destroyed.set_value();
+        thread.join();
+        CHECK(size == 6);
+    }
+
+    CHECK(open_files() == n_open);
+}
+
 TEST_CASE("NodePopulationSelectAll", "[base]") {
     NodePopulation population("./data/nodes1.h5", "", "nodes-A");
     CHECK(population.selectAll().flatSize() == 6);
@@ -172,3 +172,28 @@ TEST_CASE("ElementReportReader", "[base]") {
 
     REQUIRE_THROWS(pop.getNodeIdElementIdMapping(Selection({{3, 5}}), 4194303)); // < 1 x GPFS block
 }
+
+TEST_CASE("SomaReportReader ReadPolicy", "[base]") {
+    ReadPolicy read_policy;
+    read_policy.min_gap_bytes = 0;
+    const SomaReportReader reader("./data/somas.h5", read_policy);
+
+    auto pop = reader.openPopulation("All");
+
+    auto data = pop.get(Selection({{3, 5}}), 0.2, 0.5);
+    REQUIRE(data.ids == DataFrame<NodeID>::DataType{{3, 4}});
+    REQUIRE(data.data == std::vector<float>{3.2f, 4.2f, 3.3f, 4.3f, 3.4f, 4.4f, 3.5f, 4.5f});
+
+    // A gap below the minimum is clamped; the minimum is enforced on an explicit
+    // `block_gap_limit` only.
+    REQUIRE(pop.getNodeIdElementIdMapping(Selection({{3, 5}})) == std::vector<NodeID>{3, 4});
+
+    const SomaReportReader defaults("./data/somas.h5", ReadPolicy());
+    const SomaReportReader baseline("./data/somas.h5");
+    const auto selection = Selection({{1, 3}, {7, 9}});
+    const auto from_defaults = defaults.openPopulation("All").get(selection);
+    const auto from_baseline = baseline.openPopulation("All").get(selection);
+    REQUIRE(from_defaults.ids == from_baseline.ids);
+    REQUIRE(from_defaults.data == from_baseline.data);
+    REQUIRE(from_defaults.times == from_baseline.times);
+}
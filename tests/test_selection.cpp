@@ -2,6 +2,8 @@
 
 #include <bbp/sonata/population.h>
 
+#include <limits>
+
 
 using namespace bbp::sonata;
 
@@ -14,6 +16,58 @@ TEST_CASE("Selection", "[base]") {
     SECTION("fromValues") {
         const auto selection = Selection::fromValues({1, 3, 4, 1});
         CHECK(selection.ranges() == Selection::Ranges{{1, 2}, {3, 5}, {1, 2}});
+
+        // long enough for whole vector blocks, with breaks at every position
+        Selection::Values values;
+        Selection::Ranges expected;
+        for (Selection::Value begin = 100; begin < 400; begin += 37) {
+            const Selection::Value end = begin + (begin % 23);
+            for (auto id = begin; id < end; ++id) {
+                values.push_back(id);
+            }
+            if (end > begin) {
+                expected.push_back({begin, end});
+            }
+        }
+        values.push_back(7);
+        values.push_back(8);
+        expected.push_back({7, 9});
+        const auto contiguous = Selection::fromValues(values.data(),
+                                                      values.data() + values.size());
+        CHECK(contiguous.ranges() == expected);
+        CHECK(contiguous.flatten() == values);
+        CHECK(Selection::fromValues(values.begin(), values.end()) == contiguous);
+        CHECK(Selection::fromValues(values.data(), values.data()).empty());
+    }
+    SECTION("mask") {
+        // runs of set bytes crossing word and vector block boundaries, non-zero bytes other
+        // than 1
+        std::vector<uint8_t> mask(200, 0);
+        Selection::Ranges expected{{3, 5}, {7, 8}, {30, 70}, {95, 160}, {199, 200}};
+        for (const auto& range : expected) {
+            for (auto i = std::get<0>(range); i < std::get<1>(range); ++i) {
+                mask[i] = static_cast<uint8_t>(1 + i % 3);
+            }
+        }
+        const auto selection = Selection::fromMask(mask.data(), mask.size());
+        CHECK(selection.ranges() == expected);
+        CHECK(Selection::fromMask(mask.data(), 6).ranges() == Selection::Ranges{{3, 5}});
+        CHECK(Selection::fromMask(mask.data(), 0).empty());
+
+        std::vector<uint8_t> written(200, 7);
+        selection.toMask(written.data(), written.size());
+        for (size_t i = 0; i < mask.size(); ++i) {
+            CHECK(written[i] == (mask[i] != 0 ? 1 : 0));
+        }
+        CHECK(Selection::fromMask(written.data(), written.size()) == selection);
+
+        // unsorted, overlapping ranges
+        Selection({{5, 8}, {0, 2}, {6, 7}}).toMask(written.data(), 10);
+        CHECK(std::vector<uint8_t>(written.begin(), written.begin() + 10) ==
+              std::vector<uint8_t>{1, 1, 0, 0, 0, 1, 1, 1, 0, 0});
+
+        CHECK_THROWS_AS(selection.toMask(written.data(), 199), SonataError);
+        CHECK_NOTHROW(Selection({}).toMask(written.data(), 0));
     }
     SECTION("empty") {
         const auto selection = Selection({});
@@ -102,6 +156,98 @@ TEST_CASE("Selection", "[base]") {
         CHECK(Selection({{0, 10}}) == (even | odd));
     }
 
+    SECTION("unionAll and intersectAll") {
+        const auto empty = Selection({});
+        CHECK(Selection::unionAll({}) == empty);
+        CHECK(Selection::intersectAll({}) == empty);
+
+        const auto a = Selection({{24, 25}, {13, 23}, {5, 10}, {0, 2}});
+        const auto b = Selection({{1, 6}, {8, 13}, {15, 23}, {24, 25}});
+        const auto c = Selection::fromValues({1, 3, 5, 7, 9, 20, 21});
+
+        CHECK(Selection::unionAll({a}) == Selection({{0, 2}, {5, 10}, {13, 23}, {24, 25}}));
+        CHECK(Selection::intersectAll({a}) == Selection::unionAll({a}));
+
+        CHECK(Selection::unionAll({a, b}) == (a | b));
+        CHECK(Selection::unionAll({a, b, c, empty}) == (a | b | c));
+        CHECK(Selection::unionAll({c, c, c}) == c);
+
+        CHECK(Selection::intersectAll({a, b}) == (a & b));
+        CHECK(Selection::intersectAll({a, b, c}) == (a & b & c));
+        CHECK(Selection::intersectAll({a, b, c}) == Selection({{1, 2}, {5, 6}, {9, 10}, {20, 22}}));
+        CHECK(Selection::intersectAll({a, b, empty}) == empty);
+        CHECK(Selection::intersectAll({c, c, c}) == c);
+
+        // touching, but not overlapping
+        CHECK(Selection::unionAll({Selection({{0, 2}}), Selection({{2, 4}}), Selection({{4, 5}})}) ==
+              Selection({{0, 5}}));
+        CHECK(Selection::intersectAll({Selection({{0, 2}}), Selection({{2, 4}})}) == empty);
+    }
+
+    SECTION("difference") {
+        const auto empty = Selection({});
+        CHECK(empty == (empty - empty));
+
+        // clang-format off
+        //              1         2
+        //    01234567890123456789012345
+        // a = xx   xxxxx   xxxxxxxxxx x
+        // b =  xxxxx  xxxxx  xxxxxxxx x
+        //     x      xx    xx             <- a - b
+        //       xxx    xxx                <- b - a
+        // clang-format on
+        const auto a = Selection({{24, 25}, {13, 23}, {5, 10}, {0, 2}});
+        const auto b = Selection({{1, 6}, {8, 13}, {15, 23}, {24, 25}});
+        CHECK(Selection({{0, 2}, {5, 10}, {13, 23}, {24, 25}}) == (a - empty));
+        CHECK(empty == (empty - a));
+        CHECK(empty == (a - a));
+
+        CHECK(Selection({{0, 1}, {6, 8}, {13, 15}}) == (a - b));
+        CHECK(Selection({{2, 5}, {10, 13}}) == (b - a));
+
+        const auto odd = Selection::fromValues({1, 3, 5, 7, 9});
+        const auto even = Selection::fromValues({0, 2, 4, 6, 8});
+        CHECK(odd == (odd - even));
+        CHECK(Selection({{4, 5}, {8, 9}}) == (even - Selection({{0, 4}, {5, 8}})));
+    }
+
+    SECTION("symmetric difference") {
+        const auto empty = Selection({});
+        CHECK(empty == (empty ^ empty));
+
+        // clang-format off
+        //              1         2
+        //    01234567890123456789012345
+        // a = xx   xxxxx   xxxxxxxxxx x
+        // b =  xxxxx  xxxxx  xxxxxxxx x
+        //     x xxx  xx xxxxx             <- expected
+        // clang-format on
+        const auto a = Selection({{24, 25}, {13, 23}, {5, 10}, {0, 2}});
+        const auto b = Selection({{1, 6}, {8, 13}, {15, 23}, {24, 25}});
+        CHECK(b == (b ^ empty));
+        CHECK(empty == (b ^ b));
+
+        const auto expected = Selection({{0, 1}, {2, 5}, {6, 8}, {10, 15}});
+        CHECK(expected == (a ^ b));
+        CHECK(expected == (b ^ a));
+
+        const auto odd = Selection::fromValues({1, 3, 5, 7, 9});
+        const auto even = Selection::fromValues({0, 2, 4, 6, 8});
+        CHECK(Selection({{0, 10}}) == (odd ^ even));
+    }
+
+    SECTION("complement") {
+        CHECK(Selection({{0, 10}}) == Selection({}).complement(10));
+        CHECK(Selection({}) == Selection({}).complement(0));
+        CHECK(Selection({}) == Selection({{0, 10}}).complement(10));
+        CHECK(Selection({}) == Selection({{3, 5}}).complement(0));
+
+        const auto sel = Selection({{20, 30}, {2, 5}, {8, 9}});  // unsorted ranges
+        CHECK(Selection({{0, 2}, {5, 8}, {9, 20}, {30, 40}}) == sel.complement(40));
+        CHECK(Selection({{0, 2}, {5, 8}, {9, 20}}) == sel.complement(25));
+        CHECK(Selection({{0, 2}}) == sel.complement(3));
+    }
+
     SECTION("contains") {
         const auto sel = Selection({{2, 5}, {20, 21}, {10, 15}}); // unsorted ranges
 
@@ -128,6 +274,319 @@ TEST_CASE("Selection", "[base]") {
         CHECK_FALSE(empty.contains(100));
     }
 
+    SECTION("iterator") {
+        const auto empty = Selection({});
+        CHECK(empty.begin() == empty.end());
+
+        const auto sel = Selection({{3, 5}, {0, 2}, {1, 3}});  // unsorted, overlapping ranges
+        Selection::Values values(sel.begin(), sel.end());
+        CHECK(values == sel.flatten());
+        CHECK(values == Selection::Values{3, 4, 0, 1, 1, 2});
+        CHECK(std::distance(sel.begin(), sel.end()) == 6);
+
+        auto it = sel.begin();
+        CHECK(*(it++) == 3);
+        CHECK(*it == 4);
+        CHECK(*(++it) == 0);
+    }
+
+    SECTION("forEachRange") {
+        const auto sel = Selection({{3, 5}, {0, 2}});
+        Selection::Ranges ranges;
+        sel.forEachRange([&ranges](const Selection::Range& range) { ranges.push_back(range); });
+        CHECK(ranges == sel.ranges());
+    }
+
+    SECTION("select and rank") {
+        const auto sel = Selection({{10, 15}, {0, 3}, {20, 22}});
+        const auto values = sel.flatten();
+        for (size_t k = 0; k < values.size(); ++k) {
+            CHECK(sel.select(k) == values[k]);
+            CHECK(sel.rank(values[k]) == k);
+        }
+        CHECK_THROWS_AS(sel.select(values.size()), SonataError);
+        CHECK_THROWS_AS(sel.rank(3), SonataError);
+        CHECK_THROWS_AS(sel.rank(100), SonataError);
+        CHECK_THROWS_AS(Selection({}).select(0), SonataError);
+        CHECK_THROWS_AS(Selection({}).rank(0), SonataError);
+
+        // overlapping ranges: the first position is returned
+        const auto overlapping = Selection({{5, 10}, {0, 7}});
+        CHECK(overlapping.rank(6) == 1);
+        CHECK(overlapping.rank(0) == 5);
+        CHECK(overlapping.select(11) == 6);
+
+        // copies made before and after the index is built
+        const Selection before = overlapping;
+        CHECK(before.rank(0) == 5);
+        Selection after({});
+        after = overlapping;
+        CHECK(after.select(11) == 6);
+    }
+
+    SECTION("slice") {
+        const auto sel = Selection({{10, 15}, {0, 3}, {20, 22}});
+        CHECK(sel.slice(0, 10) == sel);
+        CHECK(sel.slice(0, 100) == sel);
+        CHECK(sel.slice(3, 7) == Selection({{13, 15}, {0, 2}}));
+        CHECK(sel.slice(5, 8) == Selection({{0, 3}}));
+        CHECK(sel.slice(9, 10) == Selection({{21, 22}}));
+        CHECK(sel.slice(4, 4).empty());
+        CHECK(sel.slice(7, 4).empty());
+        CHECK(sel.slice(10, 20).empty());
+    }
+
+    SECTION("sample") {
+        const auto sel = Selection({{10, 15}, {0, 3}, {20, 22}});
+        CHECK(sel.sample(10) == sel);
+        CHECK(sel.sample(100) == sel);
+        CHECK(sel.sample(0).empty());
+
+        const auto sample = sel.sample(4, 42);
+        CHECK(sample.flatSize() == 4);
+        CHECK(sample == sel.sample(4, 42));
+        CHECK((sample - sel).empty());
+
+        // the same on every platform
+        CHECK(sample.flatten() == Selection::Values{11, 0, 1, 2});
+        CHECK(Selection({{0, 1000}}).sample(5, 7).flatten() ==
+              Selection::Values{117, 141, 751, 891, 946});
+
+        // in the order of the selection
+        size_t previous = 0;
+        for (const auto id : sample) {
+            const auto position = sel.rank(id);
+            CHECK(position >= previous);
+            previous = position;
+        }
+    }
+
+    SECTION("partition") {
+        const auto flatten = [](const std::vector<Selection>& parts) {
+            Selection::Values ret;
+            for (const auto& part : parts) {
+                const auto values = part.flatten();
+                ret.insert(ret.end(), values.begin(), values.end());
+            }
+            return ret;
+        };
+
+        const auto sel = Selection({{10, 15}, {0, 3}, {20, 22}});  // 10 ids
+        {
+            const auto parts = sel.partition(3);
+            REQUIRE(parts.size() == 3);
+            CHECK(parts[0] == Selection({{10, 14}}));
+            CHECK(parts[1] == Selection({{14, 15}, {0, 2}}));
+            CHECK(parts[2] == Selection({{2, 3}, {20, 22}}));
+            CHECK(flatten(parts) == sel.flatten());
+        }
+        {
+            const auto parts = sel.partition(1);
+            REQUIRE(parts.size() == 1);
+            CHECK(parts[0] == sel);
+        }
+        {
+            const auto parts = sel.partition(12);
+            REQUIRE(parts.size() == 12);
+            CHECK(parts[9] == Selection({{21, 22}}));
+            CHECK(parts[10].empty());
+            CHECK(parts[11].empty());
+            CHECK(flatten(parts) == sel.flatten());
+        }
+        {
+            const auto parts = Selection({}).partition(2);
+            REQUIRE(parts.size() == 2);
+            CHECK(parts[0].empty());
+            CHECK(parts[1].empty());
+        }
+        CHECK_THROWS_AS(sel.partition(0), SonataError);
+
+        {
+            const auto parts = sel.split(4);
+            REQUIRE(parts.size() == 3);
+            CHECK(parts[0] == Selection({{10, 14}}));
+            CHECK(parts[1] == Selection({{14, 15}, {0, 3}}));
+            CHECK(parts[2] == Selection({{20, 22}}));
+        }
+        CHECK(sel.split(10).size() == 1);
+        CHECK(Selection({}).split(10).empty());
+        CHECK_THROWS_AS(sel.split(0), SonataError);
+    }
+
+    SECTION("partition with costs") {
+        const auto sel = Selection({{10, 15}, {0, 3}, {20, 22}});  // 10 ids
+        {
+            // one expensive id at the front
+            const std::vector<double> costs{9, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+            const auto parts = sel.partition(2, costs);
+            REQUIRE(parts.size() == 2);
+            CHECK(parts[0] == Selection({{10, 11}}));
+            CHECK(parts[1] == Selection({{11, 15}, {0, 3}, {20, 22}}));
+        }
+        {
+            const std::vector<double> costs(10, 1.);
+            const auto parts = sel.partition(3, costs);
+            REQUIRE(parts.size() == 3);
+            CHECK(parts[0].flatSize() + parts[1].flatSize() + parts[2].flatSize() == 10);
+            CHECK(parts[0].flatSize() >= 3);
+            CHECK(parts[0].flatSize() <= 4);
+            CHECK(parts[2].flatSize() >= 3);
+            CHECK(parts[2].flatSize() <= 4);
+        }
+        {
+            const std::vector<double> costs(10, 0.);
+            CHECK(sel.partition(3, costs) == sel.partition(3));
+        }
+        CHECK_THROWS_AS(sel.partition(2, std::vector<double>(9, 1.)), SonataError);
+        CHECK_THROWS_AS(sel.partition(2, std::vector<double>(10, -1.)), SonataError);
+        CHECK_THROWS_AS(sel.partition(0, std::vector<double>(10, 1.)), SonataError);
+    }
+
+    SECTION("serialize") {
+        const auto roundtrip = [](const Selection& sel) {
+            return Selection::deserialize(sel.serialize());
+        };
+
+        CHECK(roundtrip(Selection({})) == Selection({}));
+        CHECK(roundtrip(Selection({{0, 1}})) == Selection({{0, 1}}));
+
+        const auto canonical = Selection({{0, 2}, {5, 10}, {13, 23}});
+        CHECK(roundtrip(canonical) == canonical);
+        CHECK(canonical.serialize().size() == 3 + 1 + 1 + 1 + 3 * 2);
+
+        const auto unsorted = Selection({{24, 25}, {13, 23}, {5, 10}, {0, 2}, {1, 6}});
+        CHECK(roundtrip(unsorted).ranges() == unsorted.ranges());
+
+        const auto max = std::numeric_limits<Selection::Value>::max();
+        const auto large = Selection({{max - 10, max}, {0, max - 20}});
+        CHECK(roundtrip(large).ranges() == large.ranges());
+
+        const auto data = canonical.serialize();
+        CHECK(Selection::deserialize(data.data(), data.size()) == canonical);
+        CHECK_THROWS_AS(Selection::deserialize(""), SonataError);
+        CHECK_THROWS_AS(Selection::deserialize("NOT A SELECTION"), SonataError);
+        CHECK_THROWS_AS(Selection::deserialize(data.substr(0, data.size() - 1)), SonataError);
+        CHECK_THROWS_AS(Selection::deserialize(data + '\0'), SonataError);
+
+        auto wrong_version = data;
+        wrong_version[3] = 42;
+        CHECK_THROWS_AS(Selection::deserialize(wrong_version), SonataError);
+    }
+
+    SECTION("containsMany") {
+        const auto sel = Selection({{2, 5}, {20, 21}, {10, 15}});  // unsorted ranges
+
+        const Selection::Values sorted{0, 2, 4, 5, 9, 10, 14, 15, 20, 21, 100};
+        CHECK(sel.containsMany(sorted) ==
+              std::vector<bool>{false, true, true, false, false, true, true, false, true, false,
+                                false});
+
+        const Selection::Values unsorted{21, 20, 2, 100, 5, 14, 2};
+        CHECK(sel.containsMany(unsorted) ==
+              std::vector<bool>{false, true, true, false, false, true, true});
+
+        CHECK(sel.containsMany({}).empty());
+        CHECK(Selection({}).containsMany({0, 1, 2}) == std::vector<bool>{false, false, false});
+    }
+
+    SECTION("canonicalRanges") {
+        const auto canonical = Selection({{0, 2}, {3, 5}});
+        CHECK(&canonical.canonicalRanges() == &canonical.ranges());
+
+        const auto sel = Selection({{10, 15}, {2, 5}, {5, 6}, {3, 4}});
+        CHECK(sel.ranges() == Selection::Ranges{{10, 15}, {2, 5}, {5, 6}, {3, 4}});
+        CHECK(sel.canonicalRanges() == Selection::Ranges{{2, 6}, {10, 15}});
+
+        const auto copy = sel;
+        CHECK(&copy.canonicalRanges() == &sel.canonicalRanges());
+
+        CHECK(Selection({}).canonicalRanges().empty());
+    }
+
+    SECTION("scattered") {
+        // Many short ranges; from `fromValues` these are stored compressed.
+        const auto every = [](uint64_t step, uint64_t end) {
+            Selection::Ranges ranges;
+            for (uint64_t i = 0; i < end; i += step) {
+                ranges.push_back({i, i + 1});
+            }
+            return ranges;
+        };
+        const auto everyValue = [](uint64_t step, uint64_t end) {
+            Selection::Values values;
+            for (uint64_t i = 0; i < end; i += step) {
+                values.push_back(i);
+            }
+            return values;
+        };
+        const uint64_t n = 300000;
+        const auto by3 = Selection::fromValues(everyValue(3, n));
+        const auto by5 = Selection::fromValues(everyValue(5, n));
+
+        // Ranges passed by the caller are kept as they are.
+        const auto plain = Selection(every(3, n));
+        CHECK(plain == by3);
+        CHECK((plain & by5) == (by3 & by5));
+
+        CHECK(by3.ranges() == every(3, n));
+        CHECK(by3.flatSize() == n / 3);
+        CHECK(by3.flatten().size() == n / 3);
+        CHECK(by3.flatten()[1000] == 3000);
+        CHECK(Selection::Values(by3.begin(), by3.end()) == by3.flatten());
+        CHECK(std::distance(by3.begin(), by3.end()) == static_cast<std::ptrdiff_t>(n / 3));
+
+        // Runs, arrays and bitmaps, with ranges across the blocks.
+        const auto mixed = by3 | Selection({{65000, 140000}}) |
+                           Selection::fromValues(everyValue(1000, 3 * n));
+        CHECK(Selection::Values(mixed.begin(), mixed.end()) == mixed.flatten());
+        CHECK(Selection::deserialize(by3.serialize()) == by3);
+        CHECK(by3.select(1000) == 3000);
+        CHECK(by3.rank(3000) == 1000);
+        CHECK(by3.slice(1000, 1003) == Selection({{3000, 3001}, {3003, 3004}, {3006, 3007}}));
+        CHECK(by3.sample(1000, 1).flatSize() == 1000);
+        const auto parts = by3.partition(7);
+        CHECK(parts[0].flatSize() == (n / 3 + 6) / 7);
+        CHECK(Selection::unionAll(parts) == by3);
+        CHECK(by3.serialize().size() < 3 * by3.flatSize());
+        size_t n_ranges = 0;
+        by3.forEachRange([&n_ranges](const Selection::Range&) { ++n_ranges; });
+        CHECK(n_ranges == by3.ranges().size());
+        CHECK(by3.contains(299997));
+        CHECK_FALSE(by3.contains(299998));
+        CHECK_FALSE(by3.contains(uint64_t(1) << 40));
+        CHECK(by3.containsMany({0, 1, 3, 65535, 65536, 65537}) ==
+              std::vector<bool>{true, false, true, true, false, false});
+
+        CHECK((by3 & by5) == Selection(every(15, n)));
+        CHECK((by3 & by5).flatSize() == n / 15);
+
+        const auto both = by3 | by5;
+        CHECK(both.flatSize() == n / 3 + n / 5 - n / 15);
+        CHECK(both.ranges()[0] == Selection::Range{0, 1});
+        CHECK(both.ranges()[1] == Selection::Range{3, 4});
+        CHECK(both.ranges()[2] == Selection::Range{5, 7});
+
+        // Mixing compressed and plain selections.
+        const auto dense = Selection({{100, 200000}, {0, 10}});
+        CHECK((by3 & dense).flatSize() == 4 + (199998 - 102) / 3 + 1);
+        CHECK((by3 | dense).ranges()[0] == Selection::Range{0, 10});
+        CHECK((by3 | dense) == (dense | by3));
+        CHECK((by3 | by3) == by3);
+        CHECK((by3 & Selection({})).empty());
+        CHECK(Selection::unionAll({by3, by5, dense}) == (by3 | by5 | dense));
+        CHECK(Selection::intersectAll({by3, by5, dense}) == (by3 & by5 & dense));
+
+        CHECK((by3 - by5).flatSize() == n / 3 - n / 15);
+        CHECK((by3 - by5) == (by3 ^ (by3 & by5)));
+        CHECK((by3 ^ by5) == (both - (by3 & by5)));
+        CHECK((by3 - by3).empty());
+        CHECK((by3 - dense) == (by3 & dense.complement(n)));
+        CHECK((by3 ^ dense) == ((by3 | dense) - (by3 & dense)));
+        CHECK(by3.complement(n).flatSize() == n - n / 3);
+        CHECK(by3.complement(n).complement(n) == by3);
+        CHECK((by3.complement(n) & by3).empty());
+    }
+
     /*  need a way to test un-exported stuff
     SECTION("_sortAndMerge") {
         const auto empty = Selection::Ranges({});
@@ -0,0 +1,64 @@
+#include <catch2/catch.hpp>
+
+#include <bbp/sonata/nodes.h>
+#include <bbp/sonata/tracing.h>
+
+#include <algorithm>  // std::any_of
+#include <cstdio>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <string>
+
+
+using namespace bbp::sonata;
+
+
+TEST_CASE("Tracing", "[base]") {
+    const std::string path = "./data/trace.json.tmp";
+    const NodePopulation population("./data/nodes1.h5", "", "nodes-A");
+
+    CHECK(!isTracing());
+    startTracing(path);
+    CHECK(isTracing());
+    CHECK(population.getAttribute<double>("attr-X", Selection({{0, 1}, {5, 6}})) ==
+          std::vector<double>{11.0, 16.0});
+    stopTracing();
+    CHECK(!isTracing());
+
+    // Not recorded.
+    population.getAttribute<double>("attr-X", Selection({{0, 1}}));
+    stopTracing();
+
+    std::ifstream file(path);
+    const auto trace = nlohmann::json::parse(file);
+    const auto& events = trace.at("traceEvents");
+
+    size_t n_begin = 0;
+    size_t n_end = 0;
+    for (const auto& event : events) {
+        CHECK(event.at("tid").get<uint64_t>() > 0);
+        if (event.at("name") != "Population::getAttribute") {
+            continue;
+        }
+        if (event.at("ph") == "B") {
+            CHECK(event.at("args").at("label") == "attr-X");
+            ++n_begin;
+        } else {
+            CHECK(event.at("ph") == "E");
+            CHECK(event.at("args").at("bytes") == 2 * sizeof(double));
+            ++n_end;
+        }
+    }
+    CHECK(n_begin == 1);
+    CHECK(n_end == 1);
+
+    const auto has = [&events](const std::string& name) {
+        return std::any_of(events.begin(), events.end(), [&name](const nlohmann::json& event) {
+            return event.at("name") == name;
+        });
+    };
+    CHECK(has("_readSelection"));
+
+    file.close();
+    std::remove(path.c_str());
+}
@@ -0,0 +1,171 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+// Generator of synthetic SONATA circuits and simulation outputs, of any size.
+//
+// Writes a node population, an edge population with its indices, node sets,
+// spikes and an element report into a directory; see `synthetic_circuit.hpp`
+// for their contents. Everything derives from the sizes and `--seed`, such that
+// the same files can be written again anywhere. Datasets are streamed in
+// batches; except for the edge indices, the memory needed doesn't grow with the
+// sizes. The throughput of every file is printed on stderr.
+//
+//   sonata_generate [--dir DIR] [--nodes N] [--fan-in K] [--fan-in-sigma S]
+//                   [--report-nodes N] [--elements-per-node N] [--frames N]
+//                   [--spikes N] [--seed S] [--chunk-size N] [--deflate LEVEL]
+//                   [--shuffle] [--no-indices]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include "synthetic_circuit.hpp"
+
+namespace {
+
+struct Options {
+    std::string directory = ".";
+    synthetic::Sizes sizes;
+    synthetic::Layout layout;
+    bool indices = true;
+};
+
+void usage(const char* name) {
+    std::fprintf(stderr,
+                 "usage: %s [--dir DIR] [--nodes N] [--fan-in K] [--fan-in-sigma S]\n"
+                 "          [--report-nodes N] [--elements-per-node N] [--frames N]\n"
+                 "          [--spikes N] [--seed S] [--chunk-size N] [--deflate LEVEL]\n"
+                 "          [--shuffle] [--no-indices]\n",
+                 name);
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    // A realistic spread of the fan-in, unless asked otherwise.
+    options.sizes.fan_in_sigma = 0.5;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--shuffle") {
+            options.layout.shuffle = true;
+            continue;
+        }
+        if (arg == "--no-indices") {
+            options.indices = false;
+            continue;
+        }
+        if (i + 1 == argc) {
+            return false;
+        }
+        const std::string value = argv[++i];
+        auto& sizes = options.sizes;
+        auto& layout = options.layout;
+        if (arg == "--dir") {
+            options.directory = value;
+        } else if (arg == "--nodes") {
+            sizes.nodes = std::stoull(value);
+        } else if (arg == "--fan-in") {
+            sizes.fan_in = std::stoull(value);
+        } else if (arg == "--fan-in-sigma") {
+            sizes.fan_in_sigma = std::stod(value);
+        } else if (arg == "--report-nodes") {
+            sizes.report_nodes = std::stoull(value);
+        } else if (arg == "--elements-per-node") {
+            sizes.elements_per_node = std::stoull(value);
+        } else if (arg == "--frames") {
+            sizes.frames = std::stoull(value);
+        } else if (arg == "--spikes") {
+            sizes.spikes = std::stoull(value);
+        } else if (arg == "--seed") {
+            sizes.seed = std::stoull(value);
+        } else if (arg == "--chunk-size") {
+            layout.chunk_size = std::stoull(value);
+        } else if (arg == "--deflate") {
+            layout.deflate = static_cast<unsigned>(std::stoul(value));
+        } else {
+            return false;
+        }
+    }
+    return options.layout.chunk_size > 0 && options.layout.deflate <= 9;
+}
+
+// Run `write`, and print how long it took, and the size of `path` after it.
+void timeWrite(const char* name, const std::string& path, const std::function<void()>& write) {
+    const auto start = std::chrono::steady_clock::now();
+    write();
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const auto bytes = static_cast<double>(std::ifstream(path, std::ios::ate).tellg());
+    std::fprintf(stderr,
+                 "  %-16s %10.1f MB %10.2f s %10.1f MB/s\n",
+                 name,
+                 bytes / 1e6,
+                 seconds,
+                 bytes / 1e6 / std::max(seconds, 1e-9));
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception&) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const auto& sizes = options.sizes;
+    const auto& layout = options.layout;
+    if (sizes.nodes == 0) {
+        std::fprintf(stderr, "The number of nodes must not be zero.\n");
+        return EXIT_FAILURE;
+    }
+
+    const synthetic::Paths paths(options.directory);
+    try {
+        std::fprintf(stderr,
+                     "Writing %llu nodes, %llu edges, %llu spikes into '%s'\n",
+                     static_cast<unsigned long long>(sizes.nodes),
+                     static_cast<unsigned long long>(sizes.edges()),
+                     static_cast<unsigned long long>(sizes.spikes),
+                     options.directory.c_str());
+
+        timeWrite("nodes", paths.nodes, [&] {
+            synthetic::writeNodes(paths.nodes, sizes, layout);
+        });
+        timeWrite("edges", paths.edges, [&] {
+            synthetic::writeEdges(paths.edges, sizes, layout);
+        });
+        if (options.indices) {
+            timeWrite("edges/indices", paths.edges, [&] {
+                synthetic::writeEdgeIndices(paths.edges, sizes);
+            });
+        }
+        synthetic::writeNodeSets(paths.node_sets);
+        timeWrite("spikes", paths.spikes, [&] {
+            synthetic::writeSpikes(paths.spikes, sizes, layout);
+        });
+        timeWrite("report", paths.report, [&] {
+            synthetic::writeReport(paths.report, sizes, layout);
+        });
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
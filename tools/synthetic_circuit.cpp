@@ -0,0 +1,330 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#include "synthetic_circuit.hpp"
+
+#include <bbp/sonata/edges.h>
+#include <bbp/sonata/report_reader.h>
+
+#include <highfive/H5File.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <vector>
+
+namespace synthetic {
+
+namespace {
+
+constexpr uint64_t BATCH_SIZE = 1 << 20;
+constexpr uint64_t N_MTYPES = sizeof(MTYPES) / sizeof(MTYPES[0]);
+constexpr int32_t LAYERS[N_MTYPES] = {1, 2, 4, 5, 6, 6};
+constexpr double TIME_STEP = 0.1;
+constexpr double PI = 3.14159265358979323846;
+
+// Streams of random numbers, one per dataset.
+enum Stream : uint64_t {
+    position = 1,
+    mtype,
+    source,
+    delay,
+    weight,
+    spike_node,
+    spike_time,
+    data,
+    degree
+};
+
+// The `i`-th random number of `stream`; independent of the order it's computed in.
+uint64_t _random(uint64_t seed, Stream stream, uint64_t i) {
+    // splitmix64
+    uint64_t z = seed * 0x9e3779b97f4a7c15ULL + stream * 0xbf58476d1ce4e5b9ULL + i;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1).
+double _uniform(uint64_t seed, Stream stream, uint64_t i) {
+    return static_cast<double>(_random(seed, stream, i) >> 11) / 9007199254740992.0;  // 2^53
+}
+
+// Chunking and filters of a dataset of `dims`; the chunks are `chunk` elements.
+HighFive::DataSetCreateProps _createProps(const Layout& layout,
+                                          const std::vector<size_t>& dims,
+                                          const std::vector<size_t>& chunk) {
+    HighFive::DataSetCreateProps props;
+    if (std::find(dims.begin(), dims.end(), 0) != dims.end()) {
+        return props;
+    }
+    props.add(HighFive::Chunking(chunk));
+    if (layout.shuffle) {
+        props.add(HighFive::Shuffle());
+    }
+    if (layout.deflate > 0) {
+        props.add(HighFive::Deflate(std::min(layout.deflate, 9u)));
+    }
+    return props;
+}
+
+template <class T>
+HighFive::DataSet _createDataSet(const HighFive::Group& group,
+                                 const std::string& name,
+                                 uint64_t size,
+                                 const Layout& layout) {
+    const auto chunk_size = std::max<uint64_t>(1, std::min(size, layout.chunk_size));
+    return group.createDataSet<T>(name,
+                                  HighFive::DataSpace({size}),
+                                  _createProps(layout, {size}, {chunk_size}));
+}
+
+// Write `value(i)` for all `i < size`, in batches.
+template <class T, class Value>
+void _writeDataSet(const HighFive::Group& group,
+                   const std::string& name,
+                   uint64_t size,
+                   const Layout& layout,
+                   Value value) {
+    auto dset = _createDataSet<T>(group, name, size, layout);
+    std::vector<T> batch;
+    for (uint64_t begin = 0; begin < size; begin += BATCH_SIZE) {
+        const uint64_t end = std::min(size, begin + BATCH_SIZE);
+        batch.resize(end - begin);
+        for (uint64_t i = begin; i < end; ++i) {
+            batch[i - begin] = value(i);
+        }
+        dset.select({begin}, {end - begin}).write(batch);
+    }
+}
+
+template <class T>
+void _writeAttribute(const HighFive::DataSet& dset, const std::string& name, const T& value) {
+    dset.createAttribute<T>(name, HighFive::DataSpace::From(value)).write(value);
+}
+
+}  // unnamed namespace
+
+
+uint64_t Sizes::fanIn(uint64_t node) const {
+    if (fan_in_sigma <= 0.0) {
+        return fan_in;
+    }
+
+    // Log-normal, by Box-Muller; `mu` is such that the mean is `fan_in`.
+    const double u1 = 1.0 - _uniform(seed, Stream::degree, 2 * node);
+    const double u2 = _uniform(seed, Stream::degree, 2 * node + 1);
+    const double z = std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * PI * u2);
+    const double mu = std::log(static_cast<double>(fan_in)) - 0.5 * fan_in_sigma * fan_in_sigma;
+    return static_cast<uint64_t>(std::llround(std::exp(mu + fan_in_sigma * z)));
+}
+
+uint64_t Sizes::edges() const {
+    if (fan_in_sigma <= 0.0) {
+        return nodes * fan_in;
+    }
+
+    uint64_t count = 0;
+    for (uint64_t node = 0; node < nodes; ++node) {
+        count += fanIn(node);
+    }
+    return count;
+}
+
+
+Paths::Paths(const std::string& directory)
+    : nodes(directory + "/nodes.h5")
+    , edges(directory + "/edges.h5")
+    , node_sets(directory + "/node_sets.json")
+    , spikes(directory + "/spikes.h5")
+    , report(directory + "/report.h5") { }
+
+
+void writeNodes(const std::string& path, const Sizes& sizes, const Layout& layout) {
+    HighFive::File file(path, HighFive::File::Truncate);
+    const auto root = file.createGroup(std::string("/nodes/") + POPULATION);
+    const auto seed = sizes.seed;
+    const auto mtype = [seed](uint64_t i) {
+        return static_cast<uint32_t>(_random(seed, Stream::mtype, i) % N_MTYPES);
+    };
+
+    _writeDataSet<int64_t>(root, "node_type_id", sizes.nodes, layout, [](uint64_t) {
+        return -1;
+    });
+
+    const auto group = root.createGroup("0");
+    const char* const axes[] = {"x", "y", "z"};
+    for (uint64_t axis = 0; axis < 3; ++axis) {
+        _writeDataSet<float>(group, axes[axis], sizes.nodes, layout, [seed, axis](uint64_t i) {
+            return static_cast<float>(1000.0 * _uniform(seed, Stream::position, 3 * i + axis));
+        });
+    }
+    _writeDataSet<uint32_t>(group, "mtype", sizes.nodes, layout, mtype);
+    _writeDataSet<int32_t>(group, "layer", sizes.nodes, layout, [&mtype](uint64_t i) {
+        return LAYERS[mtype(i)];
+    });
+
+    const std::vector<std::string> names(std::begin(MTYPES), std::end(MTYPES));
+    group.createGroup("@library")
+        .createDataSet<std::string>("mtype", HighFive::DataSpace::From(names))
+        .write(names);
+}
+
+
+void writeEdges(const std::string& path, const Sizes& sizes, const Layout& layout) {
+    HighFive::File file(path, HighFive::File::Truncate);
+    const auto root = file.createGroup(std::string("/edges/") + POPULATION);
+    const auto seed = sizes.seed;
+    const auto n_edges = sizes.edges();
+
+    // Both node IDs in one pass over the targets, with the sources of every target sorted.
+    auto sources = _createDataSet<uint64_t>(root, "source_node_id", n_edges, layout);
+    auto targets = _createDataSet<uint64_t>(root, "target_node_id", n_edges, layout);
+    std::vector<uint64_t> source_batch;
+    std::vector<uint64_t> target_batch;
+    uint64_t begin = 0;
+    uint64_t edge = 0;
+    for (uint64_t target = 0; target < sizes.nodes; ++target) {
+        const uint64_t fan_in = sizes.fanIn(target);
+        for (uint64_t i = 0; i < fan_in; ++i, ++edge) {
+            source_batch.push_back(_random(seed, Stream::source, edge) % sizes.nodes);
+            target_batch.push_back(target);
+        }
+        std::sort(source_batch.end() - static_cast<std::ptrdiff_t>(fan_in), source_batch.end());
+
+        const bool last = target + 1 == sizes.nodes;
+        if (source_batch.size() >= BATCH_SIZE || (last && !source_batch.empty())) {
+            sources.select({begin}, {source_batch.size()}).write(source_batch);
+            targets.select({begin}, {target_batch.size()}).write(target_batch);
+            begin += source_batch.size();
+            source_batch.clear();
+            target_batch.clear();
+        }
+    }
+    for (const auto& dset : {sources, targets}) {
+        _writeAttribute(dset, "node_population", std::string(POPULATION));
+    }
+
+    _writeDataSet<int64_t>(root, "edge_type_id", n_edges, layout, [](uint64_t) { return -1; });
+
+    const auto group = root.createGroup("0");
+    _writeDataSet<float>(group, "delay", n_edges, layout, [seed](uint64_t i) {
+        return static_cast<float>(0.1 + 5.0 * _uniform(seed, Stream::delay, i));
+    });
+    _writeDataSet<float>(group, "syn_weight", n_edges, layout, [seed](uint64_t i) {
+        return static_cast<float>(_uniform(seed, Stream::weight, i));
+    });
+}
+
+
+void writeEdgeIndices(const std::string& path, const Sizes& sizes) {
+    bbp::sonata::EdgePopulation::writeIndices(path, POPULATION, sizes.nodes, sizes.nodes);
+}
+
+
+void writeNodeSets(const std::string& path) {
+    std::ofstream file(path);
+    file << R"({
+    "L5_TPC": {"mtype": "L5_TPC"},
+    "L23_PC": {"mtype": "L23_PC"},
+    "L6_IPC": {"mtype": "L6_IPC"},
+    "Layer23": {"layer": [2, 3]},
+    "Excitatory": ["L23_PC", "L5_TPC", "L6_IPC"],
+    "Inhibitory": {"$not": ["Excitatory"]},
+    "First1000": {"node_id": [)";
+    for (int i = 0; i < 1000; ++i) {
+        file << (i == 0 ? "" : ", ") << i;
+    }
+    file << "]}\n}\n";
+}
+
+
+void writeSpikes(const std::string& path, const Sizes& sizes, const Layout& layout) {
+    using Sorting = bbp::sonata::SpikeReader::Population::Sorting;
+
+    HighFive::File file(path, HighFive::File::Truncate);
+    const auto group = file.createGroup(std::string("/spikes/") + POPULATION);
+    const auto seed = sizes.seed;
+    const auto nodes = std::max<uint64_t>(sizes.nodes, 1);
+    const double tstop = static_cast<double>(sizes.frames) * TIME_STEP;
+    const auto n_spikes = static_cast<double>(std::max<uint64_t>(sizes.spikes, 1));
+
+    _writeDataSet<uint64_t>(group, "node_ids", sizes.spikes, layout, [=](uint64_t i) {
+        return _random(seed, Stream::spike_node, i) % nodes;
+    });
+    // Increasing, since the offset within a spike's interval is less than one.
+    _writeDataSet<double>(group, "timestamps", sizes.spikes, layout, [=](uint64_t i) {
+        return (static_cast<double>(i) + _uniform(seed, Stream::spike_time, i)) * tstop / n_spikes;
+    });
+    _writeAttribute(group.getDataSet("timestamps"), "units", std::string("ms"));
+
+    const HighFive::EnumType<Sorting> sorting_type({{"none", Sorting::none},
+                                                    {"by_id", Sorting::by_id},
+                                                    {"by_time", Sorting::by_time}});
+    const Sorting sorting = Sorting::by_time;
+    group
+        .createAttribute("sorting",
+                         HighFive::DataSpace(HighFive::DataSpace::dataspace_scalar),
+                         sorting_type)
+        .write_raw(&sorting, sorting_type);
+}
+
+
+void writeReport(const std::string& path, const Sizes& sizes, const Layout& layout) {
+    HighFive::File file(path, HighFive::File::Truncate);
+    const auto group = file.createGroup(std::string("/report/") + POPULATION);
+    const auto mapping = group.createGroup("mapping");
+    const auto seed = sizes.seed;
+
+    // Every `step`-th node, up to `report_nodes` of them.
+    const uint64_t n_nodes = std::min(sizes.report_nodes, sizes.nodes);
+    const uint64_t step = n_nodes == 0 ? 1 : sizes.nodes / n_nodes;
+    const uint64_t per_node = sizes.elements_per_node;
+    const uint64_t n_elements = n_nodes * per_node;
+
+    _writeDataSet<uint64_t>(mapping, "node_ids", n_nodes, layout, [step](uint64_t i) {
+        return i * step;
+    });
+    _writeAttribute(mapping.getDataSet("node_ids"), "sorted", uint8_t(1));
+    _writeDataSet<uint64_t>(mapping, "index_pointers", n_nodes + 1, layout, [per_node](uint64_t i) {
+        return i * per_node;
+    });
+    _writeDataSet<uint32_t>(mapping, "element_ids", n_elements, layout, [per_node](uint64_t i) {
+        return static_cast<uint32_t>(i % per_node);
+    });
+
+    const std::vector<double> times{0.0, static_cast<double>(sizes.frames) * TIME_STEP, TIME_STEP};
+    mapping.createDataSet<double>("time", HighFive::DataSpace::From(times)).write(times);
+    _writeAttribute(mapping.getDataSet("time"), "units", std::string("ms"));
+
+    // One frame per row, written a few frames at a time.
+    const auto chunk_size = std::max<uint64_t>(1, std::min(n_elements, layout.chunk_size));
+    auto data = group.createDataSet<float>("data",
+                                           HighFive::DataSpace({sizes.frames, n_elements}),
+                                           _createProps(layout,
+                                                        {sizes.frames, n_elements},
+                                                        {1, chunk_size}));
+    _writeAttribute(data, "units", std::string("mV"));
+
+    const uint64_t frames_per_batch = std::max<uint64_t>(1,
+                                                         BATCH_SIZE /
+                                                             std::max<uint64_t>(n_elements, 1));
+    std::vector<float> batch;
+    for (uint64_t begin = 0; begin < sizes.frames && n_elements > 0; begin += frames_per_batch) {
+        const uint64_t end = std::min(sizes.frames, begin + frames_per_batch);
+        batch.resize((end - begin) * n_elements);
+        for (uint64_t i = 0; i < batch.size(); ++i) {
+            const double u = _uniform(seed, Stream::data, begin * n_elements + i);
+            batch[i] = static_cast<float>(-65.0 + 10.0 * u);
+        }
+        data.select({begin, 0}, {end - begin, n_elements}).write_raw(batch.data());
+    }
+}
+
+}  // namespace synthetic
@@ -0,0 +1,86 @@
+/*************************************************************************
+ * Copyright (C) 2018-2020 Blue Brain Project
+ *
+ * This file is part of 'libsonata', distributed under the terms
+ * of the GNU Lesser General Public License version 3.
+ *
+ * See top-level COPYING.LESSER and COPYING files for details.
+ *************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace synthetic {
+
+/// Name of the populations of the synthetic files.
+constexpr const char* const POPULATION = "default";
+
+/// Names of the `mtype` enumeration; the nodes are spread evenly over them.
+constexpr const char* const MTYPES[] = {"L1_DAC", "L23_PC", "L4_SS", "L5_TPC", "L6_IPC", "L6_BC"};
+
+/// Sizes of the synthetic files; all of their contents derive from `seed`.
+struct Sizes {
+    uint64_t nodes = 100000;
+    /// Mean incoming edges of a node.
+    uint64_t fan_in = 100;
+    /** Spread of the incoming edges of a node.
+     *
+     * The fan-in of a node is log-normal, with a mean of `fan_in` and `sigma` of
+     * `fan_in_sigma`; with 0, every node has exactly `fan_in` incoming edges.
+     */
+    double fan_in_sigma = 0.0;
+    /// Nodes in the element report, and elements per node.
+    uint64_t report_nodes = 10000;
+    uint64_t elements_per_node = 10;
+    /// Time steps of the report, of 0.1 ms.
+    uint64_t frames = 1000;
+    uint64_t spikes = 1000000;
+    uint64_t seed = 0;
+
+    /// Incoming edges of `node`.
+    uint64_t fanIn(uint64_t node) const;
+
+    /// Total number of edges; takes a pass over the nodes.
+    uint64_t edges() const;
+};
+
+/// Storage of the datasets of the synthetic files.
+struct Layout {
+    /// Elements per chunk; of a row, for the data of the report.
+    uint64_t chunk_size = 1 << 16;
+    /// Level of the deflate filter, from 1 to 9; 0 for uncompressed datasets.
+    unsigned deflate = 0;
+    /// Whether to shuffle the bytes of the elements before compressing them.
+    bool shuffle = false;
+};
+
+/// Paths of the synthetic files in a directory.
+struct Paths {
+    explicit Paths(const std::string& directory);
+
+    std::string nodes;
+    std::string edges;
+    std::string node_sets;
+    std::string spikes;
+    std::string report;
+};
+
+/** Write the synthetic files to `paths`.
+ *
+ * Nodes have the attributes `x`, `y`, `z` (float), `layer` (int32) and the
+ * enumeration `mtype`. Edges are sorted by target, then by source, with sources
+ * chosen at random; they have the attributes `delay` and `syn_weight` (float).
+ * Spikes are sorted by time. Datasets are written in batches, such that the
+ * memory needed doesn't grow with the sizes; except for `writeEdgeIndices`,
+ * which reads all node IDs of the edges, see `EdgePopulation::writeIndices`.
+ */
+void writeNodes(const std::string& path, const Sizes& sizes, const Layout& layout = {});
+void writeEdges(const std::string& path, const Sizes& sizes, const Layout& layout = {});
+void writeEdgeIndices(const std::string& path, const Sizes& sizes);
+void writeNodeSets(const std::string& path);
+void writeSpikes(const std::string& path, const Sizes& sizes, const Layout& layout = {});
+void writeReport(const std::string& path, const Sizes& sizes, const Layout& layout = {});
+
+}  // namespace synthetic